@@ -0,0 +1,102 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2019 Infostellar.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+"""
+Compares the throughput of the fused Meteor QPSK demodulator with the usual
+chain of stock GNU Radio blocks, on a synthetic LRPT signal.
+
+Sample command to use this script
+$ python benchmark_meteor_demod.py -r 140000 -n 20000000
+"""
+
+import argparse
+import random
+import time
+
+from gnuradio import analog, blocks, digital, filter, gr
+from gnuradio.filter import firdes
+
+import starcoder
+
+SYMBOL_RATE = 72000
+RRC_ALPHA = 0.6
+
+parser = argparse.ArgumentParser(description="Benchmark of the Meteor QPSK demodulator")
+
+parser.add_argument("-r", "--samp-rate", help="Sample rate", type=float, default=140000)
+parser.add_argument("-n", "--samples", help="Number of samples demodulated by each chain", type=int,
+                    default=20000000)
+
+
+def make_signal(samp_rate, symbols=100000):
+    """QPSK symbols shaped with an RRC filter at samp_rate."""
+    tb = gr.top_block()
+    src = blocks.vector_source_b([random.randint(0, 3) for _ in range(symbols)])
+    mod = digital.chunks_to_symbols_bc(digital.constellation_qpsk().points())
+    sps = samp_rate / SYMBOL_RATE
+    taps = firdes.root_raised_cosine(32, 32 * sps, 1, RRC_ALPHA, int(32 * sps * 8) | 1)
+    resampler = filter.pfb_arb_resampler_ccf(sps, taps, 32)
+    sink = blocks.vector_sink_c()
+    tb.connect(src, mod, resampler, sink)
+    tb.run()
+    return sink.data()
+
+
+def stock_chain(samp_rate):
+    sps = samp_rate / SYMBOL_RATE
+    agc = analog.agc_cc(1e-4, 1.0, 1.0)
+    rrc = filter.fir_filter_ccf(1, firdes.root_raised_cosine(1, samp_rate, SYMBOL_RATE, RRC_ALPHA,
+                                                              int(sps * 8) | 1))
+    costas = digital.costas_loop_cc(0.005 / sps, 4)
+    gain_omega = 0.25 * 0.175 * 0.175
+    clock = digital.clock_recovery_mm_cc(sps, gain_omega, 0.5, 0.175, 0.005)
+    to_float = blocks.complex_to_float()
+    interleave = blocks.interleave(gr.sizeof_float)
+    to_char = blocks.float_to_char(1, 127)
+    return [agc, rrc, costas, clock, to_float], [(to_float, 0, interleave, 0),
+                                                (to_float, 1, interleave, 1),
+                                                (interleave, 0, to_char, 0)], to_char
+
+
+def run(name, signal, samples, chain):
+    tb = gr.top_block()
+    src = blocks.vector_source_c(signal, True)
+    head = blocks.head(gr.sizeof_gr_complex, samples)
+    first, links, last = chain
+    tb.connect(src, head, *first)
+    for link in links:
+        tb.connect(*link)
+    tb.connect(last, blocks.null_sink(gr.sizeof_char))
+
+    start = time.time()
+    tb.run()
+    elapsed = time.time() - start
+    print("{}: {:.2f} Msamples/s".format(name, samples / elapsed / 1e6))
+    return elapsed
+
+
+if __name__ == "__main__":
+    args = parser.parse_args()
+
+    signal = make_signal(args.samp_rate)
+    stock = run("Stock chain", signal, args.samples, stock_chain(args.samp_rate))
+    demod = starcoder.meteor_qpsk_demod(args.samp_rate, SYMBOL_RATE, RRC_ALPHA)
+    fused = run("meteor_qpsk_demod", signal, args.samples, ([demod], [], demod))
+    print("Speedup: {:.2f}x".format(stock / fused))
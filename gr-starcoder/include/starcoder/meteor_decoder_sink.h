@@ -35,8 +35,44 @@ class STARCODER_API meteor_decoder_sink : virtual public gr::sync_block {
  public:
   typedef boost::shared_ptr<meteor_decoder_sink> sptr;
 
-  static sptr make(const std::string &filename_png);
+  /*!
+   * Decodes a stream of 8 bit soft symbols from Meteor M2 LRPT and outputs
+   * the channel images as PNG files when the flowgraph stops.
+   *
+   * @param filename_png the base filename of the output PNG file(s)
+   * @param streaming if true, frames are decoded as the symbols arrive using
+   * a bounded buffer. Otherwise the whole pass is buffered and decoded in
+   * stop().
+   * @param threads number of threads decoding frames. 1 decodes on the
+   * flowgraph thread, 0 uses one thread per core. In streaming mode the
+   * threads only decode the sync candidates concurrently.
+   * @param progressive if true, each completed row of MCUs (8 lines) of each
+   * channel is sent to the registered queue as a dict with the "apid",
+   * "line", "width" and "pixels" (8 bit gray) of the strip, instead of
+   * sending the PNG images when the flowgraph stops.
+   * @param telemetry if true, the link quality of every frame is sent to the
+   * registered queue as soon as it is decoded, as a dict with the soft symbol
+   * "position" of the frame, whether it is "ok", the "correlation" (matching
+   * bits of the 64 bit sync word), the channel "bit_errors" corrected by the
+   * Viterbi decoder and the corresponding "ber", and the "rs_corrections"
+   * (symbols corrected in each of the four RS codewords, -1 if uncorrectable).
+   * @param sync_candidates number of sync word matches (up to one per IQ
+   * rotation, best correlation first) tried when synchronization is lost,
+   * keeping the first that passes Reed-Solomon decoding. More candidates
+   * recover more frames at low SNR, and are decoded concurrently when
+   * threads is not 1.
+   */
+  static sptr make(const std::string &filename_png, bool streaming = false,
+                   int threads = 1, bool progressive = false,
+                   bool telemetry = false, int sync_candidates = 1);
   virtual void register_starcoder_queue(uint64_t ptr) = 0;
+
+  // Running totals since the flowgraph started. They may be read while it
+  // runs. Corrections are only counted for frames that decoded successfully.
+  virtual int total_frames() = 0;
+  virtual int ok_frames() = 0;
+  virtual int corrected_bits() = 0;
+  virtual int corrected_symbols() = 0;
 };
 
 }  // namespace starcoder
@@ -0,0 +1,67 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_STARCODER_METEOR_QPSK_DEMOD_H
+#define INCLUDED_STARCODER_METEOR_QPSK_DEMOD_H
+
+#include <starcoder/api.h>
+#include <gnuradio/block.h>
+
+namespace gr {
+namespace starcoder {
+
+/*!
+ * \ingroup starcoder
+ *
+ */
+class STARCODER_API meteor_qpsk_demod : virtual public gr::block {
+ public:
+  typedef boost::shared_ptr<meteor_qpsk_demod> sptr;
+
+  /*!
+   * Demodulates Meteor M2 LRPT from complex baseband into the 8 bit soft
+   * symbols (I then Q of each symbol) meteor_decoder_sink expects. It
+   * replaces the usual chain of AGC, RRC filter, Costas loop, clock recovery
+   * and float to char conversion: all of them run in a single pass over each
+   * sample.
+   *
+   * @param samp_rate input sample rate, at least symbol_rate * (1 +
+   * rrc_alpha)
+   * @param symbol_rate symbol rate in symbols per second
+   * @param rrc_alpha excess bandwidth of the root raised cosine filter
+   * @param costas_bw bandwidth of the Costas loop, relative to the symbol
+   * rate. It is widened while the carrier is not locked.
+   * @param timing_bw bandwidth of the Gardner timing recovery loop, relative
+   * to the symbol rate
+   */
+  static sptr make(double samp_rate, double symbol_rate = 72000,
+                   float rrc_alpha = 0.6, float costas_bw = 0.005,
+                   float timing_bw = 0.005);
+
+  // Current carrier offset estimate in Hz, and whether the carrier is
+  // locked.
+  virtual double frequency_offset() = 0;
+  virtual bool locked() = 0;
+};
+
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_STARCODER_METEOR_QPSK_DEMOD_H */
@@ -74,10 +74,22 @@ class STARCODER_API noaa_apt_sink : virtual public gr::sync_block {
    * @param sync user option for synchronizing to the first of the
    * two training sequences
    * @param flip user option to rotate the image(s) 180 degrees
+   * @param streaming if false, a single image of height lines is produced
+   * and the rest of the observation is ignored. If true, the observation is
+   * split into consecutive frames of height lines, each written to its own
+   * PNG file (the frame number is appended to the base filename) while it is
+   * received, and completed lines are sent to the registered queue in
+   * batches. Only a batch of lines is held in memory, however long the pass.
+   * Lines are output in the order they are received, so flip is ignored.
+   * @param batch_lines in streaming mode, the number of lines in each
+   * message sent to the registered queue, as a dict with the "frame" number,
+   * the first "line" within the frame, the "width" and the "pixels" (8 bit
+   * gray) of the lines. The last batch of a frame may be shorter.
    *
    */
   static sptr make(const char *filename_png, size_t width, size_t height,
-                   bool sync, bool flip);
+                   bool sync, bool flip, bool streaming = false,
+                   size_t batch_lines = 8);
   virtual void register_starcoder_queue(uint64_t ptr) = 0;
 };
 
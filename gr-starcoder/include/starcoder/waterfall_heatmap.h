@@ -42,6 +42,7 @@
 
 #include <starcoder/api.h>
 #include <gnuradio/sync_block.h>
+#include <gnuradio/fft/window.h>
 
 namespace gr {
 namespace starcoder {
@@ -71,11 +72,35 @@ class STARCODER_API waterfall_heatmap : virtual public gr::block {
    * - 0: Simple decimation
    * - 1: Max hold
    * - 2: Mean energy
+   * @param overlap in mean mode, also average the FFTs of the windows that
+   * start halfway through each input vector (50% overlap)
+   * @param window the gr::fft::window::win_type applied to each FFT input in
+   * mean mode
+   * @param span if not 0, zoom into a band of this many Hz: the input is
+   * mixed, low pass filtered and decimated by floor(samp_rate / (2 * span))
+   * before the FFT, so fft_size bins cover output_rate() Hz, at least twice
+   * the span, instead of samp_rate
+   * @param offset center of the zoomed band relative to center_freq, in Hz.
+   * Doppler shifts received on the "doppler" message port, as published by
+   * groundstation_api_doppler, are subtracted from it.
    *
    * @return shared pointer to the object
    */
   static sptr make(double samp_rate, double center_freq, double rps,
-                   size_t fft_size, int mode = 0);
+                   size_t fft_size, int mode = 0, bool overlap = false,
+                   int window = fft::window::WIN_HANN, double span = 0,
+                   double offset = 0);
+
+  /**
+   * Moves the center of the zoomed band. Ignored when not zooming.
+   */
+  virtual void set_offset(double offset) = 0;
+
+  /**
+   * The sample rate the FFTs run at: samp_rate, or the decimated rate when
+   * zooming. This is the frequency range covered by each output row.
+   */
+  virtual double output_rate() const = 0;
 };
 
 }  // namespace starcoder
@@ -42,6 +42,7 @@
 
 #include <starcoder/api.h>
 #include <gnuradio/sync_block.h>
+#include <string>
 
 namespace gr {
 namespace starcoder {
@@ -55,8 +56,31 @@ class STARCODER_API waterfall_plotter : virtual public gr::sync_block {
  public:
   typedef boost::shared_ptr<waterfall_plotter> sptr;
 
+  /*!
+   * Collects the spectrum rows of a waterfall_heatmap and renders them as a
+   * PNG when the flowgraph stops. The image is written to filename, unless
+   * it is empty, and sent to the registered queue.
+   *
+   * @param samp_rate the sample rate of the spectrum
+   * @param center_freq the center frequency, for the axis labels
+   * @param rps the number of rows per second
+   * @param fft_size the number of bins in each row
+   * @param filename the PNG file to write, or empty
+   * @param use_matplotlib if true, the image is plotted by
+   * starcoder.plot_waterfall through the Python interpreter. Otherwise it is
+   * rendered natively, which does not take the GIL and is much faster on long
+   * passes.
+   * @param memory_limit_mb the rows are kept in memory up to this many MiB.
+   * Longer observations are moved to a temporary file, which is mapped back
+   * into memory for plotting.
+   * @param spill_dir the directory of that temporary file. Empty means
+   * $TMPDIR, or /tmp, which is often a RAM backed tmpfs: point it to a disk
+   * on hosts with little memory.
+   */
   static sptr make(double samp_rate, double center_freq, int rps,
-                   size_t fft_size, char* filename);
+                   size_t fft_size, char* filename,
+                   bool use_matplotlib = false, int memory_limit_mb = 256,
+                   const std::string &spill_dir = "");
   virtual void register_starcoder_queue(uint64_t ptr) = 0;
 };
 
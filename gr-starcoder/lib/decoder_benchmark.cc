@@ -0,0 +1,614 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// Throughput of the Meteor-M2 LRPT and NOAA APT decoding stages, kept out of
+// the QA suite so that it only runs when asked for. The QA checks that the
+// SIMD and table driven kernels give the same results as the plain ones, this
+// tells how much faster they are. Compare the numbers before and after a
+// change on the same machine.
+//
+// Usage: decoder_benchmark [<soft symbols file>]
+//
+// The soft symbols default to test_meteor_stream.s, which the build copies
+// next to this program along with the test_meteor_image_<apid>.png planes
+// the generator stage encodes.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gil_util.h"
+#include "meteor/meteor_bit_io.h"
+#include "meteor/meteor_correlator.h"
+#include "meteor/meteor_decoder.h"
+#include "meteor/meteor_demod.h"
+#include "meteor/meteor_ecc.h"
+#include "meteor/meteor_generator.h"
+#include "meteor/meteor_idct.h"
+#include "meteor/meteor_packet.h"
+#include "meteor/meteor_parallel_decoder.h"
+#include "meteor/meteor_viterbi.h"
+#include "noaa_apt_sync.h"
+
+namespace meteor = gr::starcoder::meteor;
+
+namespace {
+
+// Runs f once, returns how long it took, in seconds.
+template <typename F>
+double seconds(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> time =
+      std::chrono::steady_clock::now() - start;
+  return time.count();
+}
+
+// Frame sized windows every quarter frame, so that noisy (unsynchronized)
+// input is decoded as well as clean frames.
+std::vector<int> frame_offsets(const std::vector<char> &soft) {
+  std::vector<int> offsets;
+  for (int off = 0; off + meteor::SOFT_FRAME_LEN <= soft.size();
+       off += meteor::SOFT_FRAME_LEN / 4) {
+    offsets.push_back(off);
+  }
+  return offsets;
+}
+
+// Add-compare-select kernels against the scalar one, and the cost of
+// switching between decoders, as the workers of a parallel_decoder do.
+void benchmark_viterbi(const std::vector<char> &soft) {
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(soft.data());
+  std::vector<int> offsets = frame_offsets(soft);
+  std::vector<uint8_t> decoded(meteor::HARD_FRAME_LEN * offsets.size());
+
+  const meteor::acs_impl impls[] = { meteor::ACS_SCALAR, meteor::ACS_SSE2,
+                                     meteor::ACS_AVX2 };
+  const char *names[] = { "Scalar", "SSE2", "AVX2" };
+  double scalar_time = 0;
+  for (int k = 0; k < 3; k++) {
+    // The scalar code is part of the decoder, not a selectable kernel.
+    if (k > 0 && meteor::select_acs_kernel(impls[k]) == NULL) {
+      std::cout << names[k] << " Viterbi: not supported" << std::endl;
+      continue;
+    }
+    meteor::viterbi viterbi(impls[k]);
+    double time = seconds([&]() {
+      for (int i = 0; i < offsets.size(); i++) {
+        viterbi.vit_conv_decode(raw + offsets[i],
+                                decoded.data() + i * meteor::HARD_FRAME_LEN);
+      }
+    });
+    if (k == 0) scalar_time = time;
+    std::cout << names[k] << " Viterbi: " << offsets.size() / time
+              << " frames/s (" << scalar_time / time << "x scalar)"
+              << std::endl;
+  }
+
+  const int decoders = 8;
+  std::vector<std::unique_ptr<meteor::viterbi> > interleaved;
+  for (int k = 0; k < decoders; k++) {
+    interleaved.emplace_back(new meteor::viterbi());
+  }
+  double time = seconds([&]() {
+    for (int i = 0; i < offsets.size(); i++) {
+      interleaved[i % decoders]->vit_conv_decode(
+          raw + offsets[i], decoded.data() + i * meteor::HARD_FRAME_LEN);
+    }
+  });
+  std::cout << "Viterbi across " << decoders
+            << " decoders: " << offsets.size() / time << " frames/s, "
+            << sizeof(meteor::viterbi) << " bytes of state each" << std::endl;
+}
+
+// Sync word search with packed XOR/popcount against the lookup table one.
+void benchmark_correlator(const std::vector<char> &soft) {
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(soft.data());
+  std::vector<int> offsets = frame_offsets(soft);
+  meteor::correlator correlator(0xfca2b63db00d9794);
+  double table_time = seconds([&]() {
+    for (int off : offsets) {
+      correlator.corr_correlate_table(raw + off, meteor::SOFT_FRAME_LEN);
+    }
+  });
+  double packed_time = seconds([&]() {
+    for (int off : offsets) {
+      correlator.corr_correlate(raw + off, meteor::SOFT_FRAME_LEN);
+    }
+  });
+  std::cout << "Correlator: table " << offsets.size() / table_time
+            << " frames/s, packed " << offsets.size() / packed_time
+            << " frames/s (" << table_time / packed_time << "x)" << std::endl;
+}
+
+// Reed-Solomon decoding of the four codewords of a frame at once against one
+// by one. Three frames out of four are clean, as in a good pass, the others
+// have up to 8 errors per codeword.
+void benchmark_ecc() {
+  const int n = meteor::ECC_INTERLEAVE;
+  const int frames = 2000;
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> symbol(0, 254);
+  std::uniform_int_distribution<int> errors(0, 8);
+  std::vector<uint8_t> received(frames * 255 * n);
+  std::array<uint8_t, 255> codeword;
+  for (int f = 0; f < frames; f++) {
+    for (int j = 0; j < n; j++) {
+      for (int i = 0; i < 223; i++) codeword[i] = byte(rng);
+      meteor::ecc_encode(codeword.data(), 0);
+      if (f % 4 == 3) {
+        for (int e = errors(rng); e > 0; e--) codeword[symbol(rng)] ^= byte(rng);
+      }
+      meteor::ecc_interleave(codeword.data(), &received[f * 255 * n], j, n);
+    }
+  }
+
+  std::vector<uint8_t> data(received);
+  double single_time = seconds([&]() {
+    for (int f = 0; f < frames; f++) {
+      for (int j = 0; j < n; j++) {
+        meteor::ecc_deinterleave(&data[f * 255 * n], codeword.data(), j, n);
+        meteor::ecc_decode(codeword.data(), 0);
+        meteor::ecc_interleave(codeword.data(), &data[f * 255 * n], j, n);
+      }
+    }
+  });
+  data = received;
+  std::array<int, meteor::ECC_INTERLEAVE> results;
+  double interleaved_time = seconds([&]() {
+    for (int f = 0; f < frames; f++) {
+      meteor::ecc_decode_interleaved(&data[f * 255 * n], results);
+    }
+  });
+  std::cout << "ECC: one codeword at a time " << frames / single_time
+            << " frames/s, interleaved " << frames / interleaved_time
+            << " frames/s (" << single_time / interleaved_time << "x)"
+            << std::endl;
+}
+
+// 8x8 inverse DCT kernels against the reference, on sparse quantized
+// coefficients like those of real images.
+void benchmark_idct() {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> coefficient(-64, 64);
+  std::uniform_int_distribution<int> sparse(0, 3);
+
+  std::array<float, 64> scales;
+  meteor::idct_scales(scales);
+
+  const int blocks = 20000;
+  std::vector<float> in(64 * blocks), scaled(64 * blocks), out(64 * blocks);
+  for (int i = 0; i < in.size(); i++) {
+    in[i] = sparse(rng) == 0 ? 8 * coefficient(rng) : 0;
+    scaled[i] = in[i] * scales[i % 64];
+  }
+
+  double reference_time = seconds([&]() {
+    for (int b = 0; b < blocks; b++) {
+      meteor::idct_8x8_reference(&in[64 * b], &out[64 * b]);
+    }
+  });
+  std::cout << "Reference IDCT: " << blocks / reference_time << " blocks/s"
+            << std::endl;
+
+  const meteor::idct_impl impls[] = { meteor::IDCT_SCALAR, meteor::IDCT_SSE,
+                                      meteor::IDCT_AVX };
+  const char *names[] = { "Scalar", "SSE", "AVX" };
+  for (int k = 0; k < 3; k++) {
+    meteor::idct_kernel kernel = meteor::select_idct_kernel(impls[k]);
+    if (kernel == NULL) {
+      std::cout << names[k] << " IDCT: not supported" << std::endl;
+      continue;
+    }
+    double time = seconds([&]() {
+      for (int b = 0; b < blocks; b++) kernel(&scaled[64 * b], &out[64 * b]);
+    });
+    std::cout << names[k] << " IDCT: " << blocks / time << " blocks/s ("
+              << reference_time / time << "x reference)" << std::endl;
+  }
+}
+
+// The previous bit at a time reader, with zeros past the end.
+uint32_t peek_bitwise(const std::vector<uint8_t> &bytes, int pos, int n) {
+  uint32_t result = 0;
+  for (int i = 0; i < n; i++) {
+    int p = pos + i;
+    int bit = p < 8 * bytes.size() ? (bytes[p >> 3] >> (7 - (p & 7))) & 1 : 0;
+    result = (result << 1) | bit;
+  }
+  return result;
+}
+
+// 16 bit peeks with the access pattern of the Huffman decoder: peek, then
+// consume a code and possibly its value bits.
+void benchmark_bit_io() {
+  std::mt19937 rng(7);
+  std::vector<uint8_t> bytes(1 << 20);
+  for (auto &b : bytes) b = rng();
+  std::vector<int> steps(bytes.size() * 2);
+  std::uniform_int_distribution<int> step(0, 16);
+  for (auto &s : steps) s = step(rng);
+
+  uint32_t bitwise_sum = 0, cached_sum = 0;
+  int peeks = 0;
+  double bitwise_time = seconds([&]() {
+    int pos = 0;
+    for (int i = 0; i < steps.size() && pos <= 8 * bytes.size(); i++) {
+      bitwise_sum += peek_bitwise(bytes, pos, 16);
+      pos += steps[i];
+      peeks++;
+    }
+  });
+  double cached_time = seconds([&]() {
+    meteor::bit_io_const reader(bytes.data(), bytes.size());
+    for (int i = 0; !reader.overrun(); i++) {
+      cached_sum += reader.peek_n_bits(16);
+      reader.advance_n_bits(steps[i]);
+    }
+  });
+  // Printing the sums keeps the peeks from being optimized away.
+  std::cout << "Bit reader: bitwise " << peeks / bitwise_time
+            << " peeks/s, cached " << peeks / cached_time << " peeks/s ("
+            << bitwise_time / cached_time << "x), checksums " << bitwise_sum
+            << " " << cached_sum << std::endl;
+}
+
+// APT sync detection at every sample position of noisy APT lines: sync A,
+// random pixels, sync B at the middle of the line, random pixels.
+void benchmark_apt_sync() {
+  const int line_width = 2080, lines = 1000;
+  const int length = gr::starcoder::APT_SYNC_LENGTH;
+  const char sync_a[] = "0000110011001100110011001100110000000000";
+  const char sync_b[] = "0000111001110011100111001110011100111000";
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> pixel(0.2, 0.8);
+  std::normal_distribution<float> noise(0, 0.1);
+  std::vector<float> samples(lines * line_width);
+  for (int y = 0; y < lines; y++) {
+    float *line = &samples[y * line_width];
+    for (int x = 0; x < line_width; x++) line[x] = pixel(rng);
+    for (int i = 0; i < length; i++) {
+      line[i] = sync_a[i] == '1' ? 0.9 : 0.1;
+      line[line_width / 2 + i] = sync_b[i] == '1' ? 0.9 : 0.1;
+    }
+    for (int x = 0; x < line_width; x++) line[x] += noise(rng);
+  }
+
+  // The moving average the sink removes, as of the last sample of the window.
+  std::vector<float> average(samples.size());
+  float a = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    a = 0.25 * samples[i] + 0.75 * a;
+    average[i] = a;
+  }
+
+  const int positions = samples.size() - length + 1;
+  const gr::starcoder::apt_sync_impl impls[] = {
+    gr::starcoder::APT_SYNC_AUTO, gr::starcoder::APT_SYNC_SCALAR,
+    gr::starcoder::APT_SYNC_SSE, gr::starcoder::APT_SYNC_AVX
+  };
+  const char *names[] = { "Reference", "Scalar", "SSE", "AVX" };
+  for (int k = 0; k < 4; k++) {
+    gr::starcoder::apt_sync_kernel kernel =
+        k == 0 ? gr::starcoder::apt_sync_reference
+               : gr::starcoder::select_apt_sync_kernel(impls[k]);
+    if (kernel == NULL) {
+      std::cout << names[k] << " APT sync: not supported" << std::endl;
+      continue;
+    }
+    int found = 0;
+    double time = seconds([&]() {
+      for (int i = 0; i < positions; i++) {
+        if (kernel(&samples[i], average[i + length - 1]) !=
+            gr::starcoder::noaa_apt_sync_marker::NONE) {
+          found++;
+        }
+      }
+    });
+    std::cout << names[k] << " APT sync: " << positions / time / 1e6
+              << " Msamples/s, " << found << " syncs" << std::endl;
+  }
+}
+
+// QPSK modulates the hard decisions of soft symbol pairs with RRC pulses at
+// samp_rate, with a carrier offset and complex gaussian noise at an Es/N0 of
+// 10 dB, like qa_meteor_demod does.
+std::vector<std::complex<float> > modulate(const std::vector<char> &soft,
+                                           double samp_rate, double offset) {
+  const int oversampling = 64;
+  const int span = 16;
+  std::vector<float> pulse =
+      meteor::rrc_taps(oversampling, meteor::LRPT_RRC_ALPHA, span);
+  int half = (pulse.size() - 1) / 2;
+
+  int symbols = soft.size() / 2;
+  double samples_per_symbol = samp_rate / meteor::LRPT_SYMBOL_RATE;
+  int len = symbols * samples_per_symbol;
+  std::vector<std::complex<float> > samples(len);
+
+  std::mt19937 rng(1);
+  double sigma =
+      std::sqrt(samples_per_symbol / 2) * std::pow(10, -0.5) / oversampling;
+  std::normal_distribution<float> noise(0, sigma);
+
+  for (int n = 0; n < len; n++) {
+    double t = n / samples_per_symbol + 0.3;
+    std::complex<float> sample = 0;
+    for (int k = int(t) - span / 2; k <= int(t) + span / 2; k++) {
+      if (k < 0 || k >= symbols) continue;
+      int tap = std::lrint((t - k) * oversampling) + half;
+      if (tap < 0 || tap >= pulse.size()) continue;
+      sample += std::complex<float>(soft[2 * k] < 0 ? -1 : 1,
+                                    soft[2 * k + 1] < 0 ? -1 : 1) *
+                pulse[tap];
+    }
+    sample *= std::polar(1.0, 2 * M_PI * offset * n / samp_rate);
+    samples[n] = sample + std::complex<float>(noise(rng), noise(rng));
+  }
+  return samples;
+}
+
+// The RRC filter kernels on their own, then the whole demodulator on the
+// remodulated recording at a common receiver sample rate.
+void benchmark_demod(const std::vector<char> &soft) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> value(-1, 1);
+  const int len = 36;
+  const int outputs = 1000000;
+  std::vector<float> input(2 * (len + outputs)), taps(2 * len);
+  for (auto &s : input) s = value(rng);
+  for (int k = 0; k < len; k++) taps[2 * k] = taps[2 * k + 1] = value(rng);
+
+  const meteor::fir_impl impls[] = { meteor::FIR_SCALAR, meteor::FIR_SSE,
+                                     meteor::FIR_AVX };
+  const char *names[] = { "Scalar", "SSE", "AVX" };
+  for (int k = 0; k < 3; k++) {
+    meteor::fir_kernel kernel = meteor::select_fir_kernel(impls[k]);
+    if (kernel == NULL) {
+      std::cout << names[k] << " RRC filter: not supported" << std::endl;
+      continue;
+    }
+    std::complex<float> sum = 0;
+    double time = seconds([&]() {
+      for (int i = 0; i < outputs; i++) {
+        sum += kernel(&input[2 * i], taps.data(), len);
+      }
+    });
+    std::cout << names[k] << " RRC filter: " << outputs / time / 1e6
+              << " Msamples/s, checksum " << sum.real() << std::endl;
+  }
+
+  const double samp_rate = 140000;
+  std::vector<std::complex<float> > samples = modulate(soft, samp_rate, 1500);
+  meteor::qpsk_demod demod(samp_rate);
+  std::vector<int8_t> symbols(soft.size() + 1024);
+  int produced = 0;
+  double time = seconds([&]() {
+    const int block = 4096;
+    for (int i = 0; i < samples.size(); i += block) {
+      int consumed;
+      produced += demod.work(
+          &samples[i], std::min<int>(block, samples.size() - i),
+          &symbols[produced], symbols.size() - produced, consumed);
+    }
+  });
+  std::cout << "QPSK demodulator: " << samples.size() / time / 1e6
+            << " Msamples/s, " << produced / 2 << " symbols" << std::endl;
+}
+
+// Stream generation from the planes of the decoder test fixture: JPEG coding,
+// framing, Reed-Solomon and convolutional coding of 10 s of LRPT.
+void benchmark_generator() {
+  meteor::image_store image(8 * meteor::MCU_PER_LINE, 3);
+  const int apids[] = { meteor::RED_APID, meteor::GREEN_APID,
+                        meteor::BLUE_APID };
+  try {
+    for (int p = 0; p < 3; p++) {
+      boost::gil::gray8_image_t gray;
+      boost::gil::png_read_image(
+          "test_meteor_image_" + std::to_string(apids[p]) + ".png", gray);
+      boost::gil::gray8_image_t::const_view_t v = boost::gil::const_view(gray);
+      if (v.width() != image.width()) {
+        throw std::runtime_error("wrong image width");
+      }
+      image.grow(v.height() / 8 * 8);
+      for (int y = 0; y < image.lines(); y++) {
+        for (int x = 0; x < v.width(); x++) image.row(p, y)[x] = v(x, y);
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cout << "Meteor generator: cannot load the test image planes ("
+              << e.what() << ")" << std::endl;
+    return;
+  }
+
+  meteor::generator_options options;
+  options.seconds = 10;
+  meteor::generator generator(image, options);
+  std::vector<uint8_t> soft(meteor::SOFT_FRAME_LEN);
+  double time = seconds([&]() {
+    while (generator.next_frame(soft.data())) {
+    }
+  });
+  std::cout << "Meteor generator: " << generator.frames() / time
+            << " frames/s" << std::endl;
+}
+
+// Decodes the whole of soft, returning the number of good frames.
+int decode_frames(meteor::decoder &decoder, const std::vector<char> &soft) {
+  const unsigned char *raw =
+      reinterpret_cast<const unsigned char *>(soft.data());
+  std::vector<uint8_t> ecced_data(meteor::HARD_FRAME_LEN);
+  int ok = 0;
+  while (decoder.pos() < int(soft.size()) - meteor::SOFT_FRAME_LEN) {
+    if (decoder.decode_one_frame(raw, soft.size(), ecced_data.data())) ok++;
+  }
+  return ok;
+}
+
+// The serial decoder against the worker pool of buffered mode. The scaling
+// depends on the cores this runs on, which are printed too.
+void benchmark_parallel(const std::vector<char> &soft) {
+  meteor::decoder serial;
+  int ok = 0;
+  double serial_time = seconds([&]() { ok = decode_frames(serial, soft); });
+  std::cout << "Serial decoder: " << ok << " good frames, "
+            << soft.size() / meteor::SOFT_FRAME_LEN / serial_time
+            << " frames/s on " << std::thread::hardware_concurrency()
+            << " hardware threads" << std::endl;
+
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    meteor::parallel_decoder parallel(threads);
+    double time = seconds([&]() { decode_frames(parallel, soft); });
+    std::cout << "Parallel decoder, " << threads << " thread(s): "
+              << soft.size() / meteor::SOFT_FRAME_LEN / time << " frames/s ("
+              << serial_time / time << "x serial)" << std::endl;
+  }
+}
+
+// What a sink pays at each flowgraph start for its decoder and packeter,
+// once the shared lookup tables exist.
+void benchmark_construction() {
+  meteor::huffman_tables::get();
+  const int instances = 1000;
+  double time = seconds([&]() {
+    for (int i = 0; i < instances; i++) {
+      std::unique_ptr<meteor::decoder> decoder(new meteor::decoder());
+      std::unique_ptr<meteor::packeter> packeter(new meteor::packeter());
+    }
+  });
+  std::cout << "Decoder and packeter construction: "
+            << time / instances * 1e6 << " us each" << std::endl;
+}
+
+// Sync candidates on the recording with uniform noise of +-90 added to every
+// soft symbol, where the best sync correlation is sometimes the wrong one.
+void benchmark_sync_candidates(const std::vector<char> &soft) {
+  std::vector<char> noisy(soft);
+  uint32_t seed = 1;
+  for (auto &symbol : noisy) {
+    seed = seed * 1103515245 + 12345;
+    int noise = static_cast<int>((seed >> 16) % 181) - 90;
+    int value = static_cast<signed char>(symbol) + noise;
+    symbol = static_cast<char>(std::max(-127, std::min(127, value)));
+  }
+  const double frames = noisy.size() / meteor::SOFT_FRAME_LEN;
+
+  meteor::decoder single;
+  int ok = 0;
+  double time = seconds([&]() { ok = decode_frames(single, noisy); });
+  std::cout << "Single sync candidate: " << ok << " good frames, "
+            << frames / time << " frames/s" << std::endl;
+
+  meteor::decoder candidates;
+  candidates.set_sync_candidates(8);
+  double serial_time =
+      seconds([&]() { ok = decode_frames(candidates, noisy); });
+  std::cout << "8 sync candidates: " << ok << " good frames, "
+            << frames / serial_time << " frames/s" << std::endl;
+
+  for (int speculate = 0; speculate < 2; speculate++) {
+    meteor::parallel_decoder parallel(4, speculate);
+    parallel.set_sync_candidates(8);
+    time = seconds([&]() { decode_frames(parallel, noisy); });
+    std::cout << "8 sync candidates on 4 threads"
+              << (speculate ? ", speculating: " : ": ") << frames / time
+              << " frames/s (" << serial_time / time << "x serial)"
+              << std::endl;
+  }
+}
+
+// Decoding with and without Reed-Solomon erasures close to where plain
+// decoding gives up on most frames, on a generated stream of a synthetic
+// image.
+void benchmark_erasures() {
+  meteor::image_store image(8 * meteor::MCU_PER_LINE, 3);
+  image.grow(64);
+  for (int p = 0; p < 3; p++) {
+    for (int y = 0; y < image.lines(); y++) {
+      for (int x = 0; x < image.width(); x++) {
+        image.row(p, y)[x] = x * 7 + y * 13 + p * 50 + (x * y) % 31;
+      }
+    }
+  }
+  meteor::generator_options options;
+  options.seconds = 30;
+  options.snr_db = 1.25;
+  meteor::generator generator(image, options);
+  std::vector<char> stream(generator.frames() * meteor::SOFT_FRAME_LEN);
+  for (int f = 0; generator.next_frame(reinterpret_cast<uint8_t *>(
+           &stream[f * meteor::SOFT_FRAME_LEN]));
+       f++) {
+  }
+
+  for (bool erasures : { false, true }) {
+    meteor::decoder decoder;
+    decoder.set_erasure_decoding(erasures);
+    int ok = 0;
+    double time = seconds([&]() { ok = decode_frames(decoder, stream); });
+    std::cout << "Erasure decoding " << (erasures ? "on" : "off") << ": "
+              << ok << " of " << generator.frames() << " frames, "
+              << generator.frames() / time << " frames/s, Reed-Solomon "
+              << decoder.timings().ecc / time * 100 << "% of the time"
+              << std::endl;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    std::cerr << "Usage: " << argv[0] << " [<soft symbols file>]" << std::endl;
+    return 2;
+  }
+  const std::string input = argc == 2 ? argv[1] : "test_meteor_stream.s";
+  std::ifstream in(input, std::ios::binary);
+  std::vector<char> soft((std::istreambuf_iterator<char>(in)),
+                         (std::istreambuf_iterator<char>()));
+  if (soft.size() < 4 * meteor::SOFT_FRAME_LEN) {
+    std::cerr << "Cannot read a few frames from " << input << std::endl;
+    return 1;
+  }
+
+  benchmark_viterbi(soft);
+  benchmark_correlator(soft);
+  benchmark_parallel(soft);
+  benchmark_construction();
+  benchmark_sync_candidates(soft);
+  benchmark_erasures();
+  benchmark_ecc();
+  benchmark_idct();
+  benchmark_bit_io();
+  benchmark_apt_sync();
+  benchmark_demod(soft);
+  benchmark_generator();
+  return 0;
+}
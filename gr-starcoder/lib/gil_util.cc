@@ -20,50 +20,180 @@
 
 #include "gil_util.h"
 
-#include <memory>
-#include <fstream>
+#include <png.h>
+
+#include <stdexcept>
+#include <vector>
 
 namespace gr {
 namespace starcoder {
 
-std::string store_rgb_to_png_string(
-    boost::gil::rgb8_image_t::view_t image_view) {
-  boost::filesystem::path temp = boost::filesystem::temp_directory_path() /
-                                 boost::filesystem::unique_path();
-
-  // The destructor needs to be called so we can properly read the file in the
-  // following lines
-  {
-    boost::gil::detail::png_writer writer(temp.native().c_str());
-    writer.apply(image_view);
+namespace {
+
+void append_png_data(png_structp png_ptr, png_bytep data, png_size_t length) {
+  std::string *out = static_cast<std::string *>(png_get_io_ptr(png_ptr));
+  out->append(reinterpret_cast<const char *>(data), length);
+}
+
+void flush_png_data(png_structp png_ptr) {}
+
+void write_png_stream(png_structp png_ptr, png_bytep data, png_size_t length) {
+  std::ostream *out = static_cast<std::ostream *>(png_get_io_ptr(png_ptr));
+  out->write(reinterpret_cast<const char *>(data), length);
+  if (!*out) png_error(png_ptr, "write failed");
+}
+
+void flush_png_stream(png_structp png_ptr) {
+  static_cast<std::ostream *>(png_get_io_ptr(png_ptr))->flush();
+}
+
+}  // namespace
+
+std::string store_rows_to_png_string(int width, int height, int channels,
+                                     const png_row_source &row,
+                                     const png_options &options) {
+  png_structp png_ptr =
+      png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png_ptr == NULL) {
+    throw std::runtime_error("png_create_write_struct failed");
+  }
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if (info_ptr == NULL) {
+    png_destroy_write_struct(&png_ptr, NULL);
+    throw std::runtime_error("png_create_info_struct failed");
+  }
+
+  std::string out;
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    throw std::runtime_error("libpng failed to encode the image");
   }
 
-  std::ifstream t(temp.native(), std::ios::binary);
-  std::stringstream buffer;
-  buffer << t.rdbuf();
+  png_set_write_fn(png_ptr, &out, append_png_data, flush_png_data);
+  if (options.compression_level >= 0) {
+    png_set_compression_level(png_ptr, options.compression_level);
+  }
+  if (options.filters >= 0) {
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, options.filters);
+  }
 
-  boost::filesystem::remove(temp);
-  return buffer.str();
+  png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+               channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png_ptr, info_ptr);
+  for (int y = 0; y < height; y++) {
+    png_write_row(png_ptr, const_cast<png_bytep>(row(y)));
+  }
+  png_write_end(png_ptr, info_ptr);
+
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  return out;
 }
 
-std::string store_gray_to_png_string(
-    boost::gil::gray8_image_t::view_t image_view) {
-  boost::filesystem::path temp = boost::filesystem::temp_directory_path() /
-                                 boost::filesystem::unique_path();
-
-  // The destructor needs to be called so we can properly read the file in the
-  // following lines
-  {
-    boost::gil::detail::png_writer writer(temp.native().c_str());
-    writer.apply(image_view);
+png_row_writer::png_row_writer(const std::string &filename, int width,
+                               int height, int channels,
+                               const png_options &options)
+    : out_(filename, std::ios::binary),
+      width_(width),
+      height_(height),
+      channels_(channels),
+      rows_(0),
+      finished_(false),
+      png_ptr_(NULL),
+      info_ptr_(NULL) {
+  if (!out_) throw std::runtime_error("Cannot open " + filename);
+
+  png_structp png_ptr =
+      png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png_ptr == NULL) {
+    throw std::runtime_error("png_create_write_struct failed");
   }
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if (info_ptr == NULL) {
+    png_destroy_write_struct(&png_ptr, NULL);
+    throw std::runtime_error("png_create_info_struct failed");
+  }
+  png_ptr_ = png_ptr;
+  info_ptr_ = info_ptr;
 
-  std::ifstream t(temp.native(), std::ios::binary);
-  std::stringstream buffer;
-  buffer << t.rdbuf();
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    throw std::runtime_error("libpng failed to encode the image");
+  }
 
-  boost::filesystem::remove(temp);
-  return buffer.str();
+  png_set_write_fn(png_ptr, static_cast<std::ostream *>(&out_),
+                   write_png_stream, flush_png_stream);
+  if (options.compression_level >= 0) {
+    png_set_compression_level(png_ptr, options.compression_level);
+  }
+  if (options.filters >= 0) {
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, options.filters);
+  }
+
+  png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+               channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png_ptr, info_ptr);
+}
+
+png_row_writer::~png_row_writer() {
+  try {
+    finish();
+  } catch (const std::runtime_error &) {
+    // Nothing sensible to do with a write error here.
+  }
+  if (png_ptr_ != NULL) {
+    png_structp png_ptr = static_cast<png_structp>(png_ptr_);
+    png_infop info_ptr = static_cast<png_infop>(info_ptr_);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+  }
+}
+
+void png_row_writer::write_row(const uint8_t *row) {
+  if (finished_ || rows_ >= height_) return;
+  png_structp png_ptr = static_cast<png_structp>(png_ptr_);
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    finished_ = true;
+    throw std::runtime_error("libpng failed to encode the image");
+  }
+  png_write_row(png_ptr, const_cast<png_bytep>(row));
+  rows_++;
+}
+
+void png_row_writer::finish() {
+  if (finished_) return;
+  std::vector<uint8_t> black(width_ * channels_, 0);
+  while (rows_ < height_) write_row(black.data());
+
+  png_structp png_ptr = static_cast<png_structp>(png_ptr_);
+  finished_ = true;
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    throw std::runtime_error("libpng failed to encode the image");
+  }
+  png_write_end(png_ptr, static_cast<png_infop>(info_ptr_));
+  out_.close();
+}
+
+int png_row_writer::rows_written() const { return rows_; }
+
+// Rows of both view types are contiguous, interleaved 8 bit samples, which is
+// exactly what libpng expects, so they are handed over without a copy.
+std::string store_rgb_to_png_string(
+    boost::gil::rgb8_image_t::view_t image_view, const png_options &options) {
+  return store_rows_to_png_string(
+      image_view.width(), image_view.height(), 3, [&image_view](int y) {
+        return reinterpret_cast<const uint8_t *>(&*image_view.row_begin(y));
+      }, options);
+}
+
+std::string store_gray_to_png_string(
+    boost::gil::gray8_image_t::view_t image_view, const png_options &options) {
+  return store_rows_to_png_string(
+      image_view.width(), image_view.height(), 1, [&image_view](int y) {
+        return reinterpret_cast<const uint8_t *>(&*image_view.row_begin(y));
+      }, options);
 }
 
 }  // namespace starcoder
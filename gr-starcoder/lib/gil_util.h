@@ -28,16 +28,80 @@
 #include <boost/gil/gil_all.hpp>
 #include <boost/gil/extension/io/png_io.hpp>
 
+#include <cstdint>
 #include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
 
 namespace gr {
 namespace starcoder {
 
+// Encoder settings for the store_*_to_png_string functions. The defaults keep
+// the choices libpng makes by itself.
+struct png_options {
+  png_options() : compression_level(-1), filters(-1) {}
+
+  // zlib compression level from 0 (store) to 9 (smallest), or -1 for the zlib
+  // default.
+  int compression_level;
+  // Bitwise OR of PNG_FILTER_NONE, PNG_FILTER_SUB, ... that libpng may choose
+  // from for each row, or -1 for the libpng default (adaptive over all
+  // filters). PNG_FILTER_NONE with a low level is the fastest combination.
+  int filters;
+};
+
+// Returns the samples of line y (width * channels bytes, interleaved), which
+// must stay valid until the next call.
+typedef std::function<const uint8_t *(int y)> png_row_source;
+
+// These functions encode straight into the returned string, so no temporary
+// files are involved and they are safe to call from several threads at once.
+// They throw std::runtime_error if libpng fails.
+
+// Encodes an 8 bit gray (channels = 1) or RGB (channels = 3) image whose
+// lines are requested in order from row, so it never has to exist as a whole.
+std::string store_rows_to_png_string(
+    int width, int height, int channels, const png_row_source &row,
+    const png_options &options = png_options());
+
+// Encodes an 8 bit gray (channels = 1) or RGB (channels = 3) image into a
+// file as its lines become available, so that only the compressor state is
+// held in memory. Throws std::runtime_error if the file cannot be written or
+// libpng fails.
+class png_row_writer {
+ public:
+  png_row_writer(const std::string &filename, int width, int height,
+                 int channels, const png_options &options = png_options());
+  ~png_row_writer();
+
+  // Appends the next line, width * channels interleaved bytes.
+  void write_row(const uint8_t *row);
+  // Completes the image, filling the lines not written yet with zeros. Called
+  // by the destructor if needed.
+  void finish();
+
+  int rows_written() const;
+
+ private:
+  png_row_writer(const png_row_writer &) = delete;
+  png_row_writer &operator=(const png_row_writer &) = delete;
+
+  std::ofstream out_;
+  int width_, height_, channels_, rows_;
+  bool finished_;
+  // png_structp and png_infop, kept opaque so that png.h stays out of this
+  // header.
+  void *png_ptr_, *info_ptr_;
+};
+
 std::string store_rgb_to_png_string(
-    boost::gil::rgb8_image_t::view_t image_view);
+    boost::gil::rgb8_image_t::view_t image_view,
+    const png_options &options = png_options());
 
 std::string store_gray_to_png_string(
-    boost::gil::gray8_image_t::view_t image_view);
+    boost::gil::gray8_image_t::view_t image_view,
+    const png_options &options = png_options());
 
 }  // namespace starcoder
 }  // namespace gr
@@ -40,6 +40,8 @@
 
 #include "meteor_bit_io.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 namespace gr {
@@ -47,26 +49,30 @@ namespace starcoder {
 namespace meteor {
 
 bit_io_const::bit_io_const(const uint8_t *bytes, int len)
-    : bytes_(bytes), pos_(0) {}
+    : bytes_(bytes),
+      len_(std::max(len, 0)),
+      pos_(0),
+      cache_(0),
+      cache_len_(0) {}
 
 bit_io_const::~bit_io_const() {}
 
-uint32_t bit_io_const::peek_n_bits(int n) {
-  uint32_t result = 0;
-  for (int i = 0; i < n; i++) {
-    int p = pos_ + i;
-    int bit = (bytes_[p >> 3] >> (7 - (p & 7))) & 1;
-    result = (result << 1) | bit;
+void bit_io_const::refill() {
+  int byte = pos_ >> 3;
+  uint64_t word = 0;
+  if (byte + 8 <= len_) {
+    std::memcpy(&word, bytes_ + byte, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+  } else {
+    for (int i = 0; i < 8; i++) {
+      word <<= 8;
+      if (byte + i < len_) word |= bytes_[byte + i];
+    }
   }
-  return result;
-}
-
-void bit_io_const::advance_n_bits(int n) { pos_ += n; }
-
-uint32_t bit_io_const::fetch_n_bits(int n) {
-  uint32_t result = peek_n_bits(n);
-  advance_n_bits(n);
-  return result;
+  cache_ = word << (pos_ & 7);
+  cache_len_ = 64 - (pos_ & 7);
 }
 
 bit_io::bit_io(uint8_t *bytes, int len)
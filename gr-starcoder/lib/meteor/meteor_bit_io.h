@@ -42,23 +42,50 @@
 #define INCLUDED_METEOR_BIT_IO_H
 
 #include <array>
+#include <cstdint>
 
 namespace gr {
 namespace starcoder {
 namespace meteor {
 
+// Reads a byte string MSB first. The next bits are kept left aligned in a
+// 64 bit cache, which is refilled with a single unaligned load. Bits past len
+// bytes read as zero.
 class bit_io_const {
  private:
   const uint8_t *bytes_;
+  int len_;
   int pos_;
+  uint64_t cache_;
+  int cache_len_;
+
+  void refill();
 
  public:
   bit_io_const(const uint8_t *bytes, int len);
   ~bit_io_const();
 
-  uint32_t peek_n_bits(int n);
-  void advance_n_bits(int n);
-  uint32_t fetch_n_bits(int n);
+  // n must not exceed 32.
+  inline uint32_t peek_n_bits(int n) {
+    if (cache_len_ < n) refill();
+    // Two shifts so that n == 0 does not shift by 64.
+    return static_cast<uint32_t>((cache_ >> 1) >> (63 - n));
+  }
+
+  inline void advance_n_bits(int n) {
+    pos_ += n;
+    cache_ <<= n;
+    cache_len_ -= n;
+  }
+
+  inline uint32_t fetch_n_bits(int n) {
+    uint32_t result = peek_n_bits(n);
+    advance_n_bits(n);
+    return result;
+  }
+
+  // True once more bits have been consumed than there are in the data.
+  inline bool overrun() const { return pos_ > 8 * len_; }
 };
 
 class bit_io {
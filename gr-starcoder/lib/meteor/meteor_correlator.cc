@@ -43,10 +43,160 @@
 #include <iostream>
 #include <algorithm>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define METEOR_CORR_X86 1
+#include <immintrin.h>
+#endif
+
 namespace gr {
 namespace starcoder {
 namespace meteor {
 
+namespace {
+
+// Packs the sign bits of data (bytes > 127) LSB first into out, which must
+// be zeroed.
+void pack_hard_bits(const unsigned char *data, int len, uint64_t *out) {
+  int i = 0;
+#ifdef __SSE2__
+  for (; i + 64 <= len; i += 64) {
+    uint64_t w = 0;
+    for (int j = 0; j < 4; j++) {
+      __m128i v = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(data + i + 16 * j));
+      w |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(v)))
+           << (16 * j);
+    }
+    out[i / 64] = w;
+  }
+#endif
+  for (; i < len; i++) {
+    out[i / 64] |= static_cast<uint64_t>(data[i] >> 7) << (i % 64);
+  }
+}
+
+// The 64 hard decisions starting at bit i.
+inline uint64_t window_at(const uint64_t *bits, int i) {
+  int w = i >> 6;
+  int s = i & 63;
+  uint64_t result = bits[w] >> s;
+  if (s != 0) result |= bits[w + 1] << (64 - s);
+  return result;
+}
+
+// Updates the best correlation of pattern n found so far. Returns true when
+// the correlation is good enough to stop searching.
+inline bool update_best(int n, int corr, int i, int *correlation,
+                        int *position) {
+  if (corr > correlation[n]) {
+    correlation[n] = corr;
+    position[n] = i;
+    if (corr > CORR_LIMIT) return true;
+  }
+  return false;
+}
+
+// Both scan functions return the pattern index that exceeded CORR_LIMIT, or
+// -1 after searching all positions. They are inlined into the target
+// specific wrappers below so that the popcounts compile to the best
+// instruction available.
+inline int scan_scalar(const uint64_t *bits, int positions,
+                       const uint64_t *patts, int *correlation,
+                       int *position) {
+  for (int i = 0; i < positions; i++) {
+    uint64_t w = window_at(bits, i);
+    for (int n = 0; n < PATTERN_COUNT; n++) {
+      int corr = __builtin_popcountll(w ^ patts[n]);
+      if (update_best(n, corr, i, correlation, position)) return n;
+    }
+  }
+  return -1;
+}
+
+int scan_generic(const uint64_t *bits, int positions, const uint64_t *patts,
+                 int *correlation, int *position) {
+  return scan_scalar(bits, positions, patts, correlation, position);
+}
+
+#ifdef METEOR_CORR_X86
+
+__attribute__((target("popcnt"))) int scan_popcnt(const uint64_t *bits,
+                                                  int positions,
+                                                  const uint64_t *patts,
+                                                  int *correlation,
+                                                  int *position) {
+  return scan_scalar(bits, positions, patts, correlation, position);
+}
+
+// Per 64 bit lane popcount using the nibble lookup (pshufb) method.
+__attribute__((target("avx2"))) inline __m256i popcount_epi64(__m256i v) {
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1,
+                       2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i lo = _mm256_and_si256(v, low_mask);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+  __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                _mm256_shuffle_epi8(lookup, hi));
+  return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) int scan_avx2(const uint64_t *bits,
+                                              int positions,
+                                              const uint64_t *patts,
+                                              int *correlation,
+                                              int *position) {
+  const __m256i patts_lo =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(patts));
+  const __m256i patts_hi =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(patts + 4));
+  __m256i best_lo = _mm256_setr_epi64x(correlation[0], correlation[1],
+                                       correlation[2], correlation[3]);
+  __m256i best_hi = _mm256_setr_epi64x(correlation[4], correlation[5],
+                                       correlation[6], correlation[7]);
+
+  for (int i = 0; i < positions; i++) {
+    __m256i w = _mm256_set1_epi64x(window_at(bits, i));
+    __m256i corr_lo = popcount_epi64(_mm256_xor_si256(w, patts_lo));
+    __m256i corr_hi = popcount_epi64(_mm256_xor_si256(w, patts_hi));
+
+    // Scores rarely improve once the search is under way, so only fall back
+    // to the ordered scalar update when one of them did.
+    int improved = _mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpgt_epi64(corr_lo, best_lo),
+        _mm256_cmpgt_epi64(corr_hi, best_hi)));
+    if (improved == 0) continue;
+
+    alignas(32) int64_t corr[PATTERN_COUNT];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(corr), corr_lo);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(corr + 4), corr_hi);
+    for (int n = 0; n < PATTERN_COUNT; n++) {
+      if (update_best(n, corr[n], i, correlation, position)) return n;
+    }
+    best_lo = _mm256_setr_epi64x(correlation[0], correlation[1],
+                                 correlation[2], correlation[3]);
+    best_hi = _mm256_setr_epi64x(correlation[4], correlation[5],
+                                 correlation[6], correlation[7]);
+  }
+  return -1;
+}
+
+#endif  // METEOR_CORR_X86
+
+typedef int (*scan_function)(const uint64_t *, int, const uint64_t *, int *,
+                             int *);
+
+scan_function select_scan() {
+#ifdef METEOR_CORR_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return scan_avx2;
+  if (__builtin_cpu_supports("popcnt")) return scan_popcnt;
+#endif
+  return scan_generic;
+}
+
+}  // namespace
+
 correlator::correlator(uint64_t q_word) {
   init_corr_tables();
   for (int i = 0; i < 4; i++) {
@@ -111,6 +261,11 @@ void correlator::corr_set_patt(int n, uint64_t p) {
     else
       patts_[i][n] = 0;
   }
+
+  packed_patts_[n] = 0;
+  for (int i = 0; i < PATTERN_SIZE; i++) {
+    if (patts_[i][n] == 0xff) packed_patts_[n] |= static_cast<uint64_t>(1) << i;
+  }
 }
 
 void correlator::fix_packet(unsigned char *data, int len, int shift) {
@@ -153,6 +308,42 @@ void correlator::corr_reset() {
 
 std::tuple<uint32_t, uint32_t, uint32_t> correlator::corr_correlate(
     const unsigned char *data, uint32_t len) {
+  static const scan_function scan = select_scan();
+
+  corr_reset();
+
+  // One spare word so that window_at() may always read bits[w + 1].
+  hard_bits_.assign(len / 64 + 2, 0);
+  pack_hard_bits(data, len, hard_bits_.data());
+
+  int n = scan(hard_bits_.data(), len - PATTERN_SIZE, packed_patts_.data(),
+               correlation_.data(), position_.data());
+  if (n >= 0) return std::make_tuple(n, position_[n], correlation_[n]);
+
+  int result =
+      std::distance(correlation_.begin(),
+                    std::max_element(correlation_.begin(), correlation_.end()));
+  return std::make_tuple(result, position_[result], correlation_[result]);
+}
+
+std::vector<std::tuple<uint32_t, uint32_t, uint32_t> >
+correlator::corr_candidates() {
+  std::vector<std::tuple<uint32_t, uint32_t, uint32_t> > candidates;
+  for (int n = 0; n < PATTERN_COUNT; n++) {
+    candidates.push_back(std::make_tuple(n, position_[n], correlation_[n]));
+  }
+  // Stable, so that ties keep the order in which corr_correlate() picks.
+  std::stable_sort(
+      candidates.begin(), candidates.end(),
+      [](const std::tuple<uint32_t, uint32_t, uint32_t> &a,
+         const std::tuple<uint32_t, uint32_t, uint32_t> &b) {
+        return std::get<2>(a) > std::get<2>(b);
+      });
+  return candidates;
+}
+
+std::tuple<uint32_t, uint32_t, uint32_t> correlator::corr_correlate_table(
+    const unsigned char *data, uint32_t len) {
   corr_reset();
 
   for (int i = 0; i < len - PATTERN_SIZE; i++) {
@@ -42,7 +42,9 @@
 #define INCLUDED_METEOR_CORRELATOR_H
 
 #include <array>
+#include <cstdint>
 #include <tuple>
+#include <vector>
 
 namespace gr {
 namespace starcoder {
@@ -65,6 +67,13 @@ class correlator {
   ;
   std::array<std::array<int, 256>, 256> corr_table_ {}
   ;
+  // Pattern n with bit k set when patts_[k][n] is 0xff, matching the bit
+  // order of hard_bits_.
+  std::array<uint64_t, PATTERN_COUNT> packed_patts_ {}
+  ;
+  // Hard decisions of the data being correlated, bit k of the stream is bit
+  // k % 64 of word k / 64.
+  std::vector<uint64_t> hard_bits_;
 
   void init_corr_tables();
   unsigned char rotate_iq(unsigned char data, int shift);
@@ -78,8 +87,24 @@ class correlator {
   ~correlator();
 
   void fix_packet(unsigned char *data, int len, int shift);
+
+  // Returns (pattern, position, correlation) of the best match of the sync
+  // word in any of the 8 IQ rotations/flips. Scores all rotations at once
+  // with XOR and popcount over packed hard decisions.
   std::tuple<uint32_t, uint32_t, uint32_t> corr_correlate(
-      const unsigned char *data, uint32_t d_word);
+      const unsigned char *data, uint32_t len);
+
+  // Best match of each IQ rotation/flip in the last corr_correlate(), as
+  // (pattern, position, correlation) sorted by decreasing correlation, so the
+  // first one is what corr_correlate() returned. When corr_correlate() stopped
+  // early on a strong match, the other rotations only cover the data scanned
+  // until then.
+  std::vector<std::tuple<uint32_t, uint32_t, uint32_t> > corr_candidates();
+
+  // Reference implementation of corr_correlate using the per-byte lookup
+  // table. Slower, but returns exactly the same result.
+  std::tuple<uint32_t, uint32_t, uint32_t> corr_correlate_table(
+      const unsigned char *data, uint32_t len);
 };
 
 }  // namespace meteor
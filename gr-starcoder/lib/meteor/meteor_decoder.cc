@@ -40,6 +40,7 @@
 
 #include "meteor_decoder.h"
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -55,7 +56,13 @@ namespace meteor {
 
 static const int MIN_CORRELATION = 45;
 
-static const std::array<uint8_t, 255> PRAND {
+typedef std::chrono::steady_clock stage_clock;
+
+static double seconds_since(stage_clock::time_point start) {
+  return std::chrono::duration<double>(stage_clock::now() - start).count();
+}
+
+const std::array<uint8_t, 255> PRAND {
   0xff, 0x48, 0x0e, 0xc0, 0x9a, 0x0d, 0x70, 0xbc, 0x8e, 0x2c, 0x93, 0xad, 0xa7,
       0xb7, 0x46, 0xce, 0x5a, 0x97, 0x7d, 0xcc, 0x32, 0xa2, 0xbf, 0x3e, 0x0a,
       0x10, 0xf1, 0x88, 0x94, 0xcd, 0xea, 0xb1, 0xfe, 0x90, 0x1d, 0x81, 0x34,
@@ -89,91 +96,185 @@ decoder::decoder()
       corr_(64),
       prev_pos_(0),
       sig_q_(0),
-      last_sync_(0) {}
+      last_sync_(0),
+      bit_errors_(0),
+      ecc_results_(),
+      search_pos_(0),
+      sync_candidates_(1),
+      erasure_decoding_(true) {}
 
 decoder::~decoder() {}
 
-void decoder::do_next_correlate(const unsigned char *raw,
-                                unsigned char *aligned) {
+void decoder::do_next_correlate() {
   cpos_ = 0;
-  std::copy(raw + pos_, raw + pos_ + SOFT_FRAME_LEN, aligned);
   prev_pos_ = pos_;
   pos_ += SOFT_FRAME_LEN;
-
-  correlator_.fix_packet(aligned, SOFT_FRAME_LEN, word_);
 }
 
-bool decoder::do_full_correlate(const unsigned char *raw, int raw_len,
-                                unsigned char *aligned) {
+bool decoder::do_full_correlate(const unsigned char *raw, int raw_len) {
+  search_pos_ = pos_;
+  stage_clock::time_point start = stage_clock::now();
   std::tie(word_, cpos_, corr_) =
       correlator_.corr_correlate(raw + pos_, SOFT_FRAME_LEN);
+  timings_.correlate += seconds_since(start);
 
   if (corr_ < MIN_CORRELATION) {
     prev_pos_ = pos_;
     pos_ += SOFT_FRAME_LEN / 4;
     std::cout << "Not even " << MIN_CORRELATION << " bits found!";
-    if (prev_pos_ + SOFT_FRAME_LEN > raw_len) return false;
-    std::copy(raw + prev_pos_, raw + prev_pos_ + SOFT_FRAME_LEN, aligned);
   } else {
     prev_pos_ = pos_ + cpos_;
     pos_ += SOFT_FRAME_LEN + cpos_;
-    if (prev_pos_ + SOFT_FRAME_LEN > raw_len) return false;
-    std::copy(raw + prev_pos_, raw + prev_pos_ + SOFT_FRAME_LEN, aligned);
   }
-  correlator_.fix_packet(aligned, SOFT_FRAME_LEN, word_);
-  return true;
+  return prev_pos_ + SOFT_FRAME_LEN <= raw_len;
 }
 
-bool decoder::try_frame(const unsigned char *aligned,
-                        uint8_t *error_corrected_data) {
+bool decoder::try_frame(const unsigned char *aligned, frame_result &result) {
+  uint8_t *error_corrected_data = result.data.data();
   std::unique_ptr<uint8_t[]> decoded_deleter(new uint8_t[HARD_FRAME_LEN]());
   uint8_t *decoded = decoded_deleter.get();
-  std::unique_ptr<uint8_t[]> ecc_buf_deleter(new uint8_t[255]());
-  uint8_t *ecc_buf = ecc_buf_deleter.get();
 
+  stage_clock::time_point start = stage_clock::now();
   viterbi_.vit_decode(aligned, decoded);
+  timings_.viterbi += seconds_since(start);
+  start = stage_clock::now();
 
-  last_sync_ = *reinterpret_cast<uint32_t *>(decoded);
+  uint32_t last_sync = *reinterpret_cast<uint32_t *>(decoded);
 
-  if (viterbi_.count_bits(last_sync_ ^ 0xE20330E5) <
-      viterbi_.count_bits(last_sync_ ^ 0x1DFCCF1A)) {
+  if (viterbi_.count_bits(last_sync ^ 0xE20330E5) <
+      viterbi_.count_bits(last_sync ^ 0x1DFCCF1A)) {
     for (int j = 0; j < HARD_FRAME_LEN; j++) {
       decoded[j] = decoded[j] ^ 0xFFFFFFFF;
     }
-    last_sync_ = last_sync_ ^ 0xFFFFFFFF;
+    last_sync = last_sync ^ 0xFFFFFFFF;
   }
+  result.last_sync = last_sync;
+  result.bit_errors = viterbi_.ber();
 
   for (int j = 0; j < HARD_FRAME_LEN - 4; j++) {
     decoded[4 + j] = decoded[4 + j] ^ PRAND[j % 255];
   }
-  for (int j = 0; j < 4; j++) {
-    ecc_deinterleave(decoded + 4, ecc_buf, j, 4);
-    ecc_results_[j] = ecc_decode(ecc_buf, 0);
-    ecc_interleave(ecc_buf, error_corrected_data, j, 4);
+  std::copy(decoded + 4, decoded + 4 + 255 * ECC_INTERLEAVE,
+            error_corrected_data);
+  if (erasure_decoding_) {
+    ecc_decode_interleaved(error_corrected_data, viterbi_.reliability() + 4,
+                           result.ecc_results);
+  } else {
+    ecc_decode_interleaved(error_corrected_data, result.ecc_results);
   }
+  timings_.ecc += seconds_since(start);
 
-  return (ecc_results_[0] != -1) && (ecc_results_[1] != -1) &&
-         (ecc_results_[2] != -1) && (ecc_results_[3] != -1);
+  return (result.ecc_results[0] != -1) && (result.ecc_results[1] != -1) &&
+         (result.ecc_results[2] != -1) && (result.ecc_results[3] != -1);
 }
 
-bool decoder::decode_one_frame(const unsigned char *raw, int raw_len,
-                               uint8_t *error_corrected_data) {
+void decoder::decode_frame(const unsigned char *raw, int pos, uint32_t word,
+                           frame_result &result) {
   std::unique_ptr<uint8_t[]> u_aligned(new uint8_t[SOFT_FRAME_LEN]());
   uint8_t *aligned = u_aligned.get();
+
+  stage_clock::time_point start = stage_clock::now();
+  std::copy(raw + pos, raw + pos + SOFT_FRAME_LEN, aligned);
+  correlator_.fix_packet(aligned, SOFT_FRAME_LEN, word);
+  timings_.correlate += seconds_since(start);
+  result.ok = try_frame(aligned, result);
+}
+
+void decoder::load_frame(const unsigned char *raw, int raw_len, int pos,
+                         uint32_t word, frame_result &result) {
+  decode_frame(raw, pos, word, result);
+}
+
+void decoder::load_frames(const unsigned char *raw, int raw_len,
+                          const std::vector<frame_candidate> &candidates,
+                          std::vector<frame_result> &results) {
+  bool found = false;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (found) {
+      results[i].ok = false;
+      continue;
+    }
+    load_frame(raw, raw_len, candidates[i].pos, candidates[i].word,
+               results[i]);
+    found = results[i].ok;
+  }
+}
+
+bool decoder::adopt_frame(const frame_result &frame,
+                          uint8_t *error_corrected_data) {
+  last_sync_ = frame.last_sync;
+  bit_errors_ = frame.bit_errors;
+  ecc_results_ = frame.ecc_results;
+  std::copy(frame.data.begin(), frame.data.begin() + 255 * ECC_INTERLEAVE,
+            error_corrected_data);
+  return frame.ok;
+}
+
+bool decoder::use_frame(const unsigned char *raw, int raw_len,
+                        uint8_t *error_corrected_data) {
+  load_frame(raw, raw_len, prev_pos_, word_, frame_);
+  return adopt_frame(frame_, error_corrected_data);
+}
+
+bool decoder::use_candidates(const unsigned char *raw, int raw_len,
+                             uint8_t *error_corrected_data) {
+  std::vector<std::tuple<uint32_t, uint32_t, uint32_t> > matches =
+      correlator_.corr_candidates();
+
+  // The first candidate is the one picked by do_full_correlate(), so that
+  // the result is never worse than with a single candidate.
+  candidates_.clear();
+  candidates_.push_back(frame_candidate{ prev_pos_, word_ });
+  std::vector<uint32_t> correlations(1, corr_);
+  for (const auto &match : matches) {
+    if (int(candidates_.size()) >= sync_candidates_) break;
+    uint32_t word, cpos, corr;
+    std::tie(word, cpos, corr) = match;
+    int pos = search_pos_ + cpos;
+    if (corr < MIN_CORRELATION) break;
+    if (pos + SOFT_FRAME_LEN > raw_len) continue;
+    if (word == word_ && pos == prev_pos_) continue;
+    candidates_.push_back(frame_candidate{ pos, word });
+    correlations.push_back(corr);
+  }
+
+  candidate_results_.resize(candidates_.size());
+  load_frames(raw, raw_len, candidates_, candidate_results_);
+
+  for (size_t i = 0; i < candidates_.size(); i++) {
+    if (!candidate_results_[i].ok) continue;
+    if (i > 0) {
+      // Resynchronize on the match that decoded.
+      word_ = candidates_[i].word;
+      corr_ = correlations[i];
+      cpos_ = candidates_[i].pos - search_pos_;
+      prev_pos_ = candidates_[i].pos;
+      pos_ = prev_pos_ + SOFT_FRAME_LEN;
+    }
+    return adopt_frame(candidate_results_[i], error_corrected_data);
+  }
+  return adopt_frame(candidate_results_[0], error_corrected_data);
+}
+
+bool decoder::decode_one_frame(const unsigned char *raw, int raw_len,
+                               uint8_t *error_corrected_data) {
   bool result = false;
 
   if (cpos_ == 0) {
-    do_next_correlate(raw, aligned);
+    do_next_correlate();
 
-    result = try_frame(aligned, error_corrected_data);
+    result = use_frame(raw, raw_len, error_corrected_data);
 
     if (!result) pos_ -= SOFT_FRAME_LEN;
   }
 
   if (!result) {
-    if (!do_full_correlate(raw, raw_len, aligned)) return false;
+    if (!do_full_correlate(raw, raw_len)) return false;
 
-    result = try_frame(aligned, error_corrected_data);
+    if (sync_candidates_ > 1)
+      result = use_candidates(raw, raw_len, error_corrected_data);
+    else
+      result = use_frame(raw, raw_len, error_corrected_data);
   }
 
   return result;
@@ -185,6 +286,29 @@ int decoder::pos() { return pos_; }
 
 int decoder::prev_pos() { return prev_pos_; }
 
+uint32_t decoder::correlation() { return corr_; }
+
+int decoder::bit_errors() { return bit_errors_; }
+
+std::array<int, 4> decoder::ecc_results() { return ecc_results_; }
+
+decoder_timings decoder::timings() { return timings_; }
+
+void decoder::set_sync_candidates(int count) {
+  sync_candidates_ = std::max(1, std::min(count, PATTERN_COUNT));
+}
+
+void decoder::set_erasure_decoding(bool enabled) {
+  erasure_decoding_ = enabled;
+}
+
+bool decoder::erasure_decoding() const { return erasure_decoding_; }
+
+void decoder::rebase(int offset) {
+  pos_ -= offset;
+  prev_pos_ -= offset;
+}
+
 }  // namespace meteor
 }  // namespace starcoder
 }  // namespace gr
@@ -42,6 +42,8 @@
 #define INCLUDED_METEOR_DECODER_H
 
 #include <array>
+#include <atomic>
+#include <vector>
 #include "meteor_correlator.h"
 #include "meteor_viterbi.h"
 
@@ -53,30 +55,126 @@ const int HARD_FRAME_LEN = 1024;
 const int FRAME_BITS = HARD_FRAME_LEN * 8;
 const int SOFT_FRAME_LEN = FRAME_BITS * 2;
 
+// Pseudo random sequence XORed over everything after the sync word of a
+// frame, repeating every 255 bytes.
+extern const std::array<uint8_t, 255> PRAND;
+
+// Outcome of decoding the frame at one position of the soft symbol stream.
+struct frame_result {
+  bool ok;
+  uint32_t last_sync;
+  // Channel bits corrected by the Viterbi decoder, see viterbi::ber().
+  int bit_errors;
+  // Symbols corrected in each RS codeword, -1 if it was uncorrectable.
+  std::array<int, 4> ecc_results;
+  std::array<uint8_t, HARD_FRAME_LEN> data;
+};
+
+// A sync word match to try: the soft symbol position of the frame and the
+// word that fixes its IQ rotation.
+struct frame_candidate {
+  int pos;
+  uint32_t word;
+};
+
+// Wall clock time spent in each stage, accumulated over the life of a
+// decoder.
+struct decoder_timings {
+  decoder_timings() : correlate(0), viterbi(0), ecc(0) {}
+
+  // Sync word search and IQ rotation fix.
+  double correlate;
+  double viterbi;
+  // Derandomization and Reed-Solomon decoding.
+  double ecc;
+};
+
 class decoder {
  private:
-  bool do_full_correlate(const unsigned char *raw, int raw_len,
-                         unsigned char *aligned);
-  void do_next_correlate(const unsigned char *raw, unsigned char *aligned);
-  bool try_frame(const unsigned char *aligned, uint8_t *error_corrected_data);
+  bool do_full_correlate(const unsigned char *raw, int raw_len);
+  void do_next_correlate();
+  bool try_frame(const unsigned char *aligned, frame_result &result);
+  bool use_frame(const unsigned char *raw, int raw_len,
+                 uint8_t *error_corrected_data);
+  bool use_candidates(const unsigned char *raw, int raw_len,
+                      uint8_t *error_corrected_data);
+  bool adopt_frame(const frame_result &frame, uint8_t *error_corrected_data);
 
   correlator correlator_;
   viterbi viterbi_;
+  frame_result frame_;
 
   uint32_t word_, cpos_, corr_, last_sync_;
+  int bit_errors_;
   std::array<int, 4> ecc_results_;
   int sig_q_, pos_, prev_pos_;
+  // Where the last full sync search started.
+  int search_pos_;
+  int sync_candidates_;
+  // Read by the workers of a parallel_decoder while it may be toggled.
+  std::atomic<bool> erasure_decoding_;
+  std::vector<frame_candidate> candidates_;
+  std::vector<frame_result> candidate_results_;
+  decoder_timings timings_;
+
+ protected:
+  // Called whenever the decoder needs the frame at pos with IQ fix word.
+  // Decodes it in place, subclasses may provide it from elsewhere.
+  virtual void load_frame(const unsigned char *raw, int raw_len, int pos,
+                          uint32_t word, frame_result &result);
+  // Decodes candidates in order into results, which has the same size, and
+  // may stop at the first one that is ok, leaving the following ones not ok.
+  // Subclasses may decode them concurrently.
+  virtual void load_frames(const unsigned char *raw, int raw_len,
+                           const std::vector<frame_candidate> &candidates,
+                           std::vector<frame_result> &results);
 
  public:
   bool decode_one_frame(const unsigned char *raw, int raw_len,
                         uint8_t *error_corrected_data);
 
+  // Decodes the frame at pos of raw after fixing its IQ rotation with word.
+  // Does not change the synchronization state.
+  void decode_frame(const unsigned char *raw, int pos, uint32_t word,
+                    frame_result &result);
+
+  // When the frame that follows the last good one fails, the sync search
+  // keeps the best match of each IQ rotation. Up to count of them, best
+  // correlation first, are decoded and the first whose Reed-Solomon decode
+  // succeeds is used, which helps at low SNR when the best correlation is
+  // not the right one. 1, the default, only tries the best match.
+  void set_sync_candidates(int count);
+
+  // When a Reed-Solomon codeword has too many errors, decode it again with
+  // erasures taken from the Viterbi soft output and from the corrections of
+  // the other codewords of the frame. Only costs time on frames that would
+  // fail otherwise. On by default.
+  void set_erasure_decoding(bool enabled);
+  bool erasure_decoding() const;
+
   decoder();
-  ~decoder();
+  virtual ~decoder();
+
+  // Stops any worker threads, once the frames they are decoding are done.
+  // The decoder must not be used afterwards.
+  virtual void shutdown() {}
 
   uint32_t last_sync();
   int pos();
   int prev_pos();
+  // Link quality of the last frame decode_one_frame() tried. The correlation
+  // (matching bits of the 64 bit sync word) is that of the last sync search,
+  // frames that follow a good one are not searched again.
+  uint32_t correlation();
+  int bit_errors();
+  std::array<int, 4> ecc_results();
+  // Only covers frames decoded by this object, not by the workers of a
+  // parallel_decoder.
+  decoder_timings timings();
+
+  // Drops the first offset bytes of the raw stream, so that the caller can
+  // discard already decoded data and pass a buffer starting at offset.
+  void rebase(int offset);
 };
 
 }  // namespace meteor
@@ -0,0 +1,334 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "meteor_demod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define METEOR_DEMOD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+namespace {
+
+// Length of the matched filter, in symbols.
+const int RRC_SPAN = 8;
+// Adaptation rate of the symbol amplitude estimate.
+const float AMPLITUDE_RATE = 1.0 / 1024;
+// Maximum deviation of the symbol period from the nominal one.
+const float MAX_PERIOD_DEVIATION = 0.005;
+// Average |phase error| of the Costas detector above which the carrier is
+// considered unlocked: about 0.72 for random phases, 0.58 when locked at an
+// Es/N0 of 0 dB.
+const float UNLOCKED_PHASE_ERROR = 0.65;
+// Bandwidth of the Costas loop while unlocked, relative to the tracking one.
+const float ACQUISITION_BW_FACTOR = 4;
+
+std::complex<float> fir_scalar(const float *samples, const float *taps,
+                               int len) {
+  float re = 0, im = 0;
+  for (int k = 0; k < len; k++) {
+    re += samples[2 * k] * taps[2 * k];
+    im += samples[2 * k + 1] * taps[2 * k + 1];
+  }
+  return std::complex<float>(re, im);
+}
+
+#ifdef METEOR_DEMOD_X86
+
+// acc holds re, im, re, im partial sums.
+__attribute__((target("sse"))) inline std::complex<float> reduce_sse(
+    __m128 acc) {
+  alignas(16) float sums[4];
+  _mm_store_ps(sums, acc);
+  return std::complex<float>(sums[0] + sums[2], sums[1] + sums[3]);
+}
+
+__attribute__((target("sse"))) std::complex<float> fir_sse(
+    const float *samples, const float *taps, int len) {
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for (int k = 0; k < 2 * len; k += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(samples + k),
+                                       _mm_loadu_ps(taps + k)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(samples + k + 4),
+                                       _mm_loadu_ps(taps + k + 4)));
+  }
+  return reduce_sse(_mm_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx"))) std::complex<float> fir_avx(
+    const float *samples, const float *taps, int len) {
+  __m256 acc = _mm256_setzero_ps();
+  for (int k = 0; k < 2 * len; k += 8) {
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(samples + k),
+                                           _mm256_loadu_ps(taps + k)));
+  }
+  return reduce_sse(_mm_add_ps(_mm256_castps256_ps128(acc),
+                               _mm256_extractf128_ps(acc, 1)));
+}
+
+#endif  // METEOR_DEMOD_X86
+
+fir_impl best_fir_impl() {
+#ifdef METEOR_DEMOD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx")) return FIR_AVX;
+  if (__builtin_cpu_supports("sse")) return FIR_SSE;
+#endif
+  return FIR_SCALAR;
+}
+
+// Proportional and integral gains of a critically damped second order loop
+// with bandwidth bw, in radians per update.
+void loop_gains(float bw, float &alpha, float &beta) {
+  const float damping = std::sqrt(2.0) / 2;
+  float denominator = 1 + 2 * damping * bw + bw * bw;
+  alpha = 4 * damping * bw / denominator;
+  beta = 4 * bw * bw / denominator;
+}
+
+inline float clamp(float x, float limit) {
+  return std::max(-limit, std::min(limit, x));
+}
+
+inline float sign(float x) { return std::copysign(1.0f, x); }
+
+// Complex product without the inf/NaN recovery of operator*, which does
+// not inline. Likewise std::norm() goes through hypot() without fast math.
+inline std::complex<float> multiply(std::complex<float> a,
+                                    std::complex<float> b) {
+  return std::complex<float>(a.real() * b.real() - a.imag() * b.imag(),
+                             a.real() * b.imag() + a.imag() * b.real());
+}
+
+// Rotates the unit phasor p by -angle, for the small angles of a loop
+// update, and pulls its magnitude back to 1.
+inline std::complex<float> rotate(std::complex<float> p, float angle) {
+  p = multiply(p, std::complex<float>(1 - angle * angle / 2, -angle));
+  float norm = p.real() * p.real() + p.imag() * p.imag();
+  return p * (1.5f - 0.5f * norm);
+}
+
+inline int8_t soft_bit(float x) {
+  return static_cast<int8_t>(std::lrint(clamp(x, 127)));
+}
+
+}  // namespace
+
+fir_kernel select_fir_kernel(fir_impl impl) {
+  fir_impl best = best_fir_impl();
+  if (impl == FIR_AUTO) impl = best;
+
+  switch (impl) {
+#ifdef METEOR_DEMOD_X86
+    case FIR_AVX:
+      if (best == FIR_AVX) return fir_avx;
+      break;
+    case FIR_SSE:
+      if (best == FIR_AVX || best == FIR_SSE) return fir_sse;
+      break;
+#endif
+    case FIR_SCALAR:
+      return fir_scalar;
+    default:
+      break;
+  }
+  return NULL;
+}
+
+std::vector<float> rrc_taps(double samples_per_symbol, float alpha,
+                            int span) {
+  int len = 2 * static_cast<int>(span * samples_per_symbol / 2) + 1;
+  std::vector<float> taps(len);
+  double sum = 0;
+  for (int i = 0; i < len; i++) {
+    double t = (i - (len - 1) / 2) / samples_per_symbol;
+    double h;
+    if (t == 0) {
+      h = 1 - alpha + 4 * alpha / M_PI;
+    } else if (std::abs(std::abs(4 * alpha * t) - 1) < 1e-9) {
+      h = alpha / std::sqrt(2.0) *
+          ((1 + 2 / M_PI) * std::sin(M_PI / (4 * alpha)) +
+           (1 - 2 / M_PI) * std::cos(M_PI / (4 * alpha)));
+    } else {
+      h = (std::sin(M_PI * t * (1 - alpha)) +
+           4 * alpha * t * std::cos(M_PI * t * (1 + alpha))) /
+          (M_PI * t * (1 - (4 * alpha * t) * (4 * alpha * t)));
+    }
+    taps[i] = h;
+    sum += h;
+  }
+  for (auto &tap : taps) tap /= sum;
+  return taps;
+}
+
+const float qpsk_demod::SOFT_SCALE = 64;
+
+qpsk_demod::qpsk_demod(double samp_rate, double symbol_rate, float rrc_alpha,
+                       float costas_bw, float timing_bw, fir_impl impl)
+    : samp_rate_(samp_rate),
+      fir_(select_fir_kernel(impl)),
+      head_(0),
+      nco_(1),
+      nco_step_(1),
+      freq_(0),
+      window_(),
+      mid_symbol_(true),
+      mid_(0),
+      last_(0),
+      amplitude_(0),
+      phase_error_(1) {
+  if (samp_rate < symbol_rate * (1 + rrc_alpha)) {
+    throw std::invalid_argument(
+        "Sample rate too low for the RRC filter bandwidth");
+  }
+  if (fir_ == NULL) {
+    throw std::invalid_argument("FIR kernel not supported by this CPU");
+  }
+
+  nominal_period_ = samp_rate / symbol_rate;
+  period_ = nominal_period_;
+  min_period_ = nominal_period_ * (1 - MAX_PERIOD_DEVIATION);
+  max_period_ = nominal_period_ * (1 + MAX_PERIOD_DEVIATION);
+  mu_ = nominal_period_ / 2;
+
+  // The kernels need a multiple of 4 taps, so the oldest ones are padded
+  // with zeros.
+  std::vector<float> taps = rrc_taps(nominal_period_, rrc_alpha, RRC_SPAN);
+  taps_len_ = (taps.size() + 3) / 4 * 4;
+  taps.insert(taps.begin(), taps_len_ - taps.size(), 0);
+  taps_.resize(2 * taps_len_);
+  for (int k = 0; k < taps_len_; k++) {
+    taps_[2 * k] = taps_[2 * k + 1] = taps[taps_len_ - 1 - k];
+  }
+  history_.assign(4 * taps_len_, 0);
+
+  loop_gains(costas_bw, costas_alpha_, costas_beta_);
+  loop_gains(costas_bw * ACQUISITION_BW_FACTOR, acquisition_alpha_,
+             acquisition_beta_);
+  loop_gains(timing_bw, timing_alpha_, timing_beta_);
+  // A quarter of the symbol rate would alias onto another QPSK phase.
+  max_freq_ = M_PI / 4 / nominal_period_;
+}
+
+int qpsk_demod::work(const std::complex<float> *in, int in_len, int8_t *out,
+                     int out_len, int &consumed) {
+  int produced = 0;
+  int i = 0;
+  // There are more than one sample per symbol, so strobes are more than half
+  // a sample apart and a sample completes at most one symbol.
+  for (; i < in_len && produced + 2 <= out_len; i++) {
+    history_[2 * head_] = history_[2 * (head_ + taps_len_)] = in[i].real();
+    history_[2 * head_ + 1] = history_[2 * (head_ + taps_len_) + 1] =
+        in[i].imag();
+    head_ = head_ + 1 == taps_len_ ? 0 : head_ + 1;
+    std::complex<float> filtered =
+        fir_(&history_[2 * head_], taps_.data(), taps_len_);
+
+    window_[0] = window_[1];
+    window_[1] = window_[2];
+    window_[2] = window_[3];
+    window_[3] = multiply(filtered, nco_);
+    nco_ = multiply(nco_, nco_step_);
+
+    mu_ -= 1;
+    while (mu_ < 1) {
+      // Cubic Lagrange interpolation at mu_ between window_[1] and
+      // window_[2].
+      float u = mu_;
+      float c0 = -u * (u - 1) * (u - 2) / 6;
+      float c1 = (u + 1) * (u - 1) * (u - 2) / 2;
+      float c2 = -(u + 1) * u * (u - 2) / 2;
+      float c3 = (u + 1) * u * (u - 1) / 6;
+      std::complex<float> sample = c0 * window_[0] + c1 * window_[1] +
+                                   c2 * window_[2] + c3 * window_[3];
+
+      if (mid_symbol_) {
+        mid_ = sample;
+        mu_ += period_ / 2;
+      } else {
+        strobe(sample);
+        out[produced++] = soft_bit(last_.real() * SOFT_SCALE);
+        out[produced++] = soft_bit(last_.imag() * SOFT_SCALE);
+      }
+      mid_symbol_ = !mid_symbol_;
+    }
+  }
+  consumed = i;
+  return produced;
+}
+
+void qpsk_demod::strobe(std::complex<float> sample) {
+  float amplitude = std::abs(sample.real()) + std::abs(sample.imag());
+  if (amplitude_ == 0) amplitude_ = amplitude;
+  amplitude_ += (amplitude - amplitude_) * AMPLITUDE_RATE;
+  // Components of unit average amplitude.
+  float gain = amplitude_ > 0 ? 2 / amplitude_ : 0;
+  std::complex<float> symbol = sample * gain;
+  std::complex<float> mid = mid_ * gain;
+
+  // Gardner detector, positive when the strobes are late.
+  float timing_error = clamp((symbol.real() - last_.real()) * mid.real() +
+                                 (symbol.imag() - last_.imag()) * mid.imag(),
+                             1);
+  period_ = std::max(
+      min_period_,
+      std::min(max_period_,
+               period_ - timing_beta_ * timing_error * nominal_period_));
+  mu_ += period_ / 2 - timing_alpha_ * timing_error * nominal_period_;
+
+  // QPSK Costas detector, positive when the constellation is rotated
+  // counterclockwise.
+  float phase_error = clamp(sign(symbol.real()) * symbol.imag() -
+                                sign(symbol.imag()) * symbol.real(),
+                            1);
+  phase_error_ += (std::abs(phase_error) - phase_error_) * AMPLITUDE_RATE;
+  bool locked = phase_error_ < UNLOCKED_PHASE_ERROR;
+  float alpha = locked ? costas_alpha_ : acquisition_alpha_;
+  float beta = locked ? costas_beta_ : acquisition_beta_;
+  float freq = clamp(freq_ + beta * phase_error / nominal_period_, max_freq_);
+  nco_ = rotate(nco_, alpha * phase_error);
+  nco_step_ = rotate(nco_step_, freq - freq_);
+  freq_ = freq;
+
+  last_ = symbol;
+}
+
+double qpsk_demod::frequency_offset() const {
+  return freq_ * samp_rate_ / (2 * M_PI);
+}
+
+double qpsk_demod::samples_per_symbol() const { return period_; }
+
+bool qpsk_demod::locked() const {
+  return phase_error_ < UNLOCKED_PHASE_ERROR;
+}
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
@@ -0,0 +1,132 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_METEOR_DEMOD_H
+#define INCLUDED_METEOR_DEMOD_H
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+const double LRPT_SYMBOL_RATE = 72000;
+const float LRPT_RRC_ALPHA = 0.6;
+
+enum fir_impl {
+  FIR_AUTO = 0,
+  FIR_SCALAR,
+  FIR_SSE,
+  FIR_AVX
+};
+
+// Filters one complex sample with real taps: returns the sum of
+// samples[k] * taps[k] over len complex samples. samples holds interleaved
+// I/Q floats and taps holds each tap twice, so that both run in the same
+// order. len must be a multiple of 4.
+typedef std::complex<float> (*fir_kernel)(const float *samples,
+                                          const float *taps, int len);
+
+// Returns the kernel for the requested implementation. FIR_AUTO picks the
+// widest kernel the running CPU supports; an explicitly requested kernel the
+// CPU cannot run yields NULL. The kernels only differ by rounding.
+fir_kernel select_fir_kernel(fir_impl impl);
+
+// Root raised cosine taps with unit gain at DC, spanning span symbols.
+std::vector<float> rrc_taps(double samples_per_symbol, float alpha, int span);
+
+// QPSK demodulator for Meteor M2 LRPT, from complex baseband to the 8 bit
+// soft symbols meteor::decoder expects. Matched filtering, carrier recovery
+// (a Costas loop) and timing recovery (a Gardner detector with a cubic
+// interpolator) run in a single pass over each sample, and the symbols are
+// scaled by a running estimate of their amplitude, so no AGC is needed in
+// front of it.
+//
+// The remaining phase ambiguity (multiples of 90 degrees, and I/Q swaps) is
+// resolved by the decoder's sync word search.
+class qpsk_demod {
+ public:
+  // Loop bandwidths are normalized to the symbol rate. Throws
+  // std::invalid_argument when samp_rate cannot hold the RRC bandwidth,
+  // symbol_rate * (1 + rrc_alpha).
+  qpsk_demod(double samp_rate, double symbol_rate = LRPT_SYMBOL_RATE,
+             float rrc_alpha = LRPT_RRC_ALPHA, float costas_bw = 0.005,
+             float timing_bw = 0.005, fir_impl impl = FIR_AUTO);
+
+  // Demodulates samples from in until either all in_len are consumed or out
+  // has no room for another symbol. Each symbol is written as two soft bits,
+  // I then Q. Returns the number of bytes written to out, and the number of
+  // samples used in consumed.
+  int work(const std::complex<float> *in, int in_len, int8_t *out,
+           int out_len, int &consumed);
+
+  // Current carrier offset estimate, in Hz.
+  double frequency_offset() const;
+  // Current symbol period estimate, in samples.
+  double samples_per_symbol() const;
+  // Whether the Costas loop tracks the carrier. While unlocked, it runs with
+  // a wider bandwidth to pull in large frequency offsets.
+  bool locked() const;
+
+ private:
+  // Soft bit value of a symbol component of average amplitude.
+  static const float SOFT_SCALE;
+
+  void strobe(std::complex<float> sample);
+
+  double samp_rate_;
+  fir_kernel fir_;
+  int taps_len_;
+  // Each tap twice, oldest sample first.
+  std::vector<float> taps_;
+  // Two copies of the last taps_len_ samples, so that the filter window is
+  // always contiguous.
+  std::vector<float> history_;
+  int head_;
+
+  // Carrier NCO: the rotation applied to the current sample and its change
+  // per sample, which matches freq_ in radians per sample.
+  std::complex<float> nco_, nco_step_;
+  float freq_, max_freq_;
+  float costas_alpha_, costas_beta_, acquisition_alpha_, acquisition_beta_;
+
+  // Filtered samples for the interpolator, newest last.
+  std::array<std::complex<float>, 4> window_;
+  // Time of the next strobe after window_[1], and the nominal, current and
+  // allowed range of the symbol period, in samples.
+  float mu_, nominal_period_, period_, min_period_, max_period_;
+  float timing_alpha_, timing_beta_;
+  bool mid_symbol_;
+  std::complex<float> mid_, last_;
+
+  // Running average of |I| + |Q| of the symbols.
+  float amplitude_;
+  // Running average of |phase error|, to detect loss of carrier lock.
+  float phase_error_;
+};
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_METEOR_DEMOD_H */
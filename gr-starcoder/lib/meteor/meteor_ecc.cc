@@ -42,6 +42,13 @@
 #include "meteor_ecc.h"
 #include <iostream>
 #include <algorithm>
+#include <numeric>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define METEOR_ECC_X86 1
+#include <immintrin.h>
+#endif
 
 namespace gr {
 namespace starcoder {
@@ -99,6 +106,161 @@ static const std::array<uint8_t, 33> POLY_ARR {
 }
 ;
 
+namespace {
+
+typedef std::array<std::array<uint8_t, 32>, ECC_INTERLEAVE> syndrome_array;
+typedef void (*syndrome_function)(const uint8_t *, syndrome_array &);
+
+#ifdef METEOR_ECC_X86
+
+uint8_t gf_mul(uint8_t a, uint8_t b) {
+  if (a == 0 || b == 0) return 0;
+  return ALPHA_ARR[(IDX_ARR[a] + IDX_ARR[b]) % 255];
+}
+
+// Syndrome i is the codeword evaluated at ROOT_i = alpha^((112 + i) * 11) by
+// Horner's rule. With vectors of `symbols` interleaved symbols, lane k holds
+// the Horner sum of every symbols-th symbol, which is multiplied by
+// ROOT_i^symbols at each step. GF(256) multiplication by a constant is linear,
+// so it is done with two 16 entry pshufb lookups, one per nibble.
+template <int symbols>
+struct syndrome_tables {
+  // lo[i][x] = ROOT_i^symbols * x, hi[i][x] = ROOT_i^symbols * (x << 4).
+  alignas(16) uint8_t lo[32][16];
+  alignas(16) uint8_t hi[32][16];
+  // lane[i][k] = ROOT_i^(symbols - 1 - k), to combine the lanes at the end.
+  uint8_t lane[32][symbols];
+
+  syndrome_tables() {
+    for (int i = 0; i < 32; i++) {
+      int root = (112 + i) * 11 % 255;
+      uint8_t step = ALPHA_ARR[root * symbols % 255];
+      for (int x = 0; x < 16; x++) {
+        lo[i][x] = gf_mul(step, x);
+        hi[i][x] = gf_mul(step, x << 4);
+      }
+      for (int k = 0; k < symbols; k++) {
+        lane[i][k] = ALPHA_ARR[root * (symbols - 1 - k) % 255];
+      }
+    }
+  }
+
+  // Sums the lanes of acc (lane k * ECC_INTERLEAVE + j belongs to codeword
+  // j) into the syndrome i of each codeword.
+  void combine(int i, const uint8_t *acc, syndrome_array &s) const {
+    for (int j = 0; j < ECC_INTERLEAVE; j++) {
+      uint8_t sum = 0;
+      for (int k = 0; k < symbols; k++) {
+        sum ^= gf_mul(acc[k * ECC_INTERLEAVE + j], lane[i][k]);
+      }
+      s[j][i] = sum;
+    }
+  }
+};
+
+// The 255 symbols are preceded by a zero symbol, which does not change the
+// syndromes, so that the 256 symbols fill a whole number of vectors.
+const int PADDED_LEN = 256 * ECC_INTERLEAVE;
+
+void pad_codewords(const uint8_t *data, uint8_t *padded) {
+  std::fill(padded, padded + ECC_INTERLEAVE, 0);
+  std::copy(data, data + 255 * ECC_INTERLEAVE, padded + ECC_INTERLEAVE);
+}
+
+__attribute__((target("ssse3"))) inline __m128i gf_mul_ssse3(__m128i x,
+                                                              __m128i lo,
+                                                              __m128i hi) {
+  const __m128i low_mask = _mm_set1_epi8(0x0f);
+  return _mm_xor_si128(
+      _mm_shuffle_epi8(lo, _mm_and_si128(x, low_mask)),
+      _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(x, 4), low_mask)));
+}
+
+__attribute__((target("ssse3"))) void syndromes_ssse3(const uint8_t *data,
+                                                      syndrome_array &s) {
+  static const syndrome_tables<4> tables;
+  alignas(16) uint8_t padded[PADDED_LEN];
+  pad_codewords(data, padded);
+
+  // Four syndromes at a time to hide the latency of each Horner chain.
+  for (int i = 0; i < 32; i += 4) {
+    __m128i lo[4], hi[4], acc[4];
+    for (int n = 0; n < 4; n++) {
+      lo[n] = _mm_load_si128(
+          reinterpret_cast<const __m128i *>(tables.lo[i + n]));
+      hi[n] = _mm_load_si128(
+          reinterpret_cast<const __m128i *>(tables.hi[i + n]));
+      acc[n] = _mm_setzero_si128();
+    }
+    for (int b = 0; b < PADDED_LEN; b += 16) {
+      __m128i x = _mm_load_si128(reinterpret_cast<const __m128i *>(padded + b));
+      for (int n = 0; n < 4; n++) {
+        acc[n] = _mm_xor_si128(gf_mul_ssse3(acc[n], lo[n], hi[n]), x);
+      }
+    }
+    for (int n = 0; n < 4; n++) {
+      alignas(16) uint8_t lanes[16];
+      _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc[n]);
+      tables.combine(i + n, lanes, s);
+    }
+  }
+}
+
+__attribute__((target("avx2"))) inline __m256i gf_mul_avx2(__m256i x,
+                                                            __m256i lo,
+                                                            __m256i hi) {
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  return _mm256_xor_si256(
+      _mm256_shuffle_epi8(lo, _mm256_and_si256(x, low_mask)),
+      _mm256_shuffle_epi8(hi,
+                          _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask)));
+}
+
+__attribute__((target("avx2"))) void syndromes_avx2(const uint8_t *data,
+                                                    syndrome_array &s) {
+  static const syndrome_tables<8> tables;
+  alignas(32) uint8_t padded[PADDED_LEN];
+  pad_codewords(data, padded);
+
+  for (int i = 0; i < 32; i += 4) {
+    __m256i lo[4], hi[4], acc[4];
+    for (int n = 0; n < 4; n++) {
+      // pshufb looks up within each 128 bit lane, so both need the table.
+      lo[n] = _mm256_broadcastsi128_si256(
+          _mm_load_si128(reinterpret_cast<const __m128i *>(tables.lo[i + n])));
+      hi[n] = _mm256_broadcastsi128_si256(
+          _mm_load_si128(reinterpret_cast<const __m128i *>(tables.hi[i + n])));
+      acc[n] = _mm256_setzero_si256();
+    }
+    for (int b = 0; b < PADDED_LEN; b += 32) {
+      __m256i x =
+          _mm256_load_si256(reinterpret_cast<const __m256i *>(padded + b));
+      for (int n = 0; n < 4; n++) {
+        acc[n] = _mm256_xor_si256(gf_mul_avx2(acc[n], lo[n], hi[n]), x);
+      }
+    }
+    for (int n = 0; n < 4; n++) {
+      alignas(32) uint8_t lanes[32];
+      _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc[n]);
+      tables.combine(i + n, lanes, s);
+    }
+  }
+}
+
+#endif  // METEOR_ECC_X86
+
+// Returns NULL when the syndromes have to be computed one codeword at a time.
+syndrome_function select_syndromes() {
+#ifdef METEOR_ECC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return syndromes_avx2;
+  if (__builtin_cpu_supports("ssse3")) return syndromes_ssse3;
+#endif
+  return NULL;
+}
+
+}  // namespace
+
 void ecc_deinterleave(const uint8_t *data, uint8_t *output, int pos, int n) {
   for (int i = 0; i < 255; i++) {
     output[i] = data[i * n + pos];
@@ -131,11 +293,36 @@ void ecc_encode(uint8_t *data, int pad) {
   }
 }
 
-int ecc_decode(uint8_t *data, int pad) {
+// Computes the 32 syndromes of a codeword (not yet in log form).
+static void ecc_syndromes(const uint8_t *data, int pad, uint8_t *s) {
+  for (int i = 0; i < 32; i++)
+    s[i] = data[0];
+  for (int j = 1; j < 255 - pad; j++) {
+    for (int i = 0; i < 32; i++) {
+      if (s[i] == 0) {
+        s[i] = data[j];
+      } else {
+        s[i] = data[j] ^ ALPHA_ARR[(IDX_ARR[s[i]] + (112 + i) * 11) % 255];
+      }
+    }
+  }
+}
+
+// x modulo 255 without a division, for exponents of alpha.
+static inline int modnn(int x) {
+  while (x >= 255) {
+    x -= 255;
+    x = (x >> 8) + (x & 255);
+  }
+  return x;
+}
+
+// Corrects data given its syndromes s, which are overwritten, and the
+// positions of erasure_count erasures, indexes into data.
+static int ecc_correct(uint8_t *data, int pad, uint8_t *s,
+                       const int *erasures = NULL, int erasure_count = 0) {
   std::array<uint8_t, 32> root {}
   ;
-  std::array<uint8_t, 32> s {}
-  ;
   std::array<uint8_t, 32> loc {}
   ;
   std::array<uint8_t, 33> lambda {}
@@ -147,18 +334,6 @@ int ecc_decode(uint8_t *data, int pad) {
   uint8_t q;
   int result = 0;
 
-  for (int i = 0; i < 32; i++)
-    s[i] = data[0];
-  for (int j = 1; j < 255 - pad; j++) {
-    for (int i = 0; i < 32; i++) {
-      if (s[i] == 0) {
-        s[i] = data[j];
-      } else {
-        s[i] = data[j] ^ ALPHA_ARR[(IDX_ARR[s[i]] + (112 + i) * 11) % 255];
-      }
-    }
-  }
-
   int syn_error = 0;
   for (int i = 0; i < 32; i++) {
     syn_error = syn_error | s[i];
@@ -168,19 +343,28 @@ int ecc_decode(uint8_t *data, int pad) {
   if (syn_error == 0) return 0;  // No errors!
 
   lambda[0] = 1;
+  // Start from the erasure locator polynomial, the product of
+  // (1 + x * alpha^(11 * (254 - position))) over the erasures.
+  for (int i = 0; i < erasure_count; i++) {
+    int u = modnn(11 * (254 - erasures[i] - pad));
+    for (int j = i + 1; j > 0; j--) {
+      uint8_t tmp = IDX_ARR[lambda[j - 1]];
+      if (tmp != 255) lambda[j] = lambda[j] ^ ALPHA_ARR[modnn(u + tmp)];
+    }
+  }
 
   for (int i = 0; i < 33; i++) {
     b[i] = IDX_ARR[lambda[i]];
   }
-  int r = 1;
-  int el = 0;
+  int r = erasure_count + 1;
+  int el = erasure_count;
 
   while (r <= 32) {
     uint8_t discr_r = 0;
     for (int i = 0; i < r; i++) {
       if (lambda[i] != 0 && s[r - i - 1] != 255) {
         discr_r =
-            discr_r ^ ALPHA_ARR[(IDX_ARR[lambda[i]] + s[r - i - 1]) % 255];
+            discr_r ^ ALPHA_ARR[modnn(IDX_ARR[lambda[i]] + s[r - i - 1])];
       }
     }
     discr_r = IDX_ARR[discr_r];
@@ -191,17 +375,17 @@ int ecc_decode(uint8_t *data, int pad) {
       t[0] = lambda[0];
       for (int i = 0; i < 32; i++) {
         if (b[i] != 255)
-          t[i + 1] = lambda[i + 1] ^ ALPHA_ARR[(discr_r + b[i]) % 255];
+          t[i + 1] = lambda[i + 1] ^ ALPHA_ARR[modnn(discr_r + b[i])];
         else
           t[i + 1] = lambda[i + 1];
       }
-      if (2 * el <= r - 1) {
-        el = r - el;
+      if (2 * el <= r + erasure_count - 1) {
+        el = r + erasure_count - el;
         for (int i = 0; i < 32; i++) {
           if (lambda[i] == 0)
             b[i] = 255;
           else
-            b[i] = (uint8_t)((IDX_ARR[lambda[i]] - discr_r + 255) % 255);
+            b[i] = (uint8_t)(modnn(IDX_ARR[lambda[i]] - discr_r + 255));
         }
       } else {
         std::move_backward(b.begin(), b.end() - 1, b.end());
@@ -229,14 +413,16 @@ int ecc_decode(uint8_t *data, int pad) {
     int q = 1;
     for (int j = deg_lambda; j > 0; j--) {
       if (reg[j] != 255) {
-        reg[j] = (uint8_t)((reg[j] + j) % 255);
+        // reg[j] < 255 and j <= 32, so one subtraction reduces modulo 255.
+        int e = reg[j] + j;
+        reg[j] = e >= 255 ? e - 255 : e;
         q = q ^ ALPHA_ARR[reg[j]];
       }
     }
 
     if (q != 0) {
       i++;
-      k = (k + 116) % 255;
+      k = modnn(k + 116);
       continue;
     }
     root[result] = i;
@@ -245,7 +431,7 @@ int ecc_decode(uint8_t *data, int pad) {
     if (result == deg_lambda) break;
 
     i++;
-    k = (k + 116) % 255;
+    k = modnn(k + 116);
   }
 
   if (deg_lambda != result) return -1;
@@ -255,7 +441,7 @@ int ecc_decode(uint8_t *data, int pad) {
     uint8_t tmp = 0;
     for (int j = i; j > -1; j--) {
       if (s[i - j] != 255 && lambda[j] != 255)
-        tmp = tmp ^ ALPHA_ARR[(s[i - j] + lambda[j]) % 255];
+        tmp = tmp ^ ALPHA_ARR[modnn(s[i - j] + lambda[j])];
     }
     omega[i] = IDX_ARR[tmp];
   }
@@ -264,9 +450,9 @@ int ecc_decode(uint8_t *data, int pad) {
     uint8_t num1 = 0;
     for (int i = deg_omega; i > -1; i--) {
       if (omega[i] != 255)
-        num1 = num1 ^ ALPHA_ARR[(omega[i] + i * root[j]) % 255];
+        num1 = num1 ^ ALPHA_ARR[modnn(omega[i] + i * root[j])];
     }
-    uint8_t num2 = ALPHA_ARR[(root[j] * 111 + 255) % 255];
+    uint8_t num2 = ALPHA_ARR[modnn(root[j] * 111 + 255)];
     uint8_t den = 0;
 
     if (deg_lambda < 31)
@@ -278,20 +464,134 @@ int ecc_decode(uint8_t *data, int pad) {
     while (true) {
       if (i < 0) break;
       if (lambda[i + 1] != 255)
-        den = den ^ ALPHA_ARR[(lambda[i + 1] + i * root[j]) % 255];
+        den = den ^ ALPHA_ARR[modnn(lambda[i + 1] + i * root[j])];
       i -= 2;
     }
 
     if (num1 != 0 && loc[j] >= pad) {
       data[loc[j] - pad] =
           data[loc[j] - pad] ^
-          ALPHA_ARR[(IDX_ARR[num1] + IDX_ARR[num2] + 255 - IDX_ARR[den]) % 255];
+          ALPHA_ARR[modnn(IDX_ARR[num1] + IDX_ARR[num2] + 255 - IDX_ARR[den])];
     }
   }
 
   return result;
 }
 
+int ecc_decode(uint8_t *data, int pad) {
+  std::array<uint8_t, 32> s {}
+  ;
+  ecc_syndromes(data, pad, s.data());
+  return ecc_correct(data, pad, s.data());
+}
+
+int ecc_decode_erasures(uint8_t *data, int pad, const int *erasures,
+                        int count) {
+  std::array<uint8_t, 32> s {}
+  ;
+  ecc_syndromes(data, pad, s.data());
+  return ecc_correct(data, pad, s.data(), erasures, count);
+}
+
+void ecc_decode_interleaved(uint8_t *data,
+                            std::array<int, ECC_INTERLEAVE> &results) {
+  static const syndrome_function syndromes = select_syndromes();
+
+  std::array<std::array<uint8_t, 32>, ECC_INTERLEAVE> s;
+  std::array<uint8_t, 255> codeword;
+
+  if (syndromes != NULL) {
+    syndromes(data, s);
+  } else {
+    for (int j = 0; j < ECC_INTERLEAVE; j++) {
+      ecc_deinterleave(data, codeword.data(), j, ECC_INTERLEAVE);
+      ecc_syndromes(codeword.data(), 0, s[j].data());
+    }
+  }
+
+  for (int j = 0; j < ECC_INTERLEAVE; j++) {
+    // Clean codewords are by far the most common case.
+    if (std::all_of(s[j].begin(), s[j].end(),
+                    [](uint8_t x) { return x == 0; })) {
+      results[j] = 0;
+      continue;
+    }
+    ecc_deinterleave(data, codeword.data(), j, ECC_INTERLEAVE);
+    results[j] = ecc_correct(codeword.data(), 0, s[j].data());
+    ecc_interleave(codeword.data(), data, j, ECC_INTERLEAVE);
+  }
+}
+
+// Erasure decoding tries 2, 4, ... erasures up to MAX_ERASURES. Beyond 16,
+// too few symbols are left to tell a wrong correction from a right one.
+static const int ERASURE_STEP = 2;
+static const int MAX_ERASURES = 16;
+// Bytes within this distance of a symbol corrected in another codeword are
+// erased first: Viterbi errors come in bursts, which the interleaving spreads
+// over neighbouring codewords.
+static const int BURST_REACH = 2;
+
+void ecc_decode_interleaved(uint8_t *data, const int16_t *reliability,
+                            std::array<int, ECC_INTERLEAVE> &results) {
+  const int len = 255 * ECC_INTERLEAVE;
+  std::vector<uint8_t> received(data, data + len);
+  ecc_decode_interleaved(data, results);
+  if (std::none_of(results.begin(), results.end(),
+                   [](int r) { return r == -1; }))
+    return;
+
+  std::vector<bool> in_burst(len, false);
+  auto mark_corrections = [&](int j) {
+    for (int d = j; d < len; d += ECC_INTERLEAVE) {
+      if (data[d] == received[d]) continue;
+      for (int k = std::max(0, d - BURST_REACH);
+           k <= std::min(len - 1, d + BURST_REACH); k++) {
+        in_burst[k] = true;
+      }
+    }
+  };
+  for (int j = 0; j < ECC_INTERLEAVE; j++) {
+    if (results[j] > 0) mark_corrections(j);
+  }
+
+  // Each codeword recovered tells more about the bursts, so go on until no
+  // codeword is recovered.
+  std::array<uint8_t, 255> codeword, corrected;
+  std::array<uint8_t, 32> syndromes, s;
+  std::array<int, 255> order, score;
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (int j = 0; j < ECC_INTERLEAVE; j++) {
+      if (results[j] != -1) continue;
+      ecc_deinterleave(data, codeword.data(), j, ECC_INTERLEAVE);
+      ecc_syndromes(codeword.data(), 0, syndromes.data());
+      for (int i = 0; i < 255; i++) {
+        const int d = i * ECC_INTERLEAVE + j;
+        score[i] = reliability[d] - (in_burst[d] ? 65536 : 0);
+      }
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(),
+                       [&score](int a, int b) { return score[a] < score[b]; });
+
+      for (int count = ERASURE_STEP; count <= MAX_ERASURES;
+           count += ERASURE_STEP) {
+        // The syndromes do not depend on the erasures.
+        corrected = codeword;
+        s = syndromes;
+        int result =
+            ecc_correct(corrected.data(), 0, s.data(), order.data(), count);
+        if (result == -1) continue;
+        results[j] = result;
+        ecc_interleave(corrected.data(), data, j, ECC_INTERLEAVE);
+        mark_corrections(j);
+        progress = true;
+        break;
+      }
+    }
+  }
+}
+
 }  // namespace meteor
 }  // namespace starcoder
 }  // namespace gr
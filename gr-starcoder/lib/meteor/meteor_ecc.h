@@ -41,6 +41,7 @@
 #define INCLUDED_METEOR_ECC_H
 
 #include <array>
+#include <cstdint>
 
 namespace gr {
 namespace starcoder {
@@ -52,8 +53,31 @@ void ecc_interleave(const uint8_t *data, uint8_t *output, int pos, int n);
 
 int ecc_decode(uint8_t *data, int pad);
 
+// Like ecc_decode, given the positions (indexes into data, all different) of
+// count bytes known to be unreliable. Corrects any errors and erasures with
+// 2 * errors + count <= 32, instead of up to 16 errors.
+int ecc_decode_erasures(uint8_t *data, int pad, const int *erasures,
+                        int count);
+
 void ecc_encode(uint8_t *data, int pad);
 
+const int ECC_INTERLEAVE = 4;
+
+// Decodes the ECC_INTERLEAVE codewords interleaved in data (255 *
+// ECC_INTERLEAVE bytes, no padding) in place. results[j] receives what
+// ecc_decode returns for codeword j. The syndromes of all codewords are
+// computed at once with SIMD where the CPU supports it, and codewords without
+// errors skip the rest of the decoder.
+void ecc_decode_interleaved(uint8_t *data,
+                            std::array<int, ECC_INTERLEAVE> &results);
+
+// Like the above, but codewords it cannot correct are decoded again with
+// erasures: first the bytes next to symbols corrected in the other codewords,
+// then the bytes with the lowest reliability (one value per byte of data, see
+// viterbi::reliability()). This recovers codewords with more than 16 errors.
+void ecc_decode_interleaved(uint8_t *data, const int16_t *reliability,
+                            std::array<int, ECC_INTERLEAVE> &results);
+
 }  // namespace meteor
 }  // namespace starcoder
 }  // namespace gr
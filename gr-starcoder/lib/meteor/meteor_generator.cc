@@ -0,0 +1,368 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "meteor_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "meteor_decoder.h"
+#include "meteor_demod.h"
+#include "meteor_ecc.h"
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+static const uint32_t SYNC_WORD = 0x1ACFFC1D;
+static const int CVCDU_LEN = 892;
+static const int CVCDU_HEADER_LEN = 10;
+static const int PACKET_HEADER_LEN = 14;
+static const int NO_PACKET_HEADER = 2047;
+// Version 1, spacecraft 0 and virtual channel 5, as sent by Meteor M2.
+static const uint16_t CVCDU_ID = 0x4005;
+static const int TIME_APID = 70;
+static const int MIN_QUALITY = 10;
+// Soft symbol amplitude without noise, the level qpsk_demod settles to.
+static const float SOFT_AMPLITUDE = 64;
+// Onboard time of the first row, and 8 lines every 4/3 seconds after it.
+static const int START_TIME_MS = 12 * 3600 * 1000;
+static const int ROW_PERIOD_MS = 1333;
+
+// Codes of the DC categories, whose lengths are DC_CAT_OFF.
+static const std::array<uint16_t, 12> DC_CODES {
+  0x000, 0x002, 0x003, 0x004, 0x005, 0x006, 0x00e, 0x01e, 0x03e, 0x07e,
+      0x0fe, 0x1fe
+}
+;
+
+namespace {
+
+// Writes bits MSB first, padding the last byte with ones like JPEG does.
+class bit_writer {
+ public:
+  explicit bit_writer(std::vector<uint8_t> &out)
+      : out_(out), cur_(0), cur_len_(0) {}
+
+  void write(uint32_t bits, int n) {
+    for (int i = n - 1; i >= 0; i--) {
+      cur_ = (cur_ << 1) | ((bits >> i) & 1);
+      if (++cur_len_ == 8) {
+        out_.push_back(cur_);
+        cur_ = 0;
+        cur_len_ = 0;
+      }
+    }
+  }
+
+  void flush() {
+    if (cur_len_ > 0) write(0xff, 8 - cur_len_);
+  }
+
+ private:
+  std::vector<uint8_t> &out_;
+  uint8_t cur_;
+  int cur_len_;
+};
+
+}  // namespace
+
+// Number of bits of |value|, the JPEG magnitude category.
+static int category(int value) {
+  int cat = 0;
+  for (int v = std::abs(value); v != 0; v >>= 1) cat++;
+  return cat;
+}
+
+// The low cat bits of value, or of value - 1 when negative, which imager's
+// map_range undoes.
+static uint32_t magnitude_bits(int value, int cat) {
+  if (value < 0) value += (1 << cat) - 1;
+  return value & ((1 << cat) - 1);
+}
+
+static int parity(uint32_t x) { return __builtin_parity(x); }
+
+generator_options::generator_options()
+    : seconds(60),
+      snr_db(std::numeric_limits<float>::infinity()),
+      rotation(0),
+      flip_iq(false),
+      quality(80),
+      seed(1) {}
+
+generator::generator(const image_store &image,
+                     const generator_options &options)
+    : image_(image),
+      options_(options),
+      frame_count_(0),
+      row_(0),
+      packet_count_(0),
+      packet_off_(0),
+      encoder_state_(0),
+      noise_sigma_(0),
+      rng_(options.seed) {
+  if (image.width() != 8 * MCU_PER_LINE || image.lines() == 0 ||
+      image.lines() % 8 != 0) {
+    throw std::invalid_argument(
+        "generator: the image must be 8 * MCU_PER_LINE wide with a multiple "
+        "of 8 lines");
+  }
+  frames_ = std::ceil(options.seconds * 2 * LRPT_SYMBOL_RATE / SOFT_FRAME_LEN);
+  if (std::isfinite(options.snr_db)) {
+    noise_sigma_ = SOFT_AMPLITUDE / std::pow(10.f, options.snr_db / 20);
+  }
+
+  huffman_code none = { 0, 0 };
+  ac_codes_.fill(none);
+  for (const ac_table_rec &rec : huffman_tables::get().ac_table) {
+    huffman_code code = { static_cast<uint16_t>(rec.code),
+                          static_cast<uint16_t>(rec.len) };
+    ac_codes_[rec.run * 16 + rec.size] = code;
+  }
+
+  // The JPEG forward DCT, F(u, v) = sum over x and y of
+  // f(x, y) * basis[x][u] * basis[y][v].
+  for (int x = 0; x < 8; x++) {
+    for (int u = 0; u < 8; u++) {
+      double c = u == 0 ? std::sqrt(0.5) : 1;
+      dct_basis_[x][u] = c / 2 * std::cos((2 * x + 1) * u * M_PI / 16);
+    }
+  }
+}
+
+int generator::frames() const { return frames_; }
+
+int generator::frame_count() const { return frame_count_; }
+
+void generator::encode_mcus(int plane, int row, int mcu_id, int q,
+                            std::vector<uint8_t> &out) {
+  std::array<int, 64> dqt;
+  fill_dqt_by_q(dqt, q);
+
+  bit_writer bits(out);
+  int prev_dc = 0;
+  for (int m = 0; m < MCU_PER_PACKET; m++) {
+    const int x0 = (mcu_id + m) * 8;
+    std::array<float, 64> pixels, rows;
+    for (int i = 0; i < 64; i++) {
+      pixels[i] = image_.row(plane, row * 8 + i / 8)[x0 + i % 8] - 128.f;
+    }
+    // Horizontal then vertical pass of the separable transform.
+    for (int y = 0; y < 8; y++) {
+      for (int u = 0; u < 8; u++) {
+        float s = 0;
+        for (int x = 0; x < 8; x++) s += pixels[y * 8 + x] * dct_basis_[x][u];
+        rows[y * 8 + u] = s;
+      }
+    }
+    std::array<int, 64> zz;
+    for (int v = 0; v < 8; v++) {
+      for (int u = 0; u < 8; u++) {
+        float s = 0;
+        for (int y = 0; y < 8; y++) s += rows[y * 8 + u] * dct_basis_[y][v];
+        int i = v * 8 + u;
+        int c = std::lround(s / dqt[i]);
+        zz[ZIGZAG[i]] = std::max(-1023, std::min(1023, c));
+      }
+    }
+
+    int diff = zz[0] - prev_dc;
+    prev_dc = zz[0];
+    int cat = category(diff);
+    bits.write(DC_CODES[cat], DC_CAT_OFF[cat]);
+    bits.write(magnitude_bits(diff, cat), cat);
+
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+      if (zz[k] == 0) {
+        run++;
+        continue;
+      }
+      for (; run > 15; run -= 16) {
+        bits.write(ac_codes_[15 * 16].code, ac_codes_[15 * 16].len);
+      }
+      int size = category(zz[k]);
+      const huffman_code &code = ac_codes_[run * 16 + size];
+      bits.write(code.code, code.len);
+      bits.write(magnitude_bits(zz[k], size), size);
+      run = 0;
+    }
+    if (run > 0) bits.write(ac_codes_[0].code, ac_codes_[0].len);
+  }
+  bits.flush();
+}
+
+void generator::queue_packet(int apid, const std::vector<uint8_t> &payload) {
+  const int len = PACKET_HEADER_LEN + payload.size();
+  const uint32_t ms = START_TIME_MS + row_ * ROW_PERIOD_MS;
+
+  std::vector<uint8_t> packet(PACKET_HEADER_LEN);
+  // Secondary header present.
+  packet[0] = 0x08 | (apid >> 8);
+  packet[1] = apid & 0xff;
+  // Unsegmented.
+  packet[2] = 0xc0 | ((packet_count_ >> 8) & 0x3f);
+  packet[3] = packet_count_ & 0xff;
+  packet[4] = (len - 7) >> 8;
+  packet[5] = (len - 7) & 0xff;
+  packet[8] = ms >> 24;
+  packet[9] = (ms >> 16) & 0xff;
+  packet[10] = (ms >> 8) & 0xff;
+  packet[11] = ms & 0xff;
+  packet.insert(packet.end(), payload.begin(), payload.end());
+
+  packets_.push_back(std::move(packet));
+  packet_count_ = (packet_count_ + 1) & 0x3fff;
+}
+
+void generator::queue_row() {
+  const int row = row_ % (image_.lines() / 8);
+  // imager expects this order of the channels within a row.
+  const int apids[] = { BLUE_APID, GREEN_APID, RED_APID };
+  const int planes[] = { 2, 1, 0 };
+
+  for (int c = 0; c < 3; c++) {
+    for (int mcu_id = 0; mcu_id < MCU_PER_LINE; mcu_id += MCU_PER_PACKET) {
+      std::vector<uint8_t> payload;
+      // Like the satellite, lower the quality of busy parts of the image
+      // instead of sending long packets.
+      for (int q = options_.quality;; q = std::max(MIN_QUALITY, q - 10)) {
+        payload.assign(6, 0);
+        payload[0] = mcu_id;
+        payload[3] = 0xff;
+        payload[4] = 0xf0;
+        payload[5] = q;
+        encode_mcus(planes[c], row, mcu_id, q, payload);
+        if (PACKET_HEADER_LEN + payload.size() <= MAX_GENERATED_PACKET_LEN ||
+            q == MIN_QUALITY)
+          break;
+      }
+      queue_packet(apids[c], payload);
+    }
+  }
+
+  // The onboard time, which also completes the 43 packets per row imager
+  // counts on.
+  const int ms = START_TIME_MS + row_ * ROW_PERIOD_MS;
+  std::vector<uint8_t> payload(16);
+  payload[8] = ms / 3600000 % 24;
+  payload[9] = ms / 60000 % 60;
+  payload[10] = ms / 1000 % 60;
+  payload[11] = ms % 1000 / 4;
+  queue_packet(TIME_APID, payload);
+
+  row_++;
+}
+
+void generator::build_frame(uint8_t *frame) {
+  frame[0] = SYNC_WORD >> 24;
+  frame[1] = (SYNC_WORD >> 16) & 0xff;
+  frame[2] = (SYNC_WORD >> 8) & 0xff;
+  frame[3] = SYNC_WORD & 0xff;
+
+  uint8_t *cvcdu = frame + 4;
+  std::fill(cvcdu, cvcdu + CVCDU_HEADER_LEN, 0);
+  cvcdu[0] = CVCDU_ID >> 8;
+  cvcdu[1] = CVCDU_ID & 0xff;
+  cvcdu[2] = (frame_count_ >> 16) & 0xff;
+  cvcdu[3] = (frame_count_ >> 8) & 0xff;
+  cvcdu[4] = frame_count_ & 0xff;
+
+  int header_off = NO_PACKET_HEADER;
+  int off = 0;
+  while (off < CVCDU_LEN - CVCDU_HEADER_LEN) {
+    if (packets_.empty()) queue_row();
+    const std::vector<uint8_t> &packet = packets_.front();
+    if (packet_off_ == 0 && header_off == NO_PACKET_HEADER) header_off = off;
+    size_t n = std::min(packet.size() - packet_off_,
+                        size_t(CVCDU_LEN - CVCDU_HEADER_LEN - off));
+    std::copy(packet.begin() + packet_off_, packet.begin() + packet_off_ + n,
+              cvcdu + CVCDU_HEADER_LEN + off);
+    off += n;
+    packet_off_ += n;
+    if (packet_off_ == packet.size()) {
+      packets_.pop_front();
+      packet_off_ = 0;
+    }
+  }
+  cvcdu[8] = header_off >> 8;
+  cvcdu[9] = header_off & 0xff;
+
+  // The codewords are interleaved byte by byte, data and parity alike.
+  std::array<uint8_t, 255> codeword;
+  for (int j = 0; j < ECC_INTERLEAVE; j++) {
+    ecc_deinterleave(cvcdu, codeword.data(), j, ECC_INTERLEAVE);
+    ecc_encode(codeword.data(), 0);
+    ecc_interleave(codeword.data(), cvcdu, j, ECC_INTERLEAVE);
+  }
+}
+
+void generator::encode_frame(const uint8_t *frame, uint8_t *soft) {
+  // The rate 1/2, K = 7 code viterbi decodes: the newest bit enters at the
+  // bottom of the state, and a 1 bit is sent as a negative soft symbol. The
+  // encoder runs on from frame to frame, as on the satellite.
+  const int rotation = options_.rotation & 3;
+  for (int i = 0; i < FRAME_BITS; i++) {
+    uint32_t bit = (frame[i / 8] >> (7 - i % 8)) & 1;
+    encoder_state_ = ((encoder_state_ << 1) | bit) & 0x7f;
+    float s[2] = {
+      parity(encoder_state_ & 79) ? -SOFT_AMPLITUDE : SOFT_AMPLITUDE,
+      parity(encoder_state_ & 109) ? -SOFT_AMPLITUDE : SOFT_AMPLITUDE
+    };
+
+    if (options_.flip_iq) std::swap(s[0], s[1]);
+    for (int r = 0; r < rotation; r++) {
+      // Multiplication by j.
+      float i_val = -s[1];
+      s[1] = s[0];
+      s[0] = i_val;
+    }
+
+    for (int k = 0; k < 2; k++) {
+      float v = s[k];
+      if (noise_sigma_ > 0) v += noise_sigma_ * noise_(rng_);
+      v = std::max(-127.f, std::min(127.f, std::round(v)));
+      soft[2 * i + k] = static_cast<int8_t>(v);
+    }
+  }
+}
+
+bool generator::next_frame(uint8_t *soft, uint8_t *frame) {
+  if (frame_count_ >= frames_) return false;
+
+  std::array<uint8_t, HARD_FRAME_LEN> hard;
+  build_frame(hard.data());
+  if (frame != NULL) std::copy(hard.begin(), hard.end(), frame);
+
+  for (int j = 0; j < HARD_FRAME_LEN - 4; j++) {
+    hard[4 + j] ^= PRAND[j % 255];
+  }
+  encode_frame(hard.data(), soft);
+
+  frame_count_++;
+  return true;
+}
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
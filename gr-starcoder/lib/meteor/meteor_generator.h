@@ -0,0 +1,116 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_METEOR_GENERATOR_H
+#define INCLUDED_METEOR_GENERATOR_H
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "meteor_image.h"
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+// Packets longer than this are coded again at a lower quality, so that they
+// always fit the packeter's reassembly buffer.
+const int MAX_GENERATED_PACKET_LEN = 1024;
+
+struct generator_options {
+  generator_options();
+
+  // Length of the stream in seconds of LRPT_SYMBOL_RATE QPSK symbols.
+  double seconds;
+  // Ratio of the soft symbol amplitude to the standard deviation of the
+  // Gaussian noise added to each soft symbol, in dB. Infinity adds none.
+  float snr_db;
+  // Phase ambiguity left by the simulated demodulator: the constellation is
+  // rotated by rotation * 90 degrees, after swapping I and Q if flip_iq.
+  int rotation;
+  bool flip_iq;
+  // JPEG quality factor of the image packets.
+  int quality;
+  uint32_t seed;
+};
+
+// Builds a Meteor M2 LRPT soft symbol stream carrying an image, for
+// regression tests and benchmarks of decoder and the image pipeline. The
+// image is JPEG coded into packets of MCU_PER_PACKET MCUs per channel,
+// multiplexed into CVCDU frames, Reed-Solomon coded, scrambled with PRAND and
+// convolutionally coded, the reverse of what decoder and packeter do. The
+// image repeats for as long as the stream lasts. The output only depends on
+// the image and the options, seed included.
+class generator {
+ public:
+  // image holds the red, green and blue planes (RED_APID, GREEN_APID and
+  // BLUE_APID) and must be 8 * MCU_PER_LINE wide with a multiple of 8 lines.
+  // Throws std::invalid_argument otherwise.
+  generator(const image_store &image,
+            const generator_options &options = generator_options());
+
+  // Number of frames in the stream.
+  int frames() const;
+  // Frames written so far.
+  int frame_count() const;
+
+  // Writes the next SOFT_FRAME_LEN soft symbols to soft and, if frame is not
+  // NULL, the HARD_FRAME_LEN bytes they encode before scrambling: the sync
+  // word and what decoder returns for the frame. Returns false when the
+  // stream is over.
+  bool next_frame(uint8_t *soft, uint8_t *frame = NULL);
+
+ private:
+  struct huffman_code {
+    uint16_t code;
+    uint16_t len;
+  };
+
+  const image_store &image_;
+  generator_options options_;
+  int frames_, frame_count_;
+  int row_, packet_count_;
+  // Packets waiting to go into frames; the first one is partly sent already.
+  std::deque<std::vector<uint8_t> > packets_;
+  size_t packet_off_;
+  // AC codes indexed by run * 16 + size.
+  std::array<huffman_code, 256> ac_codes_;
+  std::array<std::array<float, 8>, 8> dct_basis_;
+  uint32_t encoder_state_;
+  float noise_sigma_;
+  std::mt19937 rng_;
+  std::normal_distribution<float> noise_;
+
+  void queue_row();
+  void queue_packet(int apid, const std::vector<uint8_t> &payload);
+  void encode_mcus(int plane, int row, int mcu_id, int q,
+                   std::vector<uint8_t> &out);
+  void build_frame(uint8_t *frame);
+  void encode_frame(const uint8_t *frame, uint8_t *soft);
+};
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_METEOR_GENERATOR_H */
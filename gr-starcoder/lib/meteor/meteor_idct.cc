@@ -0,0 +1,238 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "meteor_idct.h"
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define METEOR_IDCT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+namespace {
+
+// One dimensional AAN inverse DCT of d[0] .. d[7], as in libjpeg's
+// jidctflt.c. T is either float or a GCC vector of floats, which runs the
+// same operations in the same order on each lane, so that all kernels give
+// bit identical results.
+template <typename T>
+inline void idct_1d(T *d) {
+  // Even part
+  T tmp10 = d[0] + d[4];
+  T tmp11 = d[0] - d[4];
+  T tmp13 = d[2] + d[6];
+  T tmp12 = (d[2] - d[6]) * 1.414213562f - tmp13;
+
+  T tmp0 = tmp10 + tmp13;
+  T tmp3 = tmp10 - tmp13;
+  T tmp1 = tmp11 + tmp12;
+  T tmp2 = tmp11 - tmp12;
+
+  // Odd part
+  T z13 = d[5] + d[3];
+  T z10 = d[5] - d[3];
+  T z11 = d[1] + d[7];
+  T z12 = d[1] - d[7];
+
+  T tmp7 = z11 + z13;
+  tmp11 = (z11 - z13) * 1.414213562f;
+  T z5 = (z10 + z12) * 1.847759065f;
+  tmp10 = z12 * 1.082392200f - z5;
+  tmp12 = z10 * -2.613125930f + z5;
+
+  T tmp6 = tmp12 - tmp7;
+  T tmp5 = tmp11 - tmp6;
+  T tmp4 = tmp10 + tmp5;
+
+  d[0] = tmp0 + tmp7;
+  d[7] = tmp0 - tmp7;
+  d[1] = tmp1 + tmp6;
+  d[6] = tmp1 - tmp6;
+  d[2] = tmp2 + tmp5;
+  d[5] = tmp2 - tmp5;
+  d[4] = tmp3 + tmp4;
+  d[3] = tmp3 - tmp4;
+}
+
+void idct_scalar(const float *in, float *out) {
+  float ws[64];
+
+  // Columns. A column without AC coefficients transforms to its DC value,
+  // which is common in LRPT images.
+  for (int u = 0; u < 8; u++) {
+    bool ac_zero = true;
+    for (int v = 1; v < 8; v++) ac_zero = ac_zero && in[v * 8 + u] == 0;
+
+    float d[8];
+    for (int v = 0; v < 8; v++) d[v] = in[v * 8 + u];
+    if (!ac_zero) idct_1d(d);
+    for (int v = 0; v < 8; v++) ws[v * 8 + u] = ac_zero ? d[0] : d[v];
+  }
+
+  // Rows
+  for (int y = 0; y < 8; y++) {
+    float d[8];
+    for (int x = 0; x < 8; x++) d[x] = ws[y * 8 + x];
+    idct_1d(d);
+    for (int x = 0; x < 8; x++) out[y * 8 + x] = d[x];
+  }
+}
+
+#ifdef METEOR_IDCT_X86
+
+__attribute__((target("sse"))) void transpose_sse(__m128 *lo, __m128 *hi) {
+  // lo[r] holds columns 0..3 of row r, hi[r] columns 4..7. Transposes the
+  // four 4x4 quadrants and swaps the two off diagonal ones.
+  _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+  _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+  _MM_TRANSPOSE4_PS(lo[4], lo[5], lo[6], lo[7]);
+  _MM_TRANSPOSE4_PS(hi[4], hi[5], hi[6], hi[7]);
+  for (int i = 0; i < 4; i++) {
+    __m128 t = hi[i];
+    hi[i] = lo[i + 4];
+    lo[i + 4] = t;
+  }
+}
+
+__attribute__((target("sse"))) void idct_sse(const float *in, float *out) {
+  __m128 lo[8], hi[8];
+  for (int r = 0; r < 8; r++) {
+    lo[r] = _mm_loadu_ps(in + r * 8);
+    hi[r] = _mm_loadu_ps(in + r * 8 + 4);
+  }
+
+  // Columns, four at a time, then rows after a transpose.
+  idct_1d(lo);
+  idct_1d(hi);
+  transpose_sse(lo, hi);
+  idct_1d(lo);
+  idct_1d(hi);
+  transpose_sse(lo, hi);
+
+  for (int r = 0; r < 8; r++) {
+    _mm_storeu_ps(out + r * 8, lo[r]);
+    _mm_storeu_ps(out + r * 8 + 4, hi[r]);
+  }
+}
+
+__attribute__((target("avx"))) void transpose_avx(__m256 *r) {
+  __m256 t[8], s[8];
+  for (int i = 0; i < 8; i += 2) {
+    t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+    t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+  }
+  for (int i = 0; i < 8; i += 4) {
+    s[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+    s[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+    s[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+    s[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+  }
+  for (int i = 0; i < 4; i++) {
+    r[i] = _mm256_permute2f128_ps(s[i], s[i + 4], 0x20);
+    r[i + 4] = _mm256_permute2f128_ps(s[i], s[i + 4], 0x31);
+  }
+}
+
+__attribute__((target("avx"))) void idct_avx(const float *in, float *out) {
+  __m256 r[8];
+  for (int i = 0; i < 8; i++) r[i] = _mm256_loadu_ps(in + i * 8);
+
+  idct_1d(r);
+  transpose_avx(r);
+  idct_1d(r);
+  transpose_avx(r);
+
+  for (int i = 0; i < 8; i++) _mm256_storeu_ps(out + i * 8, r[i]);
+}
+
+#endif  // METEOR_IDCT_X86
+
+idct_impl best_idct_impl() {
+#ifdef METEOR_IDCT_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx")) return IDCT_AVX;
+  if (__builtin_cpu_supports("sse")) return IDCT_SSE;
+#endif
+  return IDCT_SCALAR;
+}
+
+}  // namespace
+
+void idct_scales(std::array<float, 64> &scales) {
+  // The AAN algorithm leaves out the cos(k * pi / 16) * sqrt(2) factors of
+  // each dimension and the overall 1 / 8 of the 2D inverse DCT.
+  double factor[8];
+  factor[0] = 1;
+  for (int k = 1; k < 8; k++) factor[k] = cos(k * M_PI / 16) * sqrt(2);
+
+  for (int v = 0; v < 8; v++) {
+    for (int u = 0; u < 8; u++) {
+      scales[v * 8 + u] = factor[v] * factor[u] / 8;
+    }
+  }
+}
+
+idct_kernel select_idct_kernel(idct_impl impl) {
+  idct_impl best = best_idct_impl();
+  if (impl == IDCT_AUTO) impl = best;
+
+  switch (impl) {
+#ifdef METEOR_IDCT_X86
+    case IDCT_AVX:
+      if (best == IDCT_AVX) return idct_avx;
+      break;
+    case IDCT_SSE:
+      if (best == IDCT_AVX || best == IDCT_SSE) return idct_sse;
+      break;
+#endif
+    case IDCT_SCALAR:
+      return idct_scalar;
+    default:
+      break;
+  }
+  return NULL;
+}
+
+void idct_8x8_reference(const float *in, float *out) {
+  for (int y = 0; y < 8; y++) {
+    for (int x = 0; x < 8; x++) {
+      double s = 0;
+      for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+          double cu = u == 0 ? 1 / sqrt(2) : 1;
+          double cv = v == 0 ? 1 / sqrt(2) : 1;
+          s += cu * cv * in[v * 8 + u] * cos(M_PI / 16 * (2 * x + 1) * u) *
+               cos(M_PI / 16 * (2 * y + 1) * v);
+        }
+      }
+      out[y * 8 + x] = s / 4;
+    }
+  }
+}
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
@@ -0,0 +1,58 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_METEOR_IDCT_H
+#define INCLUDED_METEOR_IDCT_H
+
+#include <array>
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+enum idct_impl {
+  IDCT_AUTO = 0,
+  IDCT_SCALAR,
+  IDCT_SSE,
+  IDCT_AVX
+};
+
+// Inverse DCT of an 8x8 block of coefficients in natural (row major) order.
+// The kernels implement the separable AAN algorithm, which expects each
+// coefficient to be premultiplied by the matching entry of idct_scales(). The
+// scaling is normally folded into the dequantization table.
+typedef void (*idct_kernel)(const float *in, float *out);
+
+// Per coefficient prescaling for the AAN kernels.
+void idct_scales(std::array<float, 64> &scales);
+
+// Returns the kernel for the requested implementation. IDCT_AUTO picks the
+// widest kernel the running CPU supports; an explicitly requested kernel the
+// CPU cannot run yields NULL. All kernels return bit identical results.
+idct_kernel select_idct_kernel(idct_impl impl);
+
+// Straightforward O(N^4) inverse DCT of unscaled coefficients, for testing.
+void idct_8x8_reference(const float *in, float *out);
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_METEOR_IDCT_H */
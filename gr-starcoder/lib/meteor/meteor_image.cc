@@ -41,10 +41,10 @@
 #include "meteor_bit_io.h"
 #include "gil_util.h"
 
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 
-#include <boost/gil/gil_all.hpp>
 
 namespace gr {
 namespace starcoder {
@@ -54,32 +54,71 @@ imager::imager(int red_apid, int green_apid, int blue_apid)
     : red_apid_(red_apid),
       green_apid_(green_apid),
       blue_apid_(blue_apid),
+      image_(8 * MCU_PER_LINE, 3),
       last_mcu_(-1),
       cur_y_(0),
       last_y_(-1),
       first_pck_(0),
-      prev_pck_(0) {
-  init_huffman_table();
-  init_cos();
+      prev_pck_(0),
+      huffman_(huffman_tables::get()),
+      idct_(select_idct_kernel(IDCT_AUTO)),
+      next_strip_y_(0) {
+  idct_scales(idct_scales_);
 }
 
-void imager::init_cos() {
-  for (int y = 0; y < 8; y++) {
-    for (int x = 0; x < 8; x++) {
-      cosine_[y][x] = cos(M_PI / 16 * (2 * y + 1) * x);
-    }
-  }
-  for (int x = 0; x < 8; x++) {
-    if (x == 0)
-      alpha_[x] = 1 / sqrt(2);
-    else
-      alpha_[x] = 1;
+image_store::image_store(int width, int planes)
+    : width_(width), planes_(planes), lines_(0) {}
+
+int image_store::width() const { return width_; }
+
+int image_store::lines() const { return lines_; }
+
+void image_store::grow(int lines) {
+  while (static_cast<int>(chunks_.size()) * CHUNK_LINES < lines) {
+    chunks_.emplace_back(new uint8_t[planes_ * CHUNK_LINES * width_]());
   }
+  lines_ = std::max(lines_, lines);
+}
 
-  //for (auto x : cosine_) for (auto y: x) std::cout << std::dec << y << ' ';
+uint8_t *image_store::row(int plane, int y) {
+  return chunks_[y / CHUNK_LINES].get() +
+         (plane * CHUNK_LINES + y % CHUNK_LINES) * width_;
 }
 
-void imager::init_huffman_table() {
+const uint8_t *image_store::row(int plane, int y) const {
+  return chunks_[y / CHUNK_LINES].get() +
+         (plane * CHUNK_LINES + y % CHUNK_LINES) * width_;
+}
+
+static int get_dc_real(uint16_t word) {
+  switch (word >> 14) {
+    case 0:
+      return 0;
+    default:
+      switch (word >> 13) {
+        case 2:
+          return 1;
+        case 3:
+          return 2;
+        case 4:
+          return 3;
+        case 5:
+          return 4;
+        case 6:
+          return 5;
+        default:
+          if ((word >> 12) == 0x00e) return 6;
+          if ((word >> 11) == 0x01e) return 7;
+          if ((word >> 10) == 0x03e) return 8;
+          if ((word >> 9) == 0x07e) return 9;
+          if ((word >> 8) == 0x0fe) return 10;
+          if ((word >> 7) == 0x1fe) return 11;
+      }
+  }
+  return -1;
+}
+
+huffman_tables::huffman_tables() {
   std::array<uint8_t, 65536> v {}
   ;
   std::array<uint16_t, 17> min_code {}
@@ -115,110 +154,88 @@ void imager::init_huffman_table() {
         uint16_t size_val = v[(k << 8) + i - min_val];
         int run = size_val >> 4;
         int size = size_val & 0xf;
-        ac_table_[n].run = run;
-        ac_table_[n].size = size;
-        ac_table_[n].len = k;
-        ac_table_[n].mask = (1 << k) - 1;
-        ac_table_[n].code = i;
+        ac_table[n].run = run;
+        ac_table[n].size = size;
+        ac_table[n].len = k;
+        ac_table[n].mask = (1 << k) - 1;
+        ac_table[n].code = i;
         n++;
       }
     }
   }
 
-  for (int i = 0; i < 65536; i++) {
-    ac_lookup_[i] = get_ac_real(i);
+  // Entry i matches every word whose top len bits equal its code, which is a
+  // contiguous range. Filling the ranges backwards leaves each word with the
+  // first matching entry, like a linear search of the table would.
+  ac_lookup.fill(-1);
+  for (int i = n - 1; i >= 0; i--) {
+    int shift = 16 - ac_table[i].len;
+    std::fill(ac_lookup.begin() + (ac_table[i].code << shift),
+              ac_lookup.begin() + ((ac_table[i].code + 1) << shift), i);
   }
   for (int i = 0; i < 65536; i++) {
-    dc_lookup_[i] = get_dc_real(i);
+    dc_lookup[i] = get_dc_real(i);
   }
 }
 
-int imager::get_dc_real(uint16_t word) {
-  switch (word >> 14) {
-    case 0:
-      return 0;
-    default:
-      switch (word >> 13) {
-        case 2:
-          return 1;
-        case 3:
-          return 2;
-        case 4:
-          return 3;
-        case 5:
-          return 4;
-        case 6:
-          return 5;
-        default:
-          if ((word >> 12) == 0x00e) return 6;
-          if ((word >> 11) == 0x01e) return 7;
-          if ((word >> 10) == 0x03e) return 8;
-          if ((word >> 9) == 0x07e) return 9;
-          if ((word >> 8) == 0x0fe) return 10;
-          if ((word >> 7) == 0x1fe) return 11;
-      }
-  }
-  return -1;
-}
-
-int imager::get_ac_real(uint16_t word) {
-  for (int i = 0; i < 162; i++) {
-    if (((word >> (16 - ac_table_[i].len)) & ac_table_[i].mask) ==
-        ac_table_[i].code) {
-      return i;
-    }
-  }
-  return -1;
+const huffman_tables &huffman_tables::get() {
+  // Initialization of a function local static is thread safe.
+  static const huffman_tables tables;
+  return tables;
 }
 
 imager::~imager() {}
 
-std::string imager::dump_image() {
-  if (full_image_.size() == 0) return "";
-
-  const int width = 8 * MCU_PER_LINE;
-  const int height = cur_y_ + 8;
-  boost::gil::rgb8_image_t img(width, height);
-  boost::gil::rgb8_image_t::view_t v = view(img);
+std::string imager::dump_image() const {
+  if (image_.lines() == 0) return "";
 
-  for (int x = 0; x < width; x++) {
-    for (int y = 0; y < height; y++) {
-      int off = x + y * width;
+  const int width = image_.width();
+  std::vector<uint8_t> rgb(3 * width);
+  return store_rows_to_png_string(width, cur_y_ + 8, 3, [&](int y) {
+    const uint8_t *g = image_.row(1, y);
+    const uint8_t *b = image_.row(2, y);
+    for (int x = 0; x < width; x++) {
       // To generate the full color image, we don't use APID-68 (red channel).
-      v(x, y) = boost::gil::rgb8_pixel_t(full_image_[off].g, full_image_[off].g,
-                                         full_image_[off].b);
+      rgb[3 * x] = g[x];
+      rgb[3 * x + 1] = g[x];
+      rgb[3 * x + 2] = b[x];
     }
-  }
+    return rgb.data();
+  });
+}
+
+std::string imager::dump_gray_image(int apid) const {
+  if (image_.lines() == 0) return "";
 
-  return store_rgb_to_png_string(v);
+  const int p = plane(apid);
+  if (p < 0) return "";
+  return store_rows_to_png_string(image_.width(), cur_y_ + 8, 1,
+                                  [&](int y) { return image_.row(p, y); });
 }
 
-std::string imager::dump_gray_image(int apid) {
-  if (full_image_.size() == 0) return "";
-
-  const int width = 8 * MCU_PER_LINE;
-  const int height = cur_y_ + 8;
-  boost::gil::gray8_image_t img(width, height);
-  boost::gil::gray8_image_t::view_t v = view(img);
-
-  for (int x = 0; x < width; x++) {
-    for (int y = 0; y < height; y++) {
-      int off = x + y * MCU_PER_LINE * 8;
-      switch (apid) {
-        case RED_APID:
-          v(x, y) = boost::gil::gray8_pixel_t(full_image_[off].r);
-          break;
-        case GREEN_APID:
-          v(x, y) = boost::gil::gray8_pixel_t(full_image_[off].g);
-          break;
-        case BLUE_APID:
-          v(x, y) = boost::gil::gray8_pixel_t(full_image_[off].b);
-          break;
-      }
+void imager::set_strip_callback(strip_callback callback) {
+  strip_callback_ = callback;
+}
+
+void imager::flush_strips() {
+  if (image_.lines() == 0) return;
+  emit_strips(cur_y_ + 8);
+}
+
+void imager::emit_strips(int end_y) {
+  if (!strip_callback_) return;
+
+  const int width = image_.width();
+  const int apids[] = { red_apid_, green_apid_, blue_apid_ };
+  std::vector<uint8_t> pixels(width * 8);
+
+  for (; next_strip_y_ < end_y; next_strip_y_ += 8) {
+    for (int p = 0; p < 3; p++) {
+      const uint8_t *strip = image_.row(p, next_strip_y_);
+      std::copy(strip, strip + width * 8, pixels.begin());
+      strip_callback_(apids[p], next_strip_y_, pixels);
     }
   }
-
-  return store_gray_to_png_string(v);
 }
 
 bool imager::progress_image(int apd, int mcu_id, int pck_cnt) {
@@ -239,13 +256,16 @@ bool imager::progress_image(int apd, int mcu_id, int pck_cnt) {
   prev_pck_ = pck_cnt;
 
   cur_y_ = 8 * ((pck_cnt - first_pck_) / (14 + 14 + 14 + 1));
-  if (cur_y_ > last_y_) full_image_.resize(MCU_PER_LINE * 8 * (cur_y_ + 8));
+  if (cur_y_ > last_y_) image_.grow(cur_y_ + 8);
   last_y_ = cur_y_;
 
+  // Packets arrive in line order, so the rows above are complete.
+  emit_strips(cur_y_);
+
   return true;
 }
 
-void imager::fill_dqt_by_q(std::array<int, 64> &dqt, int q) {
+void fill_dqt_by_q(std::array<int, 64> &dqt, int q) {
   float f;
   if (q > 20 && q < 50)
     f = 5000. / q;
@@ -267,46 +287,29 @@ int imager::map_range(int cat, int vl) {
     return vl - maxval;
 }
 
-void imager::flt_idct_8x8(std::array<float, 64> &res,
-                          std::array<float, 64> &inp) {
-  for (int y = 0; y < 8; y++) {
-    for (int x = 0; x < 8; x++) {
-      float s = 0;
-      for (int u = 0; u < 8; u++) {
-        float cxu = alpha_[u] * cosine_[x][u];
-        s += cxu * (inp[0 * 8 + u] * alpha_[0] * cosine_[y][0] +
-                    inp[1 * 8 + u] * alpha_[1] * cosine_[y][1] +
-                    inp[2 * 8 + u] * alpha_[2] * cosine_[y][2] +
-                    inp[3 * 8 + u] * alpha_[3] * cosine_[y][3] +
-                    inp[4 * 8 + u] * alpha_[4] * cosine_[y][4] +
-                    inp[5 * 8 + u] * alpha_[5] * cosine_[y][5] +
-                    inp[6 * 8 + u] * alpha_[6] * cosine_[y][6] +
-                    inp[7 * 8 + u] * alpha_[7] * cosine_[y][7]);
-      }
-      res[y * 8 + x] = s / 4;
-    }
-  }
+int imager::plane(int apid) const {
+  if (apid == red_apid_) return 0;
+  if (apid == green_apid_) return 1;
+  if (apid == blue_apid_) return 2;
+  return -1;
 }
 
 void imager::fill_pix(std::array<float, 64> &img_dct, int apd, int mcu_id,
                       int m) {
+  const int p = plane(apd);
+  if (p < 0 || mcu_id + m >= MCU_PER_LINE) return;
+
   for (int i = 0; i < 64; i++) {
     int t = round(img_dct[i] + 128);
     if (t < 0) t = 0;
     if (t > 255) t = 255;
-    int x = (mcu_id + m) * 8 + i % 8;
-    int y = cur_y_ + i / 8;
-    int off = x + y * MCU_PER_LINE * 8;
-
-    if (apd == RED_APID) full_image_[off].r = t;
-    if (apd == GREEN_APID) full_image_[off].g = t;
-    if (apd == BLUE_APID) full_image_[off].b = t;
+    image_.row(p, cur_y_ + i / 8)[(mcu_id + m) * 8 + i % 8] = t;
   }
 }
 
 void imager::dec_mcus(const uint8_t *packet, int len, int apd, int pck_cnt,
                       int mcu_id, uint8_t q) {
-  bit_io_const b(packet, 0);
+  bit_io_const b(packet, len);
 
   if (!progress_image(apd, mcu_id, pck_cnt)) return;
 
@@ -315,13 +318,15 @@ void imager::dec_mcus(const uint8_t *packet, int len, int apd, int pck_cnt,
   std::array<float, 64> zdct {}
   , dct {}
   , img_dct {}
+  , dequant {}
   ;
   fill_dqt_by_q(dqt, q);
+  for (int i = 0; i < 64; i++) dequant[i] = dqt[i] * idct_scales_[i];
 
   float prev_dc = 0;
   int m = 0;
   while (m < MCU_PER_PACKET) {
-    int dc_cat = dc_lookup_[b.peek_n_bits(16)];
+    int dc_cat = huffman_.dc_lookup[b.peek_n_bits(16)];
     if (dc_cat == -1) {
       std::cerr << "Bad DC Huffman code!" << std::endl;
       return;
@@ -333,15 +338,16 @@ void imager::dec_mcus(const uint8_t *packet, int len, int apd, int pck_cnt,
     prev_dc = zdct[0];
 
     int k = 1;
+    bool ac_zero = true;
     while (k < 64) {
-      int ac = ac_lookup_[b.peek_n_bits(16)];
+      int ac = huffman_.ac_lookup[b.peek_n_bits(16)];
       if (ac == -1) {
         std::cerr << "Bad AC Huffman code!" << std::endl;
         return;
       }
-      int ac_len = ac_table_[ac].len;
-      int ac_size = ac_table_[ac].size;
-      int ac_run = ac_table_[ac].run;
+      int ac_len = huffman_.ac_table[ac].len;
+      int ac_size = huffman_.ac_table[ac].size;
+      int ac_run = huffman_.ac_table[ac].run;
       b.advance_n_bits(ac_len);
 
       if (ac_run == 0 && ac_size == 0) {
@@ -359,6 +365,7 @@ void imager::dec_mcus(const uint8_t *packet, int len, int apd, int pck_cnt,
       if (ac_size != 0) {
         uint16_t n = b.fetch_n_bits(ac_size);
         zdct[k] = map_range(ac_size, n);
+        ac_zero = false;
         k++;
       } else if (ac_run == 15) {
         zdct[k] = 0;
@@ -366,11 +373,19 @@ void imager::dec_mcus(const uint8_t *packet, int len, int apd, int pck_cnt,
       }
     }
 
-    for (int i = 0; i < 64; i++) {
-      dct[i] = zdct[ZIGZAG[i]] * dqt[i];
+    if (ac_zero) {
+      // A flat block, the inverse DCT is just the scaled DC coefficient.
+      img_dct.fill(zdct[0] * dequant[0]);
+    } else {
+      for (int i = 0; i < 64; i++) {
+        dct[i] = zdct[ZIGZAG[i]] * dequant[i];
+      }
+      idct_(dct.data(), img_dct.data());
+    }
+    if (b.overrun()) {
+      std::cerr << "MCU data past the end of the packet!" << std::endl;
+      return;
     }
-
-    flt_idct_8x8(img_dct, dct);
     fill_pix(img_dct, apd, mcu_id, m);
 
     m++;
@@ -41,8 +41,13 @@
 #define INCLUDED_METEOR_IMAGE_H
 
 #include <array>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "meteor_idct.h"
+
 namespace gr {
 namespace starcoder {
 namespace meteor {
@@ -89,10 +94,31 @@ const int RED_APID = 68;
 const int GREEN_APID = 65;
 const int BLUE_APID = 64;
 
-struct pixel {
-  uint8_t r;
-  uint8_t g;
-  uint8_t b;
+// Fills dqt with the quantization table for JPEG quality factor q, scaled from
+// STANDARD_QUANTIZATION_TABLE like the satellite does.
+void fill_dqt_by_q(std::array<int, 64> &dqt, int q);
+
+// Planar 8 bit image storage, allocated in chunks of CHUNK_LINES lines that
+// hold all the planes. Growing only adds chunks, so lines already stored never
+// move. Chunk boundaries are multiples of 8 lines, so the lines of a row of
+// MCUs are contiguous within each plane.
+class image_store {
+ public:
+  static const int CHUNK_LINES = 64;
+
+  image_store(int width, int planes);
+
+  int width() const;
+  int lines() const;
+  // Makes lines [0, lines) available, new lines are black. Never shrinks.
+  void grow(int lines);
+
+  uint8_t *row(int plane, int y);
+  const uint8_t *row(int plane, int y) const;
+
+ private:
+  int width_, planes_, lines_;
+  std::vector<std::unique_ptr<uint8_t[]> > chunks_;
 };
 
 struct ac_table_rec {
@@ -103,29 +129,44 @@ struct ac_table_rec {
   uint32_t code;
 };
 
+// Huffman decoding tables. They only depend on T_AC_0, so a single read-only
+// instance, built on first use, is shared by all imagers.
+struct huffman_tables {
+  std::array<ac_table_rec, 162> ac_table;
+  // Indexed by the next 16 bits of the stream: the matching ac_table entry
+  // and the DC category respectively, or -1 for an invalid code.
+  std::array<int16_t, 65536> ac_lookup;
+  std::array<int16_t, 65536> dc_lookup;
+
+  static const huffman_tables &get();
+
+ private:
+  huffman_tables();
+};
+
+// Receives the APID, the first line and the 8 lines of gray pixels of one
+// channel for each completed row of MCUs.
+typedef std::function<void(int apid, int line,
+                           const std::vector<uint8_t> &pixels)> strip_callback;
+
 class imager {
  private:
   int red_apid_, green_apid_, blue_apid_;
-  std::vector<pixel> full_image_;
+  // Planes in red, green, blue order.
+  image_store image_;
   int last_mcu_, cur_y_, last_y_, first_pck_, prev_pck_;
-  std::array<int, 65536> ac_lookup_ {}
-  , dc_lookup_ {}
-  ;
-  std::array<ac_table_rec, 162> ac_table_ {}
-  ;
-  std::array<std::array<float, 8>, 8> cosine_ {}
+  const huffman_tables &huffman_;
+  std::array<float, 64> idct_scales_ {}
   ;
-  std::array<float, 8> alpha_;
+  idct_kernel idct_;
+  strip_callback strip_callback_;
+  int next_strip_y_;
 
-  void init_huffman_table();
-  void init_cos();
-  int get_dc_real(uint16_t word);
-  int get_ac_real(uint16_t word);
   bool progress_image(int apd, int mcu_id, int pck_cnt);
-  void fill_dqt_by_q(std::array<int, 64> &dqt, int q);
   int map_range(int cat, int vl);
-  void flt_idct_8x8(std::array<float, 64> &res, std::array<float, 64> &inp);
   void fill_pix(std::array<float, 64> &img_dct, int apd, int mcu_id, int m);
+  int plane(int apid) const;
+  void emit_strips(int end_y);
 
  public:
   imager(int red_apid, int green_apid, int blue_apid);
@@ -134,9 +175,13 @@ class imager {
   void dec_mcus(const uint8_t *packet, int len, int apd, int pck_cnt,
                 int mcu_id, uint8_t q);
 
-  std::string dump_image();
-  std::string dump_gray_image(int apid);
+  std::string dump_image() const;
+  std::string dump_gray_image(int apid) const;
 
+  // Reports each row of MCUs once the image has moved past it.
+  void set_strip_callback(strip_callback callback);
+  // Reports the rows not reported yet, including the last one.
+  void flush_strips();
 };
 
 }  // namespace meteor
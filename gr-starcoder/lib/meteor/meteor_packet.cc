@@ -114,18 +114,24 @@ int packeter::parse_partial(const uint8_t *packet, int len) {
     return 0;
   }
 
-  parse_apd(packet, len_pck + 1);
+  parse_apd(packet, len_pck + 6 + 1);
 
   partial_packet_ = false;
   return len_pck + 6 + 1;
 }
 
-std::string packeter::dump_image() { return imager_.dump_image(); }
+std::string packeter::dump_image() const { return imager_.dump_image(); }
 
-std::string packeter::dump_gray_image(int apid) {
+std::string packeter::dump_gray_image(int apid) const {
   return imager_.dump_gray_image(apid);
 }
 
+void packeter::set_strip_callback(strip_callback callback) {
+  imager_.set_strip_callback(callback);
+}
+
+void packeter::flush_strips() { imager_.flush_strips(); }
+
 void packeter::parse_cvcdu(const uint8_t *frame, int len) {
   int n;
 
@@ -69,8 +69,11 @@ class packeter {
   ~packeter();
 
   void parse_cvcdu(const uint8_t *frame, int len);
-  std::string dump_image();
-  std::string dump_gray_image(int apid);
+  std::string dump_image() const;
+  std::string dump_gray_image(int apid) const;
+
+  void set_strip_callback(strip_callback callback);
+  void flush_strips();
 };
 
 }  // namespace meteor
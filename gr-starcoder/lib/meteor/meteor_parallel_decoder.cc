@@ -0,0 +1,155 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "meteor_parallel_decoder.h"
+
+#include <algorithm>
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+parallel_decoder::parallel_decoder(int threads, bool speculate)
+    : stopping_(false) {
+  if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  // Enough frames ahead to keep every worker busy while the calling thread
+  // waits for the oldest one.
+  depth_ = speculate ? 2 * threads : 1;
+  for (int i = 0; i < threads; i++) {
+    workers_.push_back(std::thread(&parallel_decoder::worker_loop, this));
+  }
+}
+
+parallel_decoder::~parallel_decoder() { shutdown(); }
+
+void parallel_decoder::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    reset_speculation();
+  }
+  work_cond_.notify_all();
+  // Frames already being decoded are finished before the workers exit.
+  for (auto &worker : workers_) worker.join();
+  workers_.clear();
+}
+
+void parallel_decoder::worker_loop() {
+  // Each worker needs its own Viterbi decoder and correlator tables.
+  decoder worker_decoder;
+
+  while (true) {
+    std::shared_ptr<job> next;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cond_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) return;
+      next = queue_.front();
+      queue_.pop_front();
+      worker_decoder.set_erasure_decoding(erasure_decoding());
+    }
+
+    worker_decoder.decode_frame(next->raw, next->pos, next->word,
+                                next->result);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      next->done = true;
+    }
+    done_cond_.notify_all();
+  }
+}
+
+void parallel_decoder::reset_speculation() {
+  queue_.clear();
+  speculated_.clear();
+}
+
+void parallel_decoder::load_frame(const unsigned char *raw, int raw_len,
+                                  int pos, uint32_t word,
+                                  frame_result &result) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto it = speculated_.find(pos);
+  if (it == speculated_.end() || it->second->raw != raw ||
+      it->second->word != word) {
+    // Synchronization moved, so the queued frames are of no use anymore.
+    reset_speculation();
+  } else {
+    // Positions only ever move forward.
+    speculated_.erase(speculated_.begin(), it);
+  }
+
+  for (int k = 0; k < depth_; k++) {
+    int p = pos + k * SOFT_FRAME_LEN;
+    if (k > 0 && p + SOFT_FRAME_LEN > raw_len) break;
+    if (speculated_.count(p) != 0) continue;
+
+    std::shared_ptr<job> next(new job());
+    next->raw = raw;
+    next->pos = p;
+    next->word = word;
+    next->done = false;
+    speculated_[p] = next;
+    queue_.push_back(next);
+  }
+  work_cond_.notify_all();
+
+  std::shared_ptr<job> current = speculated_[pos];
+  done_cond_.wait(lock, [&current] { return current->done; });
+  result = current->result;
+  speculated_.erase(pos);
+}
+
+// The decoder only passes candidates that fit in raw, and none are
+// speculated beyond them, so the length is not needed here.
+void parallel_decoder::load_frames(
+    const unsigned char *raw, int,
+    const std::vector<frame_candidate> &candidates,
+    std::vector<frame_result> &results) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // A sync search means the chain of frames was broken.
+  reset_speculation();
+
+  std::vector<std::shared_ptr<job> > jobs;
+  for (const auto &candidate : candidates) {
+    std::shared_ptr<job> next(new job());
+    next->raw = raw;
+    next->pos = candidate.pos;
+    next->word = candidate.word;
+    next->done = false;
+    jobs.push_back(next);
+    queue_.push_back(next);
+  }
+  work_cond_.notify_all();
+
+  // All of them are waited for, even once a better ranked one is ok, so that
+  // no worker is still reading raw when this returns.
+  for (size_t i = 0; i < jobs.size(); i++) {
+    std::shared_ptr<job> current = jobs[i];
+    done_cond_.wait(lock, [&current] { return current->done; });
+    results[i] = current->result;
+  }
+}
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
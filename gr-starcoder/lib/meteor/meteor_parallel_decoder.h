@@ -0,0 +1,100 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_METEOR_PARALLEL_DECODER_H
+#define INCLUDED_METEOR_PARALLEL_DECODER_H
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "meteor_decoder.h"
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+// A decoder that spreads the Viterbi and Reed-Solomon work over a pool of
+// worker threads.
+//
+// Whenever the decoder needs a frame, the frames that follow it on the same
+// sync word are queued for the workers as well, since a synchronized stream
+// usually continues frame after frame. The synchronization state machine
+// still runs on the calling thread and consumes the frames in stream order,
+// so the decoded frames are exactly those of the serial decoder. Speculative
+// frames that turn out not to be needed are dropped.
+//
+// The candidates of a sync search (see set_sync_candidates()) are decoded
+// concurrently, so trying several of them takes about as long as one.
+//
+// The raw buffer passed to decode_one_frame() must stay valid until the
+// decoder is destroyed, as workers may still be reading it, unless
+// speculation is disabled.
+class parallel_decoder : public decoder {
+ private:
+  struct job {
+    const unsigned char *raw;
+    int pos;
+    uint32_t word;
+    bool done;
+    frame_result result;
+  };
+
+  void worker_loop();
+  void reset_speculation();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_cond_, done_cond_;
+  bool stopping_;
+  int depth_;
+
+  // Jobs not yet picked up by a worker, and all jobs of the current chain of
+  // frames by position.
+  std::deque<std::shared_ptr<job> > queue_;
+  std::map<int, std::shared_ptr<job> > speculated_;
+
+ protected:
+  void load_frame(const unsigned char *raw, int raw_len, int pos,
+                  uint32_t word, frame_result &result);
+  void load_frames(const unsigned char *raw, int raw_len,
+                   const std::vector<frame_candidate> &candidates,
+                   std::vector<frame_result> &results);
+
+ public:
+  // threads <= 0 uses one thread per core. Without speculation only the
+  // frames the decoder asks for are decoded, and every call returns once
+  // the workers are done with raw, so the caller may reuse the buffer.
+  parallel_decoder(int threads, bool speculate = true);
+  ~parallel_decoder();
+
+  // Drops the queued jobs and joins the workers. Called by the destructor.
+  void shutdown();
+};
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_METEOR_PARALLEL_DECODER_H */
@@ -41,7 +41,6 @@
 #include "meteor_viterbi.h"
 
 #include <iostream>
-#include <stdlib.h>
 
 namespace gr {
 namespace starcoder {
@@ -52,15 +51,30 @@ static const unsigned char VITERBI27_POLYB = 109;
 
 static const unsigned int SOFT_MAX = 255;
 static const unsigned int DISTANCE_MAX = 65535;
-static const unsigned int NUM_FRAME_BITS = 1024 * 8;
 static const unsigned int HIGH_BIT = 64;
 static const unsigned int ENCODE_LEN = 2 * (NUM_FRAME_BITS + 8);
 static const unsigned int NUM_ITER = HIGH_BIT << 1;
 
 static const unsigned int RENORMALIZE_INTERVAL = DISTANCE_MAX / (2 * SOFT_MAX);
 
-viterbi::viterbi()
+// Branch metrics of the four encoder outputs for one pair of soft symbols:
+// |y0 - x0| + |y1 - x1|, where x is +255 for a 0 bit and -255 for a 1 bit.
+// The soft symbols are signed bytes, so |y| <= 128 < 255 and the absolute
+// values reduce to plain sums.
+static inline void branch_distances(const unsigned char *soft,
+                                    uint16_t *distances) {
+  const int mag = SOFT_MAX;
+  int y0 = static_cast<signed char>(soft[0]);
+  int y1 = static_cast<signed char>(soft[1]);
+  distances[0] = 2 * mag - y0 - y1;
+  distances[1] = 2 * mag + y0 - y1;
+  distances[2] = 2 * mag - y0 + y1;
+  distances[3] = 2 * mag + y0 + y1;
+}
+
+viterbi::viterbi(acs_impl impl)
     : ber_(0),
+      reliability_(new int16_t[NUM_FRAME_BYTES]()),
       err_index_(0),
       hist_index_(0),
       len_(0),
@@ -70,16 +84,13 @@ viterbi::viterbi()
       err_0_(new uint16_t[NUM_STATES]()),
       err_1_(new uint16_t[NUM_STATES]()),
       read_errors_(NULL),
-      write_errors_(NULL) {
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 65536; j++) {
-      dist_table_[i][j] = metric_soft_distance(i, j & 0xff, j >> 8);
-    }
-  }
-
+      write_errors_(NULL),
+      acs_(select_acs_kernel(impl)) {
   for (int i = 0; i < 128; i++) {
     if ((count_bits(i & VITERBI27_POLYA) % 2) != 0) table_[i] = table_[i] | 1;
     if ((count_bits(i & VITERBI27_POLYB) % 2) != 0) table_[i] = table_[i] | 2;
+    bit0_mask_[i] = (table_[i] & 1) ? 0xffff : 0;
+    bit1_mask_[i] = (table_[i] & 2) ? 0xffff : 0;
   }
 
   errors_[0] = err_0_.get();
@@ -91,40 +102,6 @@ viterbi::viterbi()
 
 viterbi::~viterbi() {}
 
-uint16_t viterbi::metric_soft_distance(unsigned char hard,
-                                       unsigned char soft_y0,
-                                       unsigned char soft_y1) {
-  const int mag = 255;
-  int soft_x0, soft_x1;
-  switch (hard & 3) {
-    case 0:
-      soft_x0 = mag;
-      soft_x1 = mag;
-      break;
-    case 1:
-      soft_x0 = -mag;
-      soft_x1 = mag;
-      break;
-    case 2:
-      soft_x0 = mag;
-      soft_x1 = -mag;
-      break;
-    case 3:
-      soft_x0 = -mag;
-      soft_x1 = -mag;
-      break;
-    default:
-      // Warn?
-      soft_x0 = 0;
-      soft_x1 = 0;
-  }
-
-  signed char y0 = reinterpret_cast<signed char &>(soft_y0);
-  signed char y1 = reinterpret_cast<signed char &>(soft_y1);
-
-  return abs(y0 - soft_x0) + abs(y1 - soft_x1);
-}
-
 void viterbi::pair_lookup_create() {
   std::array<uint32_t, 16> inv_outputs {}
   ;
@@ -151,8 +128,41 @@ int viterbi::count_bits(uint32_t i) {
 
 void viterbi::vit_decode(const unsigned char *in, unsigned char *out) {
   vit_conv_decode(in, out);
+  ber_ = reencode_errors(in, out);
+}
+
+int viterbi::ber() { return ber_; }
 
-  // TODO: Calculate BER
+const int16_t *viterbi::reliability() const { return reliability_.get(); }
+
+int viterbi::reencode_errors(const unsigned char *soft,
+                             const unsigned char *decoded) {
+  // The decoder starts from state 0 and the newest bit enters at the bottom of
+  // the state, so table_ of the shifted state is the encoder output. A
+  // negative soft symbol is a 1 bit.
+  int errors = 0;
+  uint32_t state = 0;
+  std::array<int, NUM_FRAME_BYTES> agreement {}
+  ;
+  for (int i = 0; i < NUM_FRAME_BITS; i++) {
+    uint32_t bit = (decoded[i / 8] >> (7 - i % 8)) & 1;
+    state = ((state << 1) | bit) & (NUM_STATES - 1);
+    uint32_t hard = (soft[2 * i] >> 7) | ((soft[2 * i + 1] >> 7) << 1);
+    errors += count_bits(table_[state] ^ hard);
+
+    int y0 = static_cast<signed char>(soft[2 * i]);
+    int y1 = static_cast<signed char>(soft[2 * i + 1]);
+    agreement[i / 8] += ((table_[state] & 1) ? -y0 : y0) +
+                        ((table_[state] & 2) ? -y1 : y1);
+  }
+
+  // Byte k went into the symbols of bits 8k to 8k + 14.
+  for (int k = 0; k < NUM_FRAME_BYTES; k++) {
+    int sum = agreement[k];
+    if (k + 1 < NUM_FRAME_BYTES) sum += agreement[k + 1];
+    reliability_[k] = sum;
+  }
+  return errors;
 }
 
 void viterbi::vit_conv_decode(const unsigned char *soft_encoded,
@@ -175,83 +185,92 @@ void viterbi::vit_conv_decode(const unsigned char *soft_encoded,
   history_buffer_traceback(0, 0);
 }
 
+void viterbi::acs_scalar() {
+  pair_lookup_fill_distance();
+
+  uint64_t decisions = 0;
+
+  uint32_t highbase = HIGH_BIT >> 1;
+  uint32_t low = 0;
+  uint32_t high = HIGH_BIT;
+  uint32_t base = 0;
+  while (high < NUM_ITER) {
+    uint32_t offset = 0;
+    uint32_t base_offset = 0;
+    while (base_offset < 4) {
+      uint32_t low_key = pair_keys_[base + base_offset];
+      uint32_t high_key = pair_keys_[highbase + base + base_offset];
+
+      uint32_t low_concat_dist = pair_distances_[low_key];
+      uint32_t high_concat_dist = pair_distances_[high_key];
+
+      uint16_t low_past_error = read_errors_[base + base_offset];
+      uint16_t high_past_error = read_errors_[highbase + base + base_offset];
+
+      uint16_t low_error = (low_concat_dist & 0xffff) + low_past_error;
+      uint16_t high_error = (high_concat_dist & 0xffff) + high_past_error;
+
+      uint32_t successor = low + offset;
+
+      uint16_t error;
+      uint8_t history_mask;
+      if (low_error <= high_error) {
+        error = low_error;
+        history_mask = 0;
+      } else {
+        error = high_error;
+        history_mask = 1;
+      }
+      write_errors_[successor] = error;
+      decisions |= static_cast<uint64_t>(history_mask) << successor;
+
+      uint32_t low_plus_one = low + offset + 1;
+
+      uint16_t low_plus_one_error = (low_concat_dist >> 16) + low_past_error;
+      uint16_t high_plus_one_error =
+          (high_concat_dist >> 16) + high_past_error;
+
+      uint32_t plus_one_successor = low_plus_one;
+      uint16_t plus_one_error;
+      uint8_t plus_one_history_mask;
+      if (low_plus_one_error <= high_plus_one_error) {
+        plus_one_error = low_plus_one_error;
+        plus_one_history_mask = 0;
+      } else {
+        plus_one_error = high_plus_one_error;
+        plus_one_history_mask = 1;
+      }
+      write_errors_[plus_one_successor] = plus_one_error;
+      decisions |= static_cast<uint64_t>(plus_one_history_mask)
+                   << plus_one_successor;
+
+      offset += 2;
+      base_offset += 1;
+    }
+
+    low += 8;
+    high += 8;
+    base += 4;
+  }
+  history_[hist_index_] = decisions;
+}
+
 void viterbi::vit_inner(const unsigned char *soft) {
   for (int i = 0; i < 6; i++) {
+    branch_distances(soft + i * 2, distances_.data());
     for (int j = 0; j < (1 << (i + 1)); j++) {
-      write_errors_[j] = dist_table_[table_[j]][
-          *reinterpret_cast<const uint16_t *>(soft + i * 2)] +
-                         read_errors_[j >> 1];
+      write_errors_[j] = distances_[table_[j]] + read_errors_[j >> 1];
     }
     error_buffer_swap();
   }
 
   for (int i = 6; i < NUM_FRAME_BITS - 6; i++) {
-    for (int j = 0; j < 4; j++) {
-      distances_[j] =
-          dist_table_[j][*reinterpret_cast<const uint16_t *>(soft + i * 2)];
-    }
-    pair_lookup_fill_distance();
-
-    uint32_t highbase = HIGH_BIT >> 1;
-    uint32_t low = 0;
-    uint32_t high = HIGH_BIT;
-    uint32_t base = 0;
-    while (high < NUM_ITER) {
-      uint32_t offset = 0;
-      uint32_t base_offset = 0;
-      while (base_offset < 4) {
-        uint32_t low_key = pair_keys_[base + base_offset];
-        uint32_t high_key = pair_keys_[highbase + base + base_offset];
-
-        uint32_t low_concat_dist = pair_distances_[low_key];
-        uint32_t high_concat_dist = pair_distances_[high_key];
-
-        uint16_t low_past_error = read_errors_[base + base_offset];
-        uint16_t high_past_error = read_errors_[highbase + base + base_offset];
-
-        uint16_t low_error = (low_concat_dist & 0xffff) + low_past_error;
-        uint16_t high_error = (high_concat_dist & 0xffff) + high_past_error;
-
-        uint32_t successor = low + offset;
-
-        uint16_t error;
-        uint8_t history_mask;
-        if (low_error <= high_error) {
-          error = low_error;
-          history_mask = 0;
-        } else {
-          error = high_error;
-          history_mask = 1;
-        }
-        write_errors_[successor] = error;
-        history_[hist_index_][successor] = history_mask;
-
-        uint32_t low_plus_one = low + offset + 1;
-
-        uint16_t low_plus_one_error = (low_concat_dist >> 16) + low_past_error;
-        uint16_t high_plus_one_error =
-            (high_concat_dist >> 16) + high_past_error;
-
-        uint32_t plus_one_successor = low_plus_one;
-        uint16_t plus_one_error;
-        uint8_t plus_one_history_mask;
-        if (low_plus_one_error <= high_plus_one_error) {
-          plus_one_error = low_plus_one_error;
-          plus_one_history_mask = 0;
-        } else {
-          plus_one_error = high_plus_one_error;
-          plus_one_history_mask = 1;
-        }
-        write_errors_[plus_one_successor] = plus_one_error;
-        history_[hist_index_][plus_one_successor] = plus_one_history_mask;
-
-        offset += 2;
-        base_offset += 1;
-      }
-
-      low += 8;
-      high += 8;
-      base += 4;
+    branch_distances(soft + i * 2, distances_.data());
+    if (acs_ != NULL) {
+      acs_(read_errors_, write_errors_, &history_[hist_index_],
+           distances_.data(), bit0_mask_.data(), bit1_mask_.data());
+    } else {
+      acs_scalar();
     }
 
     history_buffer_process_skip(1);
@@ -266,12 +285,11 @@ void viterbi::vit_tail(const unsigned char *soft) {
   uint32_t successor;
   uint16_t error;
   uint8_t history_mask;
+  uint64_t decisions;
 
   for (int i = NUM_FRAME_BITS - 6; i < NUM_FRAME_BITS; i++) {
-    for (int j = 0; j < 4; j++) {
-      distances_[j] =
-          dist_table_[j][*reinterpret_cast<const uint16_t *>(soft + i * 2)];
-    }
+    branch_distances(soft + i * 2, distances_.data());
+    decisions = 0;
 
     skip = 1 << (7 - (NUM_FRAME_BITS - i));
     base_skip = skip >> 1;
@@ -302,12 +320,13 @@ void viterbi::vit_tail(const unsigned char *soft) {
         history_mask = 1;
       }
       write_errors_[successor] = error;
-      history_[hist_index_][successor] = history_mask;
+      decisions |= static_cast<uint64_t>(history_mask) << successor;
 
       low += skip;
       high += skip;
       base += base_skip;
     }
+    history_[hist_index_] = decisions;
 
     history_buffer_process_skip(skip);
     error_buffer_swap();
@@ -360,7 +379,7 @@ void viterbi::history_buffer_renormalize(uint32_t min_register) {
 void viterbi::history_buffer_traceback(uint32_t bestpath,
                                        uint32_t min_traceback_length) {
   uint32_t pathbit;
-  uint8_t history;
+  uint64_t history;
 
   uint32_t index = hist_index_, fetched_index = 0, len = len_;
 
@@ -369,7 +388,7 @@ void viterbi::history_buffer_traceback(uint32_t bestpath,
       index = MIN_TRACEBACK + TRACEBACK_LENGTH - 1;
     else
       index--;
-    history = history_[index][bestpath];
+    history = (history_[index] >> bestpath) & 1;
     if (history != 0)
       pathbit = HIGH_BIT;
     else
@@ -388,7 +407,7 @@ void viterbi::history_buffer_traceback(uint32_t bestpath,
       prefetch_index = MIN_TRACEBACK + TRACEBACK_LENGTH - 1;
     else
       prefetch_index--;
-    history = history_[index][bestpath];
+    history = (history_[index] >> bestpath) & 1;
     if (history != 0)
       pathbit = HIGH_BIT;
     else
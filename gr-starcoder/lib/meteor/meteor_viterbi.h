@@ -45,6 +45,7 @@
 #include <memory>
 
 #include "meteor_bit_io.h"
+#include "meteor_viterbi_acs.h"
 
 namespace gr {
 namespace starcoder {
@@ -53,15 +54,18 @@ namespace meteor {
 const unsigned int NUM_STATES = 128;
 const unsigned int MIN_TRACEBACK = 5 * 7;
 const unsigned int TRACEBACK_LENGTH = 15 * 7;
+const int NUM_FRAME_BYTES = 1024;
+const int NUM_FRAME_BITS = NUM_FRAME_BYTES * 8;
 
 class viterbi {
  private:
   int ber_;
+  // Kept out of the object, like the error buffers, so that the decoder
+  // state stays small.
+  std::unique_ptr<int16_t[]> reliability_;
 
   bit_io writer_;
 
-  std::array<std::array<uint16_t, 65536>, 4> dist_table_ {}
-  ;
   std::array<unsigned char, NUM_STATES> table_ {}
   ;
   std::array<uint16_t, 4> distances_ {}
@@ -75,8 +79,9 @@ class viterbi {
   ;
   uint32_t pair_outputs_len_;
 
-  std::array<std::array<unsigned char, NUM_STATES>,
-             MIN_TRACEBACK + TRACEBACK_LENGTH> history_ {}
+  // Survivor decisions of the last trellis steps, used as a ring buffer. Bit s
+  // of an entry is set when state s was reached through the high branch.
+  std::array<uint64_t, MIN_TRACEBACK + TRACEBACK_LENGTH> history_ {}
   ;
   std::array<unsigned char, MIN_TRACEBACK + TRACEBACK_LENGTH> fetched_ {}
   ;
@@ -90,9 +95,14 @@ class viterbi {
   uint16_t *read_errors_;
   uint16_t *write_errors_;
 
-  uint16_t metric_soft_distance(unsigned char hard, unsigned char soft_y0,
-                                unsigned char soft_y1);
+  acs_kernel acs_;
+  std::array<uint16_t, NUM_STATES> bit0_mask_ {}
+  ;
+  std::array<uint16_t, NUM_STATES> bit1_mask_ {}
+  ;
+
   void pair_lookup_create();
+  void acs_scalar();
   void vit_inner(const unsigned char *soft);
   void vit_tail(const unsigned char *soft);
   void error_buffer_swap();
@@ -101,13 +111,23 @@ class viterbi {
   uint32_t history_buffer_search(int search_every);
   void history_buffer_renormalize(uint32_t min_register);
   void history_buffer_traceback(uint32_t bestpath, uint32_t min_traceback);
+  int reencode_errors(const unsigned char *soft, const unsigned char *decoded);
 
  public:
-  viterbi();
+  explicit viterbi(acs_impl impl = ACS_AUTO);
   ~viterbi();
 
   int count_bits(uint32_t i);
   void vit_decode(const unsigned char *in, unsigned char *out);
+  // Channel bit errors of the last vit_decode: how many of its hard decided
+  // input bits differ from the re-encoded output. Only meaningful for frames
+  // that decoded successfully.
+  int ber();
+  // Soft output of the last vit_decode, one value per output byte: how well
+  // the soft symbols the byte was encoded into agree with the re-encoded
+  // output. Bytes decoded from noisy stretches, the likely errors, score
+  // lowest.
+  const int16_t *reliability() const;
   void vit_conv_decode(const unsigned char *soft_encoded,
                        unsigned char *decoded);
 };
@@ -0,0 +1,209 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "meteor_viterbi_acs.h"
+
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define METEOR_ACS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+#ifdef METEOR_ACS_X86
+
+// Metrics are unsigned 16 bit and allowed to wrap exactly like the scalar
+// code, but SSE2/AVX2 only have signed 16 bit compares. Flipping the sign bit
+// maps unsigned order onto signed order.
+static const short SIGN_BIAS = static_cast<short>(0x8000);
+
+__attribute__((target("sse2"))) static inline __m128i select_sse2(
+    __m128i a, __m128i a_xor_b, __m128i mask) {
+  return _mm_xor_si128(a, _mm_and_si128(a_xor_b, mask));
+}
+
+__attribute__((target("sse2"))) static void acs_sse2(
+    const uint16_t *read_errors, uint16_t *write_errors, uint64_t *decisions,
+    const uint16_t *distances, const uint16_t *bit0_mask,
+    const uint16_t *bit1_mask) {
+  const __m128i bias = _mm_set1_epi16(SIGN_BIAS);
+  const __m128i d0 = _mm_set1_epi16(distances[0]);
+  const __m128i d2 = _mm_set1_epi16(distances[2]);
+  const __m128i x01 = _mm_set1_epi16(distances[0] ^ distances[1]);
+  const __m128i x23 = _mm_set1_epi16(distances[2] ^ distances[3]);
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 4; i++) {
+    __m128i low_read = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(read_errors + 8 * i));
+    __m128i high_read = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(read_errors + 32 + 8 * i));
+    __m128i high_taken[2];
+
+    for (int h = 0; h < 2; h++) {
+      int s = 16 * i + 8 * h;
+      __m128i low_past = h == 0 ? _mm_unpacklo_epi16(low_read, low_read)
+                                : _mm_unpackhi_epi16(low_read, low_read);
+      __m128i high_past = h == 0 ? _mm_unpacklo_epi16(high_read, high_read)
+                                 : _mm_unpackhi_epi16(high_read, high_read);
+
+      __m128i m0 = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(bit0_mask + s));
+      __m128i m1 = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(bit1_mask + s));
+      __m128i t0 = select_sse2(d0, x01, m0);
+      __m128i t1 = select_sse2(d2, x23, m0);
+      __m128i low_dist = select_sse2(t0, _mm_xor_si128(t0, t1), m1);
+
+      m0 = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(bit0_mask + 64 + s));
+      m1 = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(bit1_mask + 64 + s));
+      t0 = select_sse2(d0, x01, m0);
+      t1 = select_sse2(d2, x23, m0);
+      __m128i high_dist = select_sse2(t0, _mm_xor_si128(t0, t1), m1);
+
+      __m128i low_error =
+          _mm_xor_si128(_mm_add_epi16(low_past, low_dist), bias);
+      __m128i high_error =
+          _mm_xor_si128(_mm_add_epi16(high_past, high_dist), bias);
+
+      high_taken[h] = _mm_cmpgt_epi16(low_error, high_error);
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(write_errors + s),
+          _mm_xor_si128(_mm_min_epi16(low_error, high_error), bias));
+    }
+
+    __m128i packed = _mm_packs_epi16(high_taken[0], high_taken[1]);
+    bits |= static_cast<uint64_t>(_mm_movemask_epi8(packed)) << (16 * i);
+  }
+  *decisions = bits;
+}
+
+__attribute__((target("avx2"))) static inline __m256i select_avx2(
+    __m256i a, __m256i a_xor_b, __m256i mask) {
+  return _mm256_xor_si256(a, _mm256_and_si256(a_xor_b, mask));
+}
+
+__attribute__((target("avx2"))) static void acs_avx2(
+    const uint16_t *read_errors, uint16_t *write_errors, uint64_t *decisions,
+    const uint16_t *distances, const uint16_t *bit0_mask,
+    const uint16_t *bit1_mask) {
+  const __m256i bias = _mm256_set1_epi16(SIGN_BIAS);
+  const __m256i d0 = _mm256_set1_epi16(distances[0]);
+  const __m256i d2 = _mm256_set1_epi16(distances[2]);
+  const __m256i x01 = _mm256_set1_epi16(distances[0] ^ distances[1]);
+  const __m256i x23 = _mm256_set1_epi16(distances[2] ^ distances[3]);
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 2; i++) {
+    // unpack{lo,hi} work within 128 bit lanes, so reorder the quadwords first
+    // to make each unpack produce 16 consecutive successors.
+    __m256i low_read = _mm256_permute4x64_epi64(
+        _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(read_errors + 16 * i)),
+        0xd8);
+    __m256i high_read = _mm256_permute4x64_epi64(
+        _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(read_errors + 32 + 16 * i)),
+        0xd8);
+    __m256i high_taken[2];
+
+    for (int h = 0; h < 2; h++) {
+      int s = 32 * i + 16 * h;
+      __m256i low_past = h == 0 ? _mm256_unpacklo_epi16(low_read, low_read)
+                                : _mm256_unpackhi_epi16(low_read, low_read);
+      __m256i high_past = h == 0
+                              ? _mm256_unpacklo_epi16(high_read, high_read)
+                              : _mm256_unpackhi_epi16(high_read, high_read);
+
+      __m256i m0 = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(bit0_mask + s));
+      __m256i m1 = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(bit1_mask + s));
+      __m256i t0 = select_avx2(d0, x01, m0);
+      __m256i t1 = select_avx2(d2, x23, m0);
+      __m256i low_dist = select_avx2(t0, _mm256_xor_si256(t0, t1), m1);
+
+      m0 = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(bit0_mask + 64 + s));
+      m1 = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(bit1_mask + 64 + s));
+      t0 = select_avx2(d0, x01, m0);
+      t1 = select_avx2(d2, x23, m0);
+      __m256i high_dist = select_avx2(t0, _mm256_xor_si256(t0, t1), m1);
+
+      __m256i low_error =
+          _mm256_xor_si256(_mm256_add_epi16(low_past, low_dist), bias);
+      __m256i high_error =
+          _mm256_xor_si256(_mm256_add_epi16(high_past, high_dist), bias);
+
+      high_taken[h] = _mm256_cmpgt_epi16(low_error, high_error);
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i *>(write_errors + s),
+          _mm256_xor_si256(_mm256_min_epi16(low_error, high_error), bias));
+    }
+
+    // packs also works per lane; undo the resulting quadword interleave.
+    __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packs_epi16(high_taken[0], high_taken[1]), 0xd8);
+    bits |= static_cast<uint64_t>(static_cast<uint32_t>(
+                _mm256_movemask_epi8(packed))) << (32 * i);
+  }
+  *decisions = bits;
+}
+
+#endif  // METEOR_ACS_X86
+
+acs_impl best_acs_impl() {
+#ifdef METEOR_ACS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return ACS_AVX2;
+  if (__builtin_cpu_supports("sse2")) return ACS_SSE2;
+#endif
+  return ACS_SCALAR;
+}
+
+acs_kernel select_acs_kernel(acs_impl impl) {
+  acs_impl best = best_acs_impl();
+  if (impl == ACS_AUTO) impl = best;
+
+#ifdef METEOR_ACS_X86
+  switch (impl) {
+    case ACS_AVX2:
+      if (best == ACS_AVX2) return acs_avx2;
+      break;
+    case ACS_SSE2:
+      if (best == ACS_AVX2 || best == ACS_SSE2) return acs_sse2;
+      break;
+    default:
+      break;
+  }
+#endif
+  return NULL;
+}
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
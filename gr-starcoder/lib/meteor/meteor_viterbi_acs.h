@@ -0,0 +1,66 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_METEOR_VITERBI_ACS_H
+#define INCLUDED_METEOR_VITERBI_ACS_H
+
+#include <cstdint>
+
+namespace gr {
+namespace starcoder {
+namespace meteor {
+
+// Number of trellis states actually in use for the K=7 code.
+const unsigned int ACS_STATES = 64;
+
+enum acs_impl {
+  ACS_AUTO = 0,
+  ACS_SCALAR,
+  ACS_SSE2,
+  ACS_AVX2
+};
+
+// One add-compare-select step over all 64 states.
+//
+// Successor state s is reached from predecessor s / 2 (the "low" branch) and
+// from s / 2 + 32 (the "high" branch). bit0_mask/bit1_mask hold 0xffff for each
+// branch index j (j = s for the low branch, j = s + 64 for the high branch)
+// whose encoder output has the corresponding bit set, so the branch metric is
+// distances[output(j)]. Ties go to the low branch, as in the scalar decoder.
+// Bit s of *decisions is set when successor s took the high branch.
+typedef void (*acs_kernel)(const uint16_t *read_errors, uint16_t *write_errors,
+                           uint64_t *decisions, const uint16_t *distances,
+                           const uint16_t *bit0_mask,
+                           const uint16_t *bit1_mask);
+
+// Returns the kernel for the requested implementation, or NULL when the
+// scalar path should be used. ACS_AUTO picks the widest kernel the running
+// CPU supports; an explicitly requested kernel the CPU cannot run also
+// yields NULL.
+acs_kernel select_acs_kernel(acs_impl impl);
+
+// Implementation actually used by select_acs_kernel(ACS_AUTO).
+acs_impl best_acs_impl();
+
+}  // namespace meteor
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_METEOR_VITERBI_ACS_H */
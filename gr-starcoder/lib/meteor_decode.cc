@@ -0,0 +1,216 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// Offline Meteor-M2 LRPT decoder. Runs the same chain as meteor_decoder_sink
+// over a recording of soft symbols (one signed byte per symbol, as written by
+// a GNU Radio file sink) and reports how long each stage took, so that batch
+// reprocessing can track performance regressions.
+//
+// Usage: meteor_decode [-v] <soft symbols file> [<output png>]
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "meteor/meteor_decoder.h"
+#include "meteor/meteor_packet.h"
+
+namespace meteor = gr::starcoder::meteor;
+
+namespace {
+
+typedef std::chrono::steady_clock stage_clock;
+
+// Bytes of the mapping the decoder sees at once, well below INT_MAX.
+const size_t DECODE_WINDOW = size_t(1) << 30;
+
+double seconds_since(stage_clock::time_point start) {
+  return std::chrono::duration<double>(stage_clock::now() - start).count();
+}
+
+// Same naming as meteor_decoder_sink.
+std::string construct_filename(const std::string &original, int apid) {
+  boost::filesystem::path p(original);
+  boost::filesystem::path modified_filename(p.stem().native() + "_apid_" +
+                                            std::to_string(apid) + ".png");
+  p = p.parent_path() / modified_filename;
+  return p.native();
+}
+
+bool write_file(const std::string &filename, const std::string &contents) {
+  if (contents.empty()) return true;
+  std::ofstream out(filename, std::ios::binary);
+  out << contents;
+  out.close();
+  if (!out) {
+    std::cerr << "Cannot write " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void print_stage(const char *name, double seconds, double total) {
+  std::cout << "  " << name << ": " << seconds << "s ("
+            << 100 * seconds / total << "%)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  bool verbose = false;
+  int arg = 1;
+  if (arg < argc && std::strcmp(argv[arg], "-v") == 0) {
+    verbose = true;
+    arg++;
+  }
+  if (argc - arg < 1 || argc - arg > 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " [-v] <soft symbols file> [<output png>]" << std::endl
+              << "  -v  print the decoder log" << std::endl;
+    return 2;
+  }
+  const std::string input = argv[arg];
+  const std::string output = argc - arg == 2 ? argv[arg + 1] : "";
+
+  int fd = open(input.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Cannot open " << input << ": " << std::strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < meteor::SOFT_FRAME_LEN) {
+    std::cerr << input << " is shorter than one frame" << std::endl;
+    close(fd);
+    return 1;
+  }
+  const size_t raw_len = st.st_size;
+  void *mapping = mmap(NULL, raw_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Cannot map " << input << ": " << std::strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  madvise(mapping, raw_len, MADV_SEQUENTIAL);
+  const uint8_t *raw = static_cast<const uint8_t *>(mapping);
+
+  // The decoder and packeter log every frame to stdout.
+  std::ostringstream discarded;
+  std::streambuf *stdout_buf = std::cout.rdbuf();
+  if (!verbose) std::cout.rdbuf(discarded.rdbuf());
+
+  stage_clock::time_point start = stage_clock::now();
+  meteor::decoder decoder;
+  meteor::packeter packeter;
+  uint8_t error_corrected_data[meteor::HARD_FRAME_LEN];
+  int total_frames = 0, ok_frames = 0;
+  double packets_time = 0;
+  // The decoder addresses its input with int positions, so the mapping is
+  // decoded through a window that slides forward like the streaming sink's
+  // buffer, which gives the same frames as decoding it at once.
+  size_t offset = 0;
+  while (true) {
+    const int window_len =
+        static_cast<int>(std::min(raw_len - offset, DECODE_WINDOW));
+    const bool last = offset + window_len == raw_len;
+    // A resynchronization may look up to two frames ahead of pos().
+    int limit = window_len - meteor::SOFT_FRAME_LEN;
+    if (!last) limit -= meteor::SOFT_FRAME_LEN;
+    while (decoder.pos() < limit) {
+      total_frames++;
+      if (decoder.decode_one_frame(raw + offset, window_len,
+                                   error_corrected_data)) {
+        ok_frames++;
+        stage_clock::time_point packets_start = stage_clock::now();
+        packeter.parse_cvcdu(error_corrected_data,
+                             meteor::HARD_FRAME_LEN - 4 - 128);
+        packets_time += seconds_since(packets_start);
+      }
+    }
+    if (last) break;
+    offset += decoder.pos();
+    decoder.rebase(decoder.pos());
+  }
+  double decode_time = seconds_since(start);
+
+  stage_clock::time_point png_start = stage_clock::now();
+  const meteor::packeter &dump = packeter;
+  std::future<std::string> png_r = std::async(std::launch::async, [&dump]() {
+    return dump.dump_gray_image(meteor::RED_APID);
+  });
+  std::future<std::string> png_g = std::async(std::launch::async, [&dump]() {
+    return dump.dump_gray_image(meteor::GREEN_APID);
+  });
+  std::future<std::string> png_b = std::async(std::launch::async, [&dump]() {
+    return dump.dump_gray_image(meteor::BLUE_APID);
+  });
+  std::string png_img = dump.dump_image();
+  std::string png_r_data = png_r.get();
+  std::string png_g_data = png_g.get();
+  std::string png_b_data = png_b.get();
+  double png_time = seconds_since(png_start);
+  double total_time = seconds_since(start);
+
+  std::cout.rdbuf(stdout_buf);
+  munmap(mapping, raw_len);
+
+  bool written = true;
+  if (!output.empty()) {
+    written &= write_file(output, png_img);
+    written &= write_file(construct_filename(output, meteor::RED_APID),
+                          png_r_data);
+    written &= write_file(construct_filename(output, meteor::GREEN_APID),
+                          png_g_data);
+    written &= write_file(construct_filename(output, meteor::BLUE_APID),
+                          png_b_data);
+  }
+
+  meteor::decoder_timings timings = decoder.timings();
+  std::cout << "packets: " << ok_frames << " out of " << total_frames
+            << std::endl;
+  std::cout << "time: " << total_time << "s, " << total_frames / decode_time
+            << " frames/s, " << raw_len / decode_time / 1e6
+            << " MB/s of soft symbols" << std::endl;
+  print_stage("correlate", timings.correlate, total_time);
+  print_stage("viterbi", timings.viterbi, total_time);
+  print_stage("rs", timings.ecc, total_time);
+  print_stage("huffman/idct", packets_time, total_time);
+  print_stage("png", png_time, total_time);
+  print_stage("other",
+              total_time - timings.correlate - timings.viterbi -
+                  timings.ecc - packets_time - png_time,
+              total_time);
+
+  return ok_frames > 0 && written ? 0 : 1;
+}
@@ -22,47 +22,108 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <future>
 
 #include <gnuradio/io_signature.h>
 #include "meteor_decoder_sink_impl.h"
 
-#include "meteor/meteor_decoder.h"
-#include "meteor/meteor_packet.h"
-
+#include "meteor/meteor_parallel_decoder.h"
 #include "pmt_to_proto.h"
 
 namespace gr {
 namespace starcoder {
 
+// Size of the streaming mode buffer. decode_stream() leaves at most two frames
+// unconsumed, so each work() call has room for at least two more.
+static const int STREAM_BUFFER_LEN = 4 * meteor::SOFT_FRAME_LEN;
+
 meteor_decoder_sink::sptr meteor_decoder_sink::make(
-    const std::string &filename_png) {
-  return gnuradio::get_initial_sptr(new meteor_decoder_sink_impl(filename_png));
+    const std::string &filename_png, bool streaming, int threads,
+    bool progressive, bool telemetry, int sync_candidates) {
+  return gnuradio::get_initial_sptr(
+      new meteor_decoder_sink_impl(filename_png, streaming, threads,
+                                   progressive, telemetry, sync_candidates));
 }
 
 /*
  * The private constructor
  */
 meteor_decoder_sink_impl::meteor_decoder_sink_impl(
-    const std::string &filename_png)
+    const std::string &filename_png, bool streaming, int threads,
+    bool progressive, bool telemetry, int sync_candidates)
     : gr::sync_block("meteor_decoder_sink",
                      gr::io_signature::make(1, 1, sizeof(uint8_t)),
                      gr::io_signature::make(0, 0, 0)),
       total_size_(0),
       filename_(filename_png),
-      string_queue_(NULL) {}
+      string_queue_(NULL),
+      streaming_(streaming),
+      threads_(threads),
+      progressive_(progressive),
+      telemetry_(telemetry),
+      sync_candidates_(sync_candidates),
+      error_corrected_data_(new uint8_t[meteor::HARD_FRAME_LEN]()),
+      total_frames_(0),
+      ok_frames_(0),
+      corrected_bits_(0),
+      corrected_symbols_(0),
+      stream_len_(0),
+      stream_offset_(0) {
+  if (streaming_) stream_buffer_.reset(new uint8_t[STREAM_BUFFER_LEN]());
+}
 
 /*
  * Our virtual destructor.
  */
 meteor_decoder_sink_impl::~meteor_decoder_sink_impl() {}
 
+bool meteor_decoder_sink_impl::start() {
+  // Speculating on the next frames needs the whole pass, so in streaming mode
+  // the worker pool only decodes the sync candidates.
+  if (threads_ != 1)
+    decoder_.reset(new meteor::parallel_decoder(threads_, !streaming_));
+  else
+    decoder_.reset(new meteor::decoder());
+  decoder_->set_sync_candidates(sync_candidates_);
+  packeter_.reset(new meteor::packeter());
+  if (progressive_) {
+    packeter_->set_strip_callback(
+        std::bind(&meteor_decoder_sink_impl::push_strip, this,
+                  std::placeholders::_1, std::placeholders::_2,
+                  std::placeholders::_3));
+  }
+  total_frames_ = 0;
+  ok_frames_ = 0;
+  corrected_bits_ = 0;
+  corrected_symbols_ = 0;
+  stream_len_ = 0;
+  stream_offset_ = 0;
+  return true;
+}
+
 int meteor_decoder_sink_impl::work(int noutput_items,
                                    gr_vector_const_void_star &input_items,
                                    gr_vector_void_star &output_items) {
   size_t block_size = input_signature()->sizeof_stream_item(0);
   const uint8_t *in = (const uint8_t *)input_items[0];
 
+  if (streaming_) {
+    int consumed = 0;
+    while (consumed < noutput_items) {
+      int n = std::min(noutput_items - consumed,
+                       STREAM_BUFFER_LEN - stream_len_);
+      std::copy(in + consumed, in + consumed + n,
+                stream_buffer_.get() + stream_len_);
+      stream_len_ += n;
+      consumed += n;
+      decode_stream(false);
+    }
+    return noutput_items;
+  }
+
   total_size_ += noutput_items * block_size;
 
   uint8_t *buffer = new uint8_t[noutput_items * block_size];
@@ -74,51 +135,111 @@ int meteor_decoder_sink_impl::work(int noutput_items,
   return noutput_items;
 }
 
-bool meteor_decoder_sink_impl::stop() {
-  if (items_.empty()) {
-    return true;
+void meteor_decoder_sink_impl::decode_next_frame(const uint8_t *raw,
+                                                 int raw_len, int64_t offset) {
+  total_frames_++;
+  bool res = decoder_->decode_one_frame(raw, raw_len,
+                                        error_corrected_data_.get());
+  if (res) {
+    ok_frames_++;
+    corrected_bits_ += decoder_->bit_errors();
+    std::array<int, 4> ecc_results = decoder_->ecc_results();
+    for (int i = 0; i < ecc_results.size(); i++) {
+      corrected_symbols_ += ecc_results[i];
+    }
+    std::cout << std::dec << offset + decoder_->prev_pos() << " " << std::hex
+              << decoder_->last_sync() << std::endl;
+  }
+  if (telemetry_) push_telemetry(offset + decoder_->prev_pos(), res);
+  if (res) {
+    packeter_->parse_cvcdu(error_corrected_data_.get(),
+                           meteor::HARD_FRAME_LEN - 4 - 128);
   }
+}
 
-  meteor::decoder decoder;
-  meteor::packeter packeter;
+void meteor_decoder_sink_impl::decode_stream(bool flush) {
+  // A resynchronization may look up to two frames ahead of pos(). Unless this
+  // is the end of the stream, wait for that much data so that the result is
+  // the same as decoding the whole pass at once.
+  int limit = stream_len_ - meteor::SOFT_FRAME_LEN;
+  if (!flush) limit -= meteor::SOFT_FRAME_LEN;
 
-  std::unique_ptr<uint8_t[]> raw(new uint8_t[total_size_]());
-  int copied_so_far = 0;
-  for (auto it = items_.cbegin(); it != items_.cend(); it++) {
-    std::copy((*it).partial_stream, (*it).partial_stream + (*it).size,
-              raw.get() + copied_so_far);
-    copied_so_far += (*it).size;
-    delete[](*it).partial_stream;
+  while (decoder_->pos() < limit) {
+    decode_next_frame(stream_buffer_.get(), stream_len_, stream_offset_);
   }
 
-  std::unique_ptr<uint8_t[]> error_corrected_data(
-      new uint8_t[meteor::HARD_FRAME_LEN]());
-
-  int total = 0;
-  int ok = 0;
-  while (decoder.pos() < total_size_ - meteor::SOFT_FRAME_LEN) {
-    total++;
-    bool res = decoder.decode_one_frame(raw.get(), total_size_,
-                                        error_corrected_data.get());
-    if (res) {
-      ok++;
-      std::cout << std::dec << 100. * decoder.pos() / total_size_ << "% "
-                << decoder.prev_pos() << " " << std::hex << decoder.last_sync()
-                << std::endl;
-      packeter.parse_cvcdu(error_corrected_data.get(),
-                           meteor::HARD_FRAME_LEN - 4 - 128);
+  int drop = std::min(decoder_->pos(), stream_len_);
+  if (drop <= 0) return;
+  std::copy(stream_buffer_.get() + drop, stream_buffer_.get() + stream_len_,
+            stream_buffer_.get());
+  stream_len_ -= drop;
+  stream_offset_ += drop;
+  decoder_->rebase(drop);
+}
+
+bool meteor_decoder_sink_impl::stop() {
+  if (streaming_) {
+    decode_stream(true);
+    decoder_->shutdown();
+    if (total_frames_ == 0) return true;
+  } else {
+    if (items_.empty()) {
+      decoder_->shutdown();
+      return true;
     }
+
+    std::unique_ptr<uint8_t[]> raw(new uint8_t[total_size_]());
+    int copied_so_far = 0;
+    for (auto it = items_.cbegin(); it != items_.cend(); it++) {
+      std::copy((*it).partial_stream, (*it).partial_stream + (*it).size,
+                raw.get() + copied_so_far);
+      copied_so_far += (*it).size;
+      delete[](*it).partial_stream;
+    }
+    items_.clear();
+
+    while (decoder_->pos() < total_size_ - meteor::SOFT_FRAME_LEN) {
+      decode_next_frame(raw.get(), total_size_, 0);
+    }
+    // Wait for the workers of a parallel decoder, which may still be reading
+    // raw, and drop the frames they were queued ahead.
+    decoder_->shutdown();
+    total_size_ = 0;
   }
 
-  std::cout << std::dec << "packets: " << ok << " out of " << total
-            << std::endl;
+  std::cout << std::dec << "packets: " << ok_frames_ << " out of "
+            << total_frames_ << std::endl;
+
+  // In progressive mode the clients already have all but the last strips,
+  // so the images are not sent again.
+  if (progressive_) packeter_->flush_strips();
+
+  // Without a file to write or a queue to send them to, encoding the PNGs
+  // would only be wasted time at the end of a pass.
+  bool send_images = string_queue_ != NULL && !progressive_;
+  if (!send_images && filename_.empty()) return true;
 
+  // The dumps only read the decoded image, so the four PNGs are encoded
+  // concurrently.
+  const meteor::packeter &packeter = *packeter_;
+  std::future<std::string> png_r_future =
+      std::async(std::launch::async, [&packeter]() {
+        return packeter.dump_gray_image(meteor::RED_APID);
+      });
+  std::future<std::string> png_g_future =
+      std::async(std::launch::async, [&packeter]() {
+        return packeter.dump_gray_image(meteor::GREEN_APID);
+      });
+  std::future<std::string> png_b_future =
+      std::async(std::launch::async, [&packeter]() {
+        return packeter.dump_gray_image(meteor::BLUE_APID);
+      });
   std::string png_img = packeter.dump_image();
-  std::string png_r = packeter.dump_gray_image(meteor::RED_APID);
-  std::string png_g = packeter.dump_gray_image(meteor::GREEN_APID);
-  std::string png_b = packeter.dump_gray_image(meteor::BLUE_APID);
+  std::string png_r = png_r_future.get();
+  std::string png_g = png_g_future.get();
+  std::string png_b = png_b_future.get();
 
-  if (string_queue_ != NULL) {
+  if (send_images) {
     ::starcoder::BlockMessage grpc_pmt;
     if (!png_img.empty()) {
       grpc_pmt.set_blob_value(png_img);
@@ -165,6 +286,8 @@ bool meteor_decoder_sink_impl::stop() {
       out.close();
     }
   }
+
+  return true;
 }
 
 std::string meteor_decoder_sink_impl::construct_filename(
@@ -176,9 +299,76 @@ std::string meteor_decoder_sink_impl::construct_filename(
   return p.native();
 }
 
+void meteor_decoder_sink_impl::push_telemetry(int64_t position, bool ok) {
+  if (string_queue_ == NULL) return;
+
+  ::starcoder::BlockMessage grpc_pmt;
+  ::starcoder::Dict *dict = grpc_pmt.mutable_dict_value();
+  ::starcoder::Dict_Entry *entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("position");
+  entry->mutable_value()->set_integer_value(position);
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("ok");
+  entry->mutable_value()->set_boolean_value(ok);
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("correlation");
+  entry->mutable_value()->set_integer_value(decoder_->correlation());
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("bit_errors");
+  entry->mutable_value()->set_integer_value(decoder_->bit_errors());
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("ber");
+  entry->mutable_value()->set_double_value(
+      static_cast<double>(decoder_->bit_errors()) /
+      (2 * meteor::FRAME_BITS));
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("rs_corrections");
+  ::starcoder::IVector *corrections = entry->mutable_value()
+                                          ->mutable_uniform_vector_value()
+                                          ->mutable_i_value();
+  corrections->set_size(::starcoder::IntSize::Size32);
+  std::array<int, 4> ecc_results = decoder_->ecc_results();
+  for (int i = 0; i < ecc_results.size(); i++) {
+    corrections->add_value(ecc_results[i]);
+  }
+  string_queue_->push(grpc_pmt.SerializeAsString());
+}
+
+void meteor_decoder_sink_impl::push_strip(int apid, int line,
+                                          const std::vector<uint8_t> &pixels) {
+  if (string_queue_ == NULL) return;
+
+  ::starcoder::BlockMessage grpc_pmt;
+  ::starcoder::Dict *dict = grpc_pmt.mutable_dict_value();
+  ::starcoder::Dict_Entry *entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("apid");
+  entry->mutable_value()->set_integer_value(apid);
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("line");
+  entry->mutable_value()->set_integer_value(line);
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("width");
+  entry->mutable_value()->set_integer_value(8 * meteor::MCU_PER_LINE);
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("pixels");
+  entry->mutable_value()->set_blob_value(
+      std::string(pixels.begin(), pixels.end()));
+  string_queue_->push(grpc_pmt.SerializeAsString());
+}
+
 void meteor_decoder_sink_impl::register_starcoder_queue(uint64_t ptr) {
   string_queue_ = reinterpret_cast<string_queue *>(ptr);
 }
 
+int meteor_decoder_sink_impl::total_frames() { return total_frames_; }
+
+int meteor_decoder_sink_impl::ok_frames() { return ok_frames_; }
+
+int meteor_decoder_sink_impl::corrected_bits() { return corrected_bits_; }
+
+int meteor_decoder_sink_impl::corrected_symbols() {
+  return corrected_symbols_;
+}
+
 } /* namespace starcoder */
 } /* namespace gr */
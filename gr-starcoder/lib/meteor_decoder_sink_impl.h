@@ -22,9 +22,14 @@
 #define INCLUDED_STARCODER_METEOR_DECODER_SINK_IMPL_H
 
 #include <starcoder/meteor_decoder_sink.h>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <string_queue.h>
 
+#include "meteor/meteor_decoder.h"
+#include "meteor/meteor_packet.h"
+
 namespace gr {
 namespace starcoder {
 struct item {
@@ -35,22 +40,53 @@ struct item {
 class meteor_decoder_sink_impl : public meteor_decoder_sink {
  private:
   std::string construct_filename(const std::string &original, int apid);
+  void decode_next_frame(const uint8_t *raw, int raw_len, int64_t offset);
+  void decode_stream(bool flush);
+  void push_strip(int apid, int line, const std::vector<uint8_t> &pixels);
+  void push_telemetry(int64_t position, bool ok);
 
   std::vector<item> items_;
   int total_size_;
   string_queue *string_queue_;
   std::string filename_;
+  bool streaming_;
+  int threads_;
+  bool progressive_;
+  bool telemetry_;
+  int sync_candidates_;
+
+  std::unique_ptr<meteor::decoder> decoder_;
+  std::unique_ptr<meteor::packeter> packeter_;
+  std::unique_ptr<uint8_t[]> error_corrected_data_;
+  std::atomic<int> total_frames_;
+  std::atomic<int> ok_frames_;
+  std::atomic<int> corrected_bits_;
+  std::atomic<int> corrected_symbols_;
+
+  // Streaming mode only: soft symbols not yet consumed by the decoder, and
+  // the absolute stream offset of stream_buffer_[0].
+  std::unique_ptr<uint8_t[]> stream_buffer_;
+  int stream_len_;
+  int64_t stream_offset_;
 
  public:
-  meteor_decoder_sink_impl(const std::string &filename_png);
+  meteor_decoder_sink_impl(const std::string &filename_png, bool streaming,
+                           int threads, bool progressive, bool telemetry,
+                           int sync_candidates);
   ~meteor_decoder_sink_impl();
 
   // Where all the action really happens
   int work(int noutput_items, gr_vector_const_void_star &input_items,
            gr_vector_void_star &output_items);
 
+  bool start();
   bool stop();
   void register_starcoder_queue(uint64_t ptr);
+
+  int total_frames();
+  int ok_frames();
+  int corrected_bits();
+  int corrected_symbols();
 };
 
 }  // namespace starcoder
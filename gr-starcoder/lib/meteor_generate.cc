@@ -0,0 +1,151 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// Synthetic Meteor-M2 LRPT stream generator. Codes an image the way the
+// satellite does and writes the soft symbols (one signed byte per symbol,
+// like a GNU Radio file sink after the demodulator), so that meteor_decode and
+// meteor_decoder_sink can be tested and benchmarked on passes of any length.
+// The image is tiled to the 1568 pixel LRPT line and repeats for as long as
+// the stream lasts; its red, green and blue channels go to APIDs 68, 65 and
+// 64.
+//
+// Usage: meteor_generate [options] <image png> <soft symbols file>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gil_util.h"
+#include "meteor/meteor_decoder.h"
+#include "meteor/meteor_generator.h"
+
+namespace meteor = gr::starcoder::meteor;
+
+namespace {
+
+void usage(const char *name) {
+  std::cerr << "Usage: " << name
+            << " [options] <image png> <soft symbols file>" << std::endl
+            << "  -t SECONDS  length of the stream (default 60)" << std::endl
+            << "  -n DB       soft symbol amplitude to noise ratio (default "
+               "no noise)" << std::endl
+            << "  -r N        rotate the constellation by N * 90 degrees"
+            << std::endl
+            << "  -f          swap I and Q" << std::endl
+            << "  -q Q        JPEG quality factor (default 80)" << std::endl
+            << "  -s SEED     noise seed (default 1)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  meteor::generator_options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:r:fq:s:")) != -1) {
+    switch (opt) {
+      case 't':
+        options.seconds = std::atof(optarg);
+        break;
+      case 'n':
+        options.snr_db = std::atof(optarg);
+        break;
+      case 'r':
+        options.rotation = std::atoi(optarg);
+        break;
+      case 'f':
+        options.flip_iq = true;
+        break;
+      case 'q':
+        options.quality = std::atoi(optarg);
+        break;
+      case 's':
+        options.seed = std::strtoul(optarg, NULL, 0);
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+  if (argc - optind != 2 || options.quality < 1 || options.quality > 100) {
+    usage(argv[0]);
+    return 2;
+  }
+  const std::string input = argv[optind];
+  const std::string output = argv[optind + 1];
+
+  boost::gil::rgb8_image_t source;
+  try {
+    boost::gil::png_read_and_convert_image(input, source);
+  } catch (const std::exception &e) {
+    std::cerr << "Cannot read " << input << ": " << e.what() << std::endl;
+    return 1;
+  }
+  boost::gil::rgb8_image_t::const_view_t v = boost::gil::const_view(source);
+  if (v.width() == 0 || v.height() == 0) {
+    std::cerr << input << " is empty" << std::endl;
+    return 1;
+  }
+
+  meteor::image_store image(8 * meteor::MCU_PER_LINE, 3);
+  image.grow((v.height() + 7) / 8 * 8);
+  for (int y = 0; y < image.lines(); y++) {
+    for (int x = 0; x < image.width(); x++) {
+      const boost::gil::rgb8_pixel_t &p = v(x % v.width(), y % v.height());
+      image.row(0, y)[x] = p[0];
+      image.row(1, y)[x] = p[1];
+      image.row(2, y)[x] = p[2];
+    }
+  }
+
+  std::ofstream out(output, std::ios::binary);
+  if (!out) {
+    std::cerr << "Cannot write " << output << std::endl;
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  meteor::generator generator(image, options);
+  std::vector<uint8_t> soft(meteor::SOFT_FRAME_LEN);
+  while (generator.next_frame(soft.data())) {
+    out.write(reinterpret_cast<const char *>(soft.data()), soft.size());
+  }
+  out.close();
+  if (!out) {
+    std::cerr << "Cannot write " << output << std::endl;
+    return 1;
+  }
+  double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  std::cout << "frames: " << generator.frames() << " ("
+            << static_cast<double>(generator.frames()) *
+                   meteor::SOFT_FRAME_LEN / 1e6
+            << " MB)" << std::endl;
+  std::cout << "time: " << elapsed << "s, " << generator.frames() / elapsed
+            << " frames/s" << std::endl;
+  return 0;
+}
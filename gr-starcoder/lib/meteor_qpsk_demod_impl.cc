@@ -0,0 +1,94 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "meteor_qpsk_demod_impl.h"
+
+#include <cmath>
+
+namespace gr {
+namespace starcoder {
+
+meteor_qpsk_demod::sptr meteor_qpsk_demod::make(double samp_rate,
+                                                double symbol_rate,
+                                                float rrc_alpha,
+                                                float costas_bw,
+                                                float timing_bw) {
+  return gnuradio::get_initial_sptr(new meteor_qpsk_demod_impl(
+      samp_rate, symbol_rate, rrc_alpha, costas_bw, timing_bw));
+}
+
+/*
+ * The private constructor
+ */
+meteor_qpsk_demod_impl::meteor_qpsk_demod_impl(double samp_rate,
+                                               double symbol_rate,
+                                               float rrc_alpha,
+                                               float costas_bw,
+                                               float timing_bw)
+    : gr::block("meteor_qpsk_demod",
+                gr::io_signature::make(1, 1, sizeof(gr_complex)),
+                gr::io_signature::make(1, 1, sizeof(int8_t))),
+      demod_(samp_rate, symbol_rate, rrc_alpha, costas_bw, timing_bw),
+      frequency_offset_(0),
+      locked_(false) {
+  // Each symbol is output as a pair of soft bits.
+  set_output_multiple(2);
+  set_relative_rate(2 * symbol_rate / samp_rate);
+}
+
+/*
+ * Our virtual destructor.
+ */
+meteor_qpsk_demod_impl::~meteor_qpsk_demod_impl() {}
+
+void meteor_qpsk_demod_impl::forecast(int noutput_items,
+                                      gr_vector_int &ninput_items_required) {
+  ninput_items_required[0] =
+      std::ceil(noutput_items / 2 * demod_.samples_per_symbol()) + 1;
+}
+
+int meteor_qpsk_demod_impl::general_work(
+    int noutput_items, gr_vector_int &ninput_items,
+    gr_vector_const_void_star &input_items,
+    gr_vector_void_star &output_items) {
+  const gr_complex *in = (const gr_complex *)input_items[0];
+  int8_t *out = (int8_t *)output_items[0];
+
+  int consumed;
+  int produced =
+      demod_.work(in, ninput_items[0], out, noutput_items, consumed);
+  frequency_offset_ = demod_.frequency_offset();
+  locked_ = demod_.locked();
+
+  consume_each(consumed);
+  return produced;
+}
+
+double meteor_qpsk_demod_impl::frequency_offset() { return frequency_offset_; }
+
+bool meteor_qpsk_demod_impl::locked() { return locked_; }
+
+} /* namespace starcoder */
+} /* namespace gr */
@@ -0,0 +1,58 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_STARCODER_METEOR_QPSK_DEMOD_IMPL_H
+#define INCLUDED_STARCODER_METEOR_QPSK_DEMOD_IMPL_H
+
+#include <starcoder/meteor_qpsk_demod.h>
+#include <atomic>
+
+#include "meteor/meteor_demod.h"
+
+namespace gr {
+namespace starcoder {
+
+class meteor_qpsk_demod_impl : public meteor_qpsk_demod {
+ private:
+  meteor::qpsk_demod demod_;
+  // Copies of the loop state, so that they may be read while the flowgraph
+  // runs.
+  std::atomic<double> frequency_offset_;
+  std::atomic<bool> locked_;
+
+ public:
+  meteor_qpsk_demod_impl(double samp_rate, double symbol_rate,
+                         float rrc_alpha, float costas_bw, float timing_bw);
+  ~meteor_qpsk_demod_impl();
+
+  void forecast(int noutput_items, gr_vector_int &ninput_items_required);
+
+  int general_work(int noutput_items, gr_vector_int &ninput_items,
+                   gr_vector_const_void_star &input_items,
+                   gr_vector_void_star &output_items);
+
+  double frequency_offset();
+  bool locked();
+};
+
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_STARCODER_METEOR_QPSK_DEMOD_IMPL_H */
@@ -44,6 +44,7 @@
 #include <gnuradio/io_signature.h>
 #include "noaa_apt_sink_impl.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include "gil_util.h"
@@ -52,48 +53,32 @@
 namespace gr {
 namespace starcoder {
 
-// Noaa apt sync pattern A
-// (see https://sourceforge.isae.fr/attachments/download/1813/apt_synch.gif)
-const bool noaa_apt_sink_impl::synca_seq[] = {
-  false, false, false, false, true, true, false, false,  // Pulse 1
-  true, true, false, false,                              // Pulse 2
-  true, true, false, false,                              // Pulse 3
-  true, true, false, false,                              // Pulse 4
-  true, true, false, false,                              // Pulse 5
-  true, true, false, false,                              // Pulse 6
-  true, true, false, false,                              // Pulse 7
-  false, false, false, false, false, false, false, false
-};
-
-// Noaa apt sync pattern B
-// (see https://sourceforge.isae.fr/attachments/download/1813/apt_synch.gif)
-const bool noaa_apt_sink_impl::syncb_seq[] = {
-  false, false, false, false, true, true, true, false, false, true, true, true,
-  false, false, true, true, true, false, false, true, true, true, false, false,
-  true, true, true, false, false, true, true, true, false, false, true, true,
-  true, false, false, false
-};
-
 noaa_apt_sink::sptr noaa_apt_sink::make(const char *filename_png, size_t width,
-                                        size_t height, bool sync, bool flip) {
-  return gnuradio::get_initial_sptr(
-      new noaa_apt_sink_impl(filename_png, width, height, sync, flip));
+                                        size_t height, bool sync, bool flip,
+                                        bool streaming, size_t batch_lines) {
+  return gnuradio::get_initial_sptr(new noaa_apt_sink_impl(
+      filename_png, width, height, sync, flip, streaming, batch_lines));
 }
 
 /*
  * The private constructor
  */
 noaa_apt_sink_impl::noaa_apt_sink_impl(const char *filename_png, size_t width,
-                                       size_t height, bool sync, bool flip)
+                                       size_t height, bool sync, bool flip,
+                                       bool streaming, size_t batch_lines)
     : gr::sync_block("noaa_apt_sink",
                      gr::io_signature::make(1, 1, sizeof(float)),
                      gr::io_signature::make(0, 0, 0)),
       f_average_alpha(0.25),
+      d_sync_kernel(select_apt_sync_kernel(APT_SYNC_AUTO)),
       d_filename_png(filename_png),
       d_width(width),
       d_height(height),
       d_synchronize_opt(sync),
       d_flip(flip),
+      d_streaming(streaming),
+      d_batch_lines(std::max(std::min(batch_lines, height), size_t(1))),
+      d_pending_lines(0),
       d_history_length(40),
       d_has_sync(false),
       d_image_received(false),
@@ -103,10 +88,11 @@ noaa_apt_sink_impl::noaa_apt_sink_impl(const char *filename_png, size_t width,
       f_max_level(0.0),
       f_min_level(1.0),
       f_average(0.0),
-      image_received_(width, height),
+      image_received_(width, streaming ? d_batch_lines : height),
       string_queue_(NULL) {
   set_history(d_history_length);
   image_received_view_ = view(image_received_);
+  boost::gil::fill_pixels(image_received_view_, boost::gil::gray8_pixel_t(0));
 }
 
 /*
@@ -141,7 +127,15 @@ void noaa_apt_sink_impl::write_image(std::string filename) {
 }
 
 bool noaa_apt_sink_impl::stop() {
-  if (!d_image_received) {
+  if (d_streaming) {
+    // Output the partial line and batch, the rest of the frame stays black
+    if (d_current_x > 0) end_streamed_line();
+    if (d_pending_lines > 0) push_lines();
+    if (d_frame_writer) {
+      d_frame_writer->finish();
+      d_frame_writer.reset();
+    }
+  } else if (!d_image_received) {
     write_image(d_filename_png);
   }
   return true;
@@ -151,7 +145,7 @@ void noaa_apt_sink_impl::set_pixel(size_t x, size_t y, float sample) {
   // Adjust dynamic range, using minimum and maximum values
   sample = (sample - f_min_level) / (f_max_level - f_min_level) * 255;
   // Set the pixel in the full image
-  image_received_view_(x, y) = boost::gil::gray8_pixel_t(sample);
+  image_received_view_(x, image_row(y)) = boost::gil::gray8_pixel_t(sample);
 }
 
 void noaa_apt_sink_impl::skip_to(size_t new_x, size_t pos,
@@ -173,34 +167,9 @@ void noaa_apt_sink_impl::skip_to(size_t new_x, size_t pos,
 
 noaa_apt_sync_marker noaa_apt_sink_impl::is_marker(size_t pos,
                                                    const float *samples) {
-  // Initialize counters for 'hacky' correlation
-  size_t count_a = 0;
-  size_t count_b = 0;
-
-  for (size_t i = 0; i < 40; i++) {
-    // history of previous 39 samples + current one
-    // -> start 39 samples in the past
-    float sample = samples[pos - 39 + i];
-    // Remove DC-offset (aka. the average value of the sync pattern)
-    sample = sample - f_average;
-
-    // Very basic 1/0 correlation between pattern constan and history
-    if ((sample > 0 && synca_seq[i]) || (sample < 0 && !syncb_seq[i])) {
-      count_a += 1;
-    }
-    if ((sample > 0 && syncb_seq[i]) || (sample < 0 && !syncb_seq[i])) {
-      count_b += 1;
-    }
-  }
-
-  // Prefer sync pattern a as it is detected more reliable
-  if (count_a > 35) {
-    return noaa_apt_sync_marker::SYNC_A;
-  } else if (count_b > 35) {
-    return noaa_apt_sync_marker::SYNC_B;
-  } else {
-    return noaa_apt_sync_marker::NONE;
-  }
+  // history of previous 39 samples + current one
+  // -> start 39 samples in the past
+  return d_sync_kernel(samples + pos - 39, f_average);
 }
 
 int noaa_apt_sink_impl::work(int noutput_items,
@@ -263,7 +232,9 @@ int noaa_apt_sink_impl::work(int noutput_items,
     // Increment x position
     d_current_x += 1;
     // If we are beyond the end of line
-    if (d_current_x >= d_width) {
+    if (d_streaming && d_current_x >= d_width) {
+      end_streamed_line();
+    } else if (d_current_x >= d_width) {
       // Increment y position
       d_current_y += 1;
       // Reset x position to line start
@@ -284,6 +255,84 @@ int noaa_apt_sink_impl::work(int noutput_items,
   return noutput_items;
 }
 
+size_t noaa_apt_sink_impl::image_row(size_t y) const {
+  return d_streaming ? y % d_batch_lines : y;
+}
+
+void noaa_apt_sink_impl::end_streamed_line() {
+  if (!d_frame_writer && d_filename_png != "") {
+    d_frame_writer.reset(new png_row_writer(frame_filename(d_num_images),
+                                            d_width, d_height, 1));
+  }
+  if (d_frame_writer) {
+    d_frame_writer->write_row(reinterpret_cast<const uint8_t *>(
+        &*image_received_view_.row_begin(image_row(d_current_y))));
+  }
+
+  d_pending_lines += 1;
+  d_current_y += 1;
+  d_current_x = 0;
+  if (d_pending_lines == d_batch_lines || d_current_y >= d_height) {
+    push_lines();
+  }
+
+  // Split the frame if there are enough lines decoded
+  if (d_current_y >= d_height) {
+    d_current_y = 0;
+    d_num_images += 1;
+    if (d_frame_writer) {
+      d_frame_writer->finish();
+      d_frame_writer.reset();
+    }
+  }
+
+  // The row of the new line may still hold an older line
+  std::fill(image_received_view_.row_begin(image_row(d_current_y)),
+            image_received_view_.row_end(image_row(d_current_y)),
+            boost::gil::gray8_pixel_t(0));
+}
+
+void noaa_apt_sink_impl::push_lines() {
+  size_t first = d_current_y - d_pending_lines;
+  size_t count = d_pending_lines;
+  d_pending_lines = 0;
+  if (string_queue_ == NULL) return;
+
+  // Batches never wrap around image_received_, they start at multiples of
+  // d_batch_lines within the frame.
+  std::string pixels;
+  pixels.reserve(count * d_width);
+  for (size_t y = first; y < first + count; y++) {
+    const char *row = reinterpret_cast<const char *>(
+        &*image_received_view_.row_begin(image_row(y)));
+    pixels.append(row, d_width);
+  }
+
+  ::starcoder::BlockMessage grpc_pmt;
+  ::starcoder::Dict *dict = grpc_pmt.mutable_dict_value();
+  ::starcoder::Dict_Entry *entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("frame");
+  entry->mutable_value()->set_integer_value(d_num_images);
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("line");
+  entry->mutable_value()->set_integer_value(first);
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("width");
+  entry->mutable_value()->set_integer_value(d_width);
+  entry = dict->add_entry();
+  entry->mutable_key()->set_symbol_value("pixels");
+  entry->mutable_value()->set_blob_value(pixels);
+  string_queue_->push(grpc_pmt.SerializeAsString());
+}
+
+std::string noaa_apt_sink_impl::frame_filename(size_t n) const {
+  boost::filesystem::path p(d_filename_png);
+  boost::filesystem::path modified_filename(p.stem().native() + "_" +
+                                            std::to_string(n) + ".png");
+  p = p.parent_path() / modified_filename;
+  return p.native();
+}
+
 void noaa_apt_sink_impl::register_starcoder_queue(uint64_t ptr) {
   string_queue_ = reinterpret_cast<string_queue *>(ptr);
 }
@@ -45,17 +45,18 @@
 #include <chrono>
 #include <string_queue.h>
 #include <boost/gil/gil_all.hpp>
+#include <memory>
+
+#include "gil_util.h"
+#include "noaa_apt_sync.h"
 
 namespace gr {
 namespace starcoder {
-enum class noaa_apt_sync_marker {
-  SYNC_A, SYNC_B, NONE
-};
 
 class noaa_apt_sink_impl : public noaa_apt_sink {
  public:
   noaa_apt_sink_impl(const char *filename_png, size_t width, size_t height,
-                     bool sync, bool flip);
+                     bool sync, bool flip, bool streaming, size_t batch_lines);
   ~noaa_apt_sink_impl();
 
   // Where all the action really happens
@@ -85,17 +86,36 @@ class noaa_apt_sink_impl : public noaa_apt_sink {
   // Writes a single image to disk, also takes care of flipping
   void write_image(std::string filename);
 
+  // In streaming mode, image_received_ only holds the current batch of lines,
+  // line y of the frame being row y % d_batch_lines.
+  size_t image_row(size_t y) const;
+
+  // Streaming mode: outputs the line at d_current_y and moves to the start of
+  // the next one, splitting frames every d_height lines.
+  void end_streamed_line();
+
+  // Sends the lines of the current batch to the registered queue.
+  void push_lines();
+
+  // Filename of frame n in streaming mode.
+  std::string frame_filename(size_t n) const;
+
   // Factor exponential smoothing average,
   // which is used for sync pattern detection
   const float f_average_alpha;
-  static const bool synca_seq[];
-  static const bool syncb_seq[];
+  apt_sync_kernel d_sync_kernel;
 
   std::string d_filename_png;
   size_t d_width;
   size_t d_height;
   bool d_synchronize_opt;
   bool d_flip;
+  bool d_streaming;
+  size_t d_batch_lines;
+  // Streaming mode: lines completed since the last batch was sent, and the
+  // file of the current frame, opened when its first line completes.
+  size_t d_pending_lines;
+  std::unique_ptr<png_row_writer> d_frame_writer;
   size_t d_history_length;
   bool d_has_sync;
   bool d_image_received;
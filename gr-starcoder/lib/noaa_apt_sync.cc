@@ -0,0 +1,193 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "noaa_apt_sync.h"
+
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NOAA_APT_SYNC_X86 1
+#include <immintrin.h>
+#endif
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+// Noaa apt sync pattern A
+// (see https://sourceforge.isae.fr/attachments/download/1813/apt_synch.gif)
+const bool synca_seq[APT_SYNC_LENGTH] = {
+  false, false, false, false, true, true, false, false,  // Pulse 1
+  true, true, false, false,                              // Pulse 2
+  true, true, false, false,                              // Pulse 3
+  true, true, false, false,                              // Pulse 4
+  true, true, false, false,                              // Pulse 5
+  true, true, false, false,                              // Pulse 6
+  true, true, false, false,                              // Pulse 7
+  false, false, false, false, false, false, false, false
+};
+
+// Noaa apt sync pattern B
+// (see https://sourceforge.isae.fr/attachments/download/1813/apt_synch.gif)
+const bool syncb_seq[APT_SYNC_LENGTH] = {
+  false, false, false, false, true, true, true, false, false, true, true, true,
+  false, false, true, true, true, false, false, true, true, true, false, false,
+  true, true, true, false, false, true, true, true, false, false, true, true,
+  true, false, false, false
+};
+
+// The patterns as bit masks, bit i standing for sample i of the window.
+uint64_t pattern_mask(const bool *seq) {
+  uint64_t mask = 0;
+  for (int i = 0; i < APT_SYNC_LENGTH; i++) {
+    if (seq[i]) mask |= uint64_t(1) << i;
+  }
+  return mask;
+}
+
+const uint64_t WINDOW_MASK = (uint64_t(1) << APT_SYNC_LENGTH) - 1;
+const uint64_t SYNC_A_MASK = pattern_mask(synca_seq);
+const uint64_t SYNC_B_MASK = pattern_mask(syncb_seq);
+
+// Scores the samples above (high) and below (low) the average. Samples equal
+// to the average match neither pattern. Like the original loop, the low
+// samples of both patterns are checked against pattern B, which caps the
+// score of pattern A at 31: markers are only ever found on pattern B.
+inline noaa_apt_sync_marker score(uint64_t high, uint64_t low) {
+  int low_count = __builtin_popcountll(low & ~SYNC_B_MASK & WINDOW_MASK);
+  if (__builtin_popcountll(high & SYNC_A_MASK) + low_count > 35) {
+    return noaa_apt_sync_marker::SYNC_A;
+  } else if (__builtin_popcountll(high & SYNC_B_MASK) + low_count > 35) {
+    return noaa_apt_sync_marker::SYNC_B;
+  } else {
+    return noaa_apt_sync_marker::NONE;
+  }
+}
+
+noaa_apt_sync_marker sync_scalar(const float *window, float average) {
+  uint64_t high = 0, low = 0;
+  for (int i = 0; i < APT_SYNC_LENGTH; i++) {
+    float sample = window[i] - average;
+    high |= uint64_t(sample > 0) << i;
+    low |= uint64_t(sample < 0) << i;
+  }
+  return score(high, low);
+}
+
+#ifdef NOAA_APT_SYNC_X86
+
+// The average is subtracted before comparing against zero, rather than
+// comparing against the average, so that the results match the reference
+// bit for bit whatever the rounding and denormal modes.
+__attribute__((target("sse"))) noaa_apt_sync_marker sync_sse(
+    const float *window, float average) {
+  const __m128 avg = _mm_set1_ps(average);
+  const __m128 zero = _mm_setzero_ps();
+  uint64_t high = 0, low = 0;
+  for (int i = 0; i < APT_SYNC_LENGTH; i += 4) {
+    __m128 sample = _mm_sub_ps(_mm_loadu_ps(window + i), avg);
+    high |= uint64_t(_mm_movemask_ps(_mm_cmpgt_ps(sample, zero))) << i;
+    low |= uint64_t(_mm_movemask_ps(_mm_cmplt_ps(sample, zero))) << i;
+  }
+  return score(high, low);
+}
+
+__attribute__((target("avx,popcnt"))) noaa_apt_sync_marker sync_avx(
+    const float *window, float average) {
+  const __m256 avg = _mm256_set1_ps(average);
+  const __m256 zero = _mm256_setzero_ps();
+  uint64_t high = 0, low = 0;
+  for (int i = 0; i < APT_SYNC_LENGTH; i += 8) {
+    __m256 sample = _mm256_sub_ps(_mm256_loadu_ps(window + i), avg);
+    high |= uint64_t(_mm256_movemask_ps(
+                _mm256_cmp_ps(sample, zero, _CMP_GT_OQ))) << i;
+    low |= uint64_t(_mm256_movemask_ps(
+               _mm256_cmp_ps(sample, zero, _CMP_LT_OQ))) << i;
+  }
+  return score(high, low);
+}
+
+#endif  // NOAA_APT_SYNC_X86
+
+apt_sync_impl best_apt_sync_impl() {
+#ifdef NOAA_APT_SYNC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("popcnt")) {
+    return APT_SYNC_AVX;
+  }
+  if (__builtin_cpu_supports("sse")) return APT_SYNC_SSE;
+#endif
+  return APT_SYNC_SCALAR;
+}
+
+}  // namespace
+
+apt_sync_kernel select_apt_sync_kernel(apt_sync_impl impl) {
+  apt_sync_impl best = best_apt_sync_impl();
+  if (impl == APT_SYNC_AUTO) impl = best;
+
+  switch (impl) {
+#ifdef NOAA_APT_SYNC_X86
+    case APT_SYNC_AVX:
+      if (best == APT_SYNC_AVX) return sync_avx;
+      break;
+    case APT_SYNC_SSE:
+      if (best == APT_SYNC_AVX || best == APT_SYNC_SSE) return sync_sse;
+      break;
+#endif
+    case APT_SYNC_SCALAR:
+      return sync_scalar;
+    default:
+      break;
+  }
+  return NULL;
+}
+
+noaa_apt_sync_marker apt_sync_reference(const float *window, float average) {
+  // Initialize counters for 'hacky' correlation
+  int count_a = 0;
+  int count_b = 0;
+
+  for (int i = 0; i < APT_SYNC_LENGTH; i++) {
+    // Remove DC-offset (aka. the average value of the sync pattern)
+    float sample = window[i] - average;
+
+    // Very basic 1/0 correlation between pattern constan and history
+    if ((sample > 0 && synca_seq[i]) || (sample < 0 && !syncb_seq[i])) {
+      count_a += 1;
+    }
+    if ((sample > 0 && syncb_seq[i]) || (sample < 0 && !syncb_seq[i])) {
+      count_b += 1;
+    }
+  }
+
+  // Prefer sync pattern a as it is detected more reliable
+  if (count_a > 35) {
+    return noaa_apt_sync_marker::SYNC_A;
+  } else if (count_b > 35) {
+    return noaa_apt_sync_marker::SYNC_B;
+  } else {
+    return noaa_apt_sync_marker::NONE;
+  }
+}
+
+}  // namespace starcoder
+}  // namespace gr
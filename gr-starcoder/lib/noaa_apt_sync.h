@@ -0,0 +1,61 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_STARCODER_NOAA_APT_SYNC_H
+#define INCLUDED_STARCODER_NOAA_APT_SYNC_H
+
+namespace gr {
+namespace starcoder {
+
+enum class noaa_apt_sync_marker {
+  SYNC_A, SYNC_B, NONE
+};
+
+// Number of samples the sync patterns span.
+const int APT_SYNC_LENGTH = 40;
+
+enum apt_sync_impl {
+  APT_SYNC_AUTO = 0,
+  APT_SYNC_SCALAR,
+  APT_SYNC_SSE,
+  APT_SYNC_AVX
+};
+
+// Matches the APT_SYNC_LENGTH samples of window, with average removed,
+// against sync patterns A and B. The samples above and below the average are
+// packed into bit masks and both patterns are scored with popcount, so each
+// call is a handful of vector compares instead of 80 branches.
+typedef noaa_apt_sync_marker (*apt_sync_kernel)(const float *window,
+                                                float average);
+
+// Returns the kernel for the requested implementation. APT_SYNC_AUTO picks
+// the widest kernel the running CPU supports; an explicitly requested kernel
+// the CPU cannot run yields NULL. All kernels return exactly what
+// apt_sync_reference() returns.
+apt_sync_kernel select_apt_sync_kernel(apt_sync_impl impl);
+
+// Sample by sample comparison against both patterns, as the sink originally
+// did it.
+noaa_apt_sync_marker apt_sync_reference(const float *window, float average);
+
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_STARCODER_NOAA_APT_SYNC_H */
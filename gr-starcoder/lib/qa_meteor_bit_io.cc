@@ -0,0 +1,89 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "qa_meteor_bit_io.h"
+#include <cppunit/TestAssert.h>
+
+#include <random>
+#include <vector>
+
+#include "meteor/meteor_bit_io.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+// The previous bit at a time reader, with zeros past the end.
+uint32_t peek_bitwise(const std::vector<uint8_t> &bytes, int pos, int n) {
+  uint32_t result = 0;
+  for (int i = 0; i < n; i++) {
+    int p = pos + i;
+    int bit = p < 8 * bytes.size() ? (bytes[p >> 3] >> (7 - (p & 7))) & 1 : 0;
+    result = (result << 1) | bit;
+  }
+  return result;
+}
+
+}  // namespace
+
+void qa_meteor_bit_io::test_cached_matches_bitwise() {
+  std::mt19937 rng(7);
+  std::vector<uint8_t> bytes(65536);
+  for (auto &b : bytes) b = rng();
+
+  // Same access pattern as the Huffman decoder: peek 16 bits, then consume a
+  // code and possibly its value bits.
+  std::vector<int> steps(bytes.size() * 2);
+  std::uniform_int_distribution<int> step(0, 16);
+  for (auto &s : steps) s = step(rng);
+
+  std::vector<uint32_t> expected, result;
+  int pos = 0;
+  for (int i = 0; i < steps.size() && pos <= 8 * bytes.size(); i++) {
+    expected.push_back(peek_bitwise(bytes, pos, 16));
+    pos += steps[i];
+  }
+  meteor::bit_io_const reader(bytes.data(), bytes.size());
+  for (int i = 0; !reader.overrun(); i++) {
+    result.push_back(reader.peek_n_bits(16));
+    reader.advance_n_bits(steps[i]);
+  }
+
+  CPPUNIT_ASSERT(expected == result);
+
+  // Every width, including 0 and 32, at every bit alignment and across the
+  // end of the data.
+  std::vector<uint8_t> head(bytes.begin(), bytes.begin() + 16);
+  for (int offset = 0; offset < 8; offset++) {
+    for (int n = 0; n <= 32; n++) {
+      meteor::bit_io_const b(head.data(), head.size());
+      b.advance_n_bits(offset);
+      for (int p = offset; p < 8 * head.size() + 32; p += n + 1) {
+        CPPUNIT_ASSERT_EQUAL(peek_bitwise(head, p, n), b.fetch_n_bits(n));
+        b.advance_n_bits(1);
+      }
+    }
+  }
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
@@ -0,0 +1,57 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_meteor_correlator.h"
+#include <cppunit/TestAssert.h>
+
+#include <fstream>
+#include <vector>
+
+#include "meteor/meteor_correlator.h"
+#include "meteor/meteor_decoder.h"
+
+namespace gr {
+namespace starcoder {
+
+void qa_meteor_correlator::test_packed_matches_table() {
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+                           (std::istreambuf_iterator<char>()));
+  CPPUNIT_ASSERT(buffer.size() > meteor::SOFT_FRAME_LEN);
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(buffer.data());
+
+  meteor::correlator correlator(0xfca2b63db00d9794);
+
+  // An odd step so that the sync word shows up at every bit offset within
+  // the packed words.
+  for (int off = 0; off + meteor::SOFT_FRAME_LEN <= buffer.size();
+       off += 4093) {
+    std::tuple<uint32_t, uint32_t, uint32_t> expected =
+        correlator.corr_correlate_table(raw + off, meteor::SOFT_FRAME_LEN);
+    std::tuple<uint32_t, uint32_t, uint32_t> result =
+        correlator.corr_correlate(raw + off, meteor::SOFT_FRAME_LEN);
+    CPPUNIT_ASSERT_EQUAL(std::get<0>(expected), std::get<0>(result));
+    CPPUNIT_ASSERT_EQUAL(std::get<1>(expected), std::get<1>(result));
+    CPPUNIT_ASSERT_EQUAL(std::get<2>(expected), std::get<2>(result));
+  }
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
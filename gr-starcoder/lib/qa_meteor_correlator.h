@@ -0,0 +1,43 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _QA_METEOR_CORRELATOR_H_
+#define _QA_METEOR_CORRELATOR_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+namespace starcoder {
+
+class qa_meteor_correlator : public CppUnit::TestCase {
+ public:
+  CPPUNIT_TEST_SUITE(qa_meteor_correlator);
+  CPPUNIT_TEST(test_packed_matches_table);
+  CPPUNIT_TEST_SUITE_END();
+
+ private:
+  void test_packed_matches_table();
+};
+
+} /* namespace starcoder */
+} /* namespace gr */
+
+#endif /* _QA_METEOR_CORRELATOR_H_ */
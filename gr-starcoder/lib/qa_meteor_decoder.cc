@@ -22,12 +22,68 @@
 #include <cppunit/TestAssert.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <memory>
+
+#include "gil_util.h"
 #include "meteor/meteor_decoder.h"
+#include "meteor/meteor_generator.h"
+#include "meteor/meteor_parallel_decoder.h"
 #include "meteor/meteor_packet.h"
 
 namespace gr {
 namespace starcoder {
 
+namespace {
+
+// Reads back a PNG produced by the packeter.
+template <typename image_t>
+void read_png_string(const std::string &png, image_t &image) {
+  boost::filesystem::path temp = boost::filesystem::temp_directory_path() /
+                                 boost::filesystem::unique_path();
+  {
+    std::ofstream out(temp.native(), std::ios::binary);
+    out << png;
+  }
+  boost::gil::png_read_image(temp.native(), image);
+  boost::filesystem::remove(temp);
+}
+
+template <typename view_t>
+int max_channel_difference(const view_t &a, const view_t &b) {
+  CPPUNIT_ASSERT_EQUAL(a.width(), b.width());
+  CPPUNIT_ASSERT_EQUAL(a.height(), b.height());
+  int result = 0;
+  for (int y = 0; y < a.height(); y++) {
+    for (int x = 0; x < a.width(); x++) {
+      for (int c = 0; c < boost::gil::num_channels<view_t>::value; c++) {
+        result = std::max(result, std::abs(a(x, y)[c] - b(x, y)[c]));
+      }
+    }
+  }
+  return result;
+}
+
+// Decodes the whole stream, returning the number of good frames and
+// appending their data.
+int decode_all(meteor::decoder &decoder, const std::vector<char> &buffer,
+               std::vector<uint8_t> &data) {
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(buffer.data());
+  std::vector<uint8_t> ecced_data(meteor::HARD_FRAME_LEN);
+  int ok = 0;
+  while (decoder.pos() < buffer.size() - meteor::SOFT_FRAME_LEN) {
+    if (decoder.decode_one_frame(raw, buffer.size(), ecced_data.data())) {
+      data.insert(data.end(), ecced_data.begin(), ecced_data.end());
+      ok++;
+    }
+  }
+  return ok;
+}
+
+}  // namespace
+
 void qa_meteor_decoder::test_dump_empty() {
   meteor::packeter packeter;
 
@@ -70,29 +126,327 @@ void qa_meteor_decoder::test_full_decoding() {
   CPPUNIT_ASSERT_EQUAL(ok, 58);
   CPPUNIT_ASSERT_EQUAL(total, 60);
 
-  std::string png_img = packeter.dump_image();
-  std::ifstream t("test_meteor_image.png", std::ios::binary);
-  std::stringstream buf;
-  buf << t.rdbuf();
-  CPPUNIT_ASSERT_EQUAL(buf.str(), png_img);
-
-  png_img = packeter.dump_gray_image(meteor::RED_APID);
-  t = std::ifstream("test_meteor_image_68.png", std::ios::binary);
-  buf = std::stringstream();
-  buf << t.rdbuf();
-  CPPUNIT_ASSERT_EQUAL(buf.str(), png_img);
-
-  png_img = packeter.dump_gray_image(meteor::GREEN_APID);
-  t = std::ifstream("test_meteor_image_65.png", std::ios::binary);
-  buf = std::stringstream();
-  buf << t.rdbuf();
-  CPPUNIT_ASSERT_EQUAL(buf.str(), png_img);
-
-  png_img = packeter.dump_gray_image(meteor::BLUE_APID);
-  t = std::ifstream("test_meteor_image_64.png", std::ios::binary);
-  buf = std::stringstream();
-  buf << t.rdbuf();
-  CPPUNIT_ASSERT_EQUAL(buf.str(), png_img);
+  // The fixtures were made with the original O(N^4) inverse DCT. Rounding
+  // of the fast one may differ by one.
+  boost::gil::rgb8_image_t image, expected_image;
+  read_png_string(packeter.dump_image(), image);
+  boost::gil::png_read_image("test_meteor_image.png", expected_image);
+  CPPUNIT_ASSERT(max_channel_difference(boost::gil::const_view(image),
+                                        boost::gil::const_view(
+                                            expected_image)) <= 1);
+
+  const int apids[] = { meteor::RED_APID, meteor::GREEN_APID,
+                        meteor::BLUE_APID };
+  for (int apid : apids) {
+    boost::gil::gray8_image_t gray, expected_gray;
+    read_png_string(packeter.dump_gray_image(apid), gray);
+    boost::gil::png_read_image(
+        "test_meteor_image_" + std::to_string(apid) + ".png", expected_gray);
+    CPPUNIT_ASSERT(max_channel_difference(boost::gil::const_view(gray),
+                                          boost::gil::const_view(
+                                              expected_gray)) <= 1);
+  }
+}
+
+void qa_meteor_decoder::test_parallel_decoding() {
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+                           (std::istreambuf_iterator<char>()));
+  uint8_t *raw = reinterpret_cast<uint8_t *>(buffer.data());
+
+  // Every call must return the same frame as the serial decoder, so that
+  // the packeter sees exactly the same input.
+  std::vector<bool> expected_ok;
+  std::vector<int> expected_pos;
+  std::vector<uint8_t> expected_data;
+  std::vector<uint8_t> ecced_data(meteor::HARD_FRAME_LEN);
+
+  meteor::decoder serial;
+  while (serial.pos() < buffer.size() - meteor::SOFT_FRAME_LEN) {
+    bool res = serial.decode_one_frame(raw, buffer.size(), ecced_data.data());
+    expected_ok.push_back(res);
+    expected_pos.push_back(serial.prev_pos());
+    if (res) {
+      expected_data.insert(expected_data.end(), ecced_data.begin(),
+                           ecced_data.end());
+    }
+  }
+
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    meteor::parallel_decoder parallel(threads);
+    std::vector<uint8_t> data;
+    int frame = 0;
+    while (parallel.pos() < buffer.size() - meteor::SOFT_FRAME_LEN) {
+      bool res =
+          parallel.decode_one_frame(raw, buffer.size(), ecced_data.data());
+      CPPUNIT_ASSERT(frame < expected_ok.size());
+      CPPUNIT_ASSERT_EQUAL(static_cast<bool>(expected_ok[frame]), res);
+      CPPUNIT_ASSERT_EQUAL(expected_pos[frame], parallel.prev_pos());
+      if (res) data.insert(data.end(), ecced_data.begin(), ecced_data.end());
+      frame++;
+    }
+
+    CPPUNIT_ASSERT_EQUAL(expected_ok.size(), static_cast<size_t>(frame));
+    CPPUNIT_ASSERT(expected_data == data);
+  }
+
+  // Stopping part way leaves speculative frames queued. The shutdown drops
+  // them and joins the workers, and the destructor copes with that.
+  meteor::parallel_decoder stopped(2);
+  for (int i = 0; i < 10; i++) {
+    stopped.decode_one_frame(raw, buffer.size(), ecced_data.data());
+  }
+  stopped.shutdown();
+}
+
+void qa_meteor_decoder::test_progressive_strips() {
+  meteor::decoder decoder;
+  meteor::packeter packeter;
+
+  // Strips of each APID, in order.
+  std::map<int, std::vector<uint8_t> > strips;
+  packeter.set_strip_callback(
+      [&strips](int apid, int line, const std::vector<uint8_t> &pixels) {
+        std::vector<uint8_t> &image = strips[apid];
+        const size_t width = 8 * meteor::MCU_PER_LINE;
+        CPPUNIT_ASSERT_EQUAL(width * line, image.size());
+        image.insert(image.end(), pixels.begin(), pixels.end());
+      });
+
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+                           (std::istreambuf_iterator<char>()));
+  uint8_t *raw = reinterpret_cast<uint8_t *>(buffer.data());
+  std::vector<uint8_t> ecced_data(meteor::HARD_FRAME_LEN);
+
+  while (decoder.pos() < buffer.size() - meteor::SOFT_FRAME_LEN) {
+    if (decoder.decode_one_frame(raw, buffer.size(), ecced_data.data())) {
+      packeter.parse_cvcdu(ecced_data.data(), meteor::HARD_FRAME_LEN - 4 - 128);
+    }
+  }
+  // Everything but the last row has been reported during decoding.
+  int streamed = strips[meteor::RED_APID].size();
+  packeter.flush_strips();
+  CPPUNIT_ASSERT_EQUAL(8 * 8 * meteor::MCU_PER_LINE,
+                       static_cast<int>(strips[meteor::RED_APID].size()) -
+                           streamed);
+
+  // The strips put together are the final image.
+  const int apids[] = { meteor::RED_APID, meteor::GREEN_APID,
+                        meteor::BLUE_APID };
+  for (int apid : apids) {
+    boost::gil::gray8_image_t gray;
+    read_png_string(packeter.dump_gray_image(apid), gray);
+    boost::gil::gray8_image_t::const_view_t v = boost::gil::const_view(gray);
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(v.width() * v.height()),
+                         strips[apid].size());
+    for (int y = 0; y < v.height(); y++) {
+      for (int x = 0; x < v.width(); x++) {
+        CPPUNIT_ASSERT_EQUAL(static_cast<int>(v(x, y)),
+                             static_cast<int>(strips[apid][y * v.width() + x]));
+      }
+    }
+  }
+
+  // Nothing is reported twice.
+  packeter.flush_strips();
+  CPPUNIT_ASSERT_EQUAL(streamed + 8 * 8 * meteor::MCU_PER_LINE,
+                       static_cast<int>(strips[meteor::RED_APID].size()));
+}
+
+void qa_meteor_decoder::test_png_options() {
+  boost::gil::rgb8_image_t rgb(97, 61);
+  boost::gil::gray8_image_t gray(97, 61);
+  for (int y = 0; y < 61; y++) {
+    for (int x = 0; x < 97; x++) {
+      boost::gil::view(rgb)(x, y) =
+          boost::gil::rgb8_pixel_t(x * 2, y * 4, (x * y) & 0xff);
+      boost::gil::view(gray)(x, y) = boost::gil::gray8_pixel_t(x ^ y);
+    }
+  }
+
+  png_options fastest;
+  fastest.compression_level = 0;
+  fastest.filters = PNG_FILTER_NONE;
+  png_options smallest;
+  smallest.compression_level = 9;
+  smallest.filters = PNG_ALL_FILTERS;
+
+  CPPUNIT_ASSERT(
+      store_rgb_to_png_string(boost::gil::view(rgb), smallest).size() <
+      store_rgb_to_png_string(boost::gil::view(rgb), fastest).size());
+
+  for (const png_options &options : {png_options(), fastest, smallest}) {
+    boost::gil::rgb8_image_t rgb_read;
+    read_png_string(store_rgb_to_png_string(boost::gil::view(rgb), options),
+                    rgb_read);
+    CPPUNIT_ASSERT_EQUAL(
+        max_channel_difference(boost::gil::const_view(rgb),
+                               boost::gil::const_view(rgb_read)),
+        0);
+
+    boost::gil::gray8_image_t gray_read;
+    read_png_string(store_gray_to_png_string(boost::gil::view(gray), options),
+                    gray_read);
+    CPPUNIT_ASSERT_EQUAL(
+        max_channel_difference(boost::gil::const_view(gray),
+                               boost::gil::const_view(gray_read)),
+        0);
+  }
+}
+
+void qa_meteor_decoder::test_shared_tables() {
+  // A sink builds one decoder and one packeter per flowgraph start. The
+  // Huffman tables are built once per process and shared, so a packeter
+  // created while another one is in use decodes the same image with the
+  // same tables.
+  const meteor::huffman_tables &tables = meteor::huffman_tables::get();
+
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+                           (std::istreambuf_iterator<char>()));
+  std::vector<uint8_t> data;
+  meteor::decoder decoder;
+  CPPUNIT_ASSERT_EQUAL(58, decode_all(decoder, buffer, data));
+
+  meteor::packeter first;
+  std::unique_ptr<meteor::packeter> second;
+  for (size_t f = 0; f < data.size(); f += meteor::HARD_FRAME_LEN) {
+    first.parse_cvcdu(&data[f], meteor::HARD_FRAME_LEN - 4 - 128);
+    if (!second) second.reset(new meteor::packeter());
+  }
+  for (size_t f = 0; f < data.size(); f += meteor::HARD_FRAME_LEN) {
+    second->parse_cvcdu(&data[f], meteor::HARD_FRAME_LEN - 4 - 128);
+  }
+
+  CPPUNIT_ASSERT(&tables == &meteor::huffman_tables::get());
+  CPPUNIT_ASSERT(!first.dump_image().empty());
+  CPPUNIT_ASSERT(first.dump_image() == second->dump_image());
+}
+
+void qa_meteor_decoder::test_image_store() {
+  const int width = 8 * meteor::MCU_PER_LINE;
+  meteor::image_store store(width, 3);
+  CPPUNIT_ASSERT_EQUAL(0, store.lines());
+
+  store.grow(8);
+  CPPUNIT_ASSERT_EQUAL(8, store.lines());
+  uint8_t *first = store.row(1, 0);
+  first[width - 1] = 42;
+  // A row of MCUs is contiguous within a plane.
+  CPPUNIT_ASSERT(store.row(1, 7) == first + 7 * width);
+
+  // Growing past several chunks keeps existing lines where they are.
+  store.grow(5 * meteor::image_store::CHUNK_LINES + 8);
+  CPPUNIT_ASSERT_EQUAL(5 * meteor::image_store::CHUNK_LINES + 8,
+                       store.lines());
+  CPPUNIT_ASSERT(store.row(1, 0) == first);
+  CPPUNIT_ASSERT_EQUAL(42, static_cast<int>(first[width - 1]));
+  CPPUNIT_ASSERT_EQUAL(0, static_cast<int>(store.row(0, 0)[width - 1]));
+  CPPUNIT_ASSERT_EQUAL(0, static_cast<int>(store.row(2, store.lines() - 1)[0]));
+
+  // Never shrinks.
+  store.grow(16);
+  CPPUNIT_ASSERT_EQUAL(5 * meteor::image_store::CHUNK_LINES + 8,
+                       store.lines());
+}
+
+void qa_meteor_decoder::test_sync_candidates() {
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+                           (std::istreambuf_iterator<char>()));
+
+  // Uniform noise of +-90 on every soft symbol, from a fixed LCG so that
+  // the outcome does not depend on the platform, brings the recording down
+  // to an SNR where the best sync correlation is sometimes the wrong one.
+  uint32_t seed = 1;
+  for (auto &symbol : buffer) {
+    seed = seed * 1103515245 + 12345;
+    int noise = static_cast<int>((seed >> 16) % 181) - 90;
+    int value = static_cast<signed char>(symbol) + noise;
+    symbol = static_cast<char>(std::max(-127, std::min(127, value)));
+  }
+
+  std::vector<uint8_t> single_data;
+  meteor::decoder single;
+  int single_ok = decode_all(single, buffer, single_data);
+
+  std::vector<uint8_t> data;
+  meteor::decoder candidates;
+  candidates.set_sync_candidates(8);
+  int candidates_ok = decode_all(candidates, buffer, data);
+  CPPUNIT_ASSERT(candidates_ok > single_ok);
+
+  // Concurrent candidates pick the same frames, with or without speculation.
+  for (int speculate = 0; speculate < 2; speculate++) {
+    std::vector<uint8_t> parallel_data;
+    meteor::parallel_decoder parallel(4, speculate);
+    parallel.set_sync_candidates(8);
+    CPPUNIT_ASSERT_EQUAL(candidates_ok,
+                         decode_all(parallel, buffer, parallel_data));
+    CPPUNIT_ASSERT(data == parallel_data);
+  }
+
+  std::cout << "Sync candidates: " << candidates_ok << " good frames vs "
+            << single_ok << " with a single one" << std::endl;
+}
+
+void qa_meteor_decoder::test_erasure_decoding() {
+  meteor::image_store image(8 * meteor::MCU_PER_LINE, 3);
+  image.grow(64);
+  for (int p = 0; p < 3; p++) {
+    for (int y = 0; y < image.lines(); y++) {
+      for (int x = 0; x < image.width(); x++) {
+        image.row(p, y)[x] = x * 7 + y * 13 + p * 50 + (x * y) % 31;
+      }
+    }
+  }
+
+  // Close to where the Reed-Solomon decoder gives up on most frames.
+  meteor::generator_options options;
+  options.seconds = 30;
+  options.snr_db = 1.25;
+  meteor::generator generator(image, options);
+  std::vector<uint8_t> stream(generator.frames() * meteor::SOFT_FRAME_LEN);
+  std::vector<uint8_t> frames(generator.frames() * meteor::HARD_FRAME_LEN);
+  for (int f = 0; generator.next_frame(&stream[f * meteor::SOFT_FRAME_LEN],
+                                       &frames[f * meteor::HARD_FRAME_LEN]);
+       f++) {
+  }
+
+  std::map<bool, int> good_frames;
+  for (bool erasures : { false, true }) {
+    meteor::decoder decoder;
+    decoder.set_erasure_decoding(erasures);
+    std::vector<uint8_t> ecced_data(meteor::HARD_FRAME_LEN);
+    while (decoder.pos() < stream.size() - meteor::SOFT_FRAME_LEN) {
+      if (!decoder.decode_one_frame(stream.data(), stream.size(),
+                                    ecced_data.data()))
+        continue;
+      CPPUNIT_ASSERT_EQUAL(0, decoder.prev_pos() % meteor::SOFT_FRAME_LEN);
+      const uint8_t *sent =
+          &frames[decoder.prev_pos() / meteor::SOFT_FRAME_LEN *
+                  meteor::HARD_FRAME_LEN];
+      if (std::equal(sent + 4, sent + meteor::HARD_FRAME_LEN,
+                     ecced_data.begin())) {
+        good_frames[erasures]++;
+        continue;
+      }
+      // The only wrong frames allowed are inverted ones: the complement of a
+      // codeword is a codeword, so when noise garbles the sync word, which
+      // tells the decoder whether to invert, the Reed-Solomon code cannot
+      // catch a wrong choice.
+      for (int i = 0; i < meteor::HARD_FRAME_LEN - 4; i++) {
+        CPPUNIT_ASSERT_EQUAL(sent[4 + i] ^ 0xff,
+                             static_cast<int>(ecced_data[i]));
+      }
+    }
+    std::cout << "Erasure decoding " << (erasures ? "on" : "off") << ": "
+              << good_frames[erasures] << " of " << generator.frames()
+              << " frames" << std::endl;
+  }
+
+  CPPUNIT_ASSERT(good_frames[true] > good_frames[false] * 3 / 2);
 }
 
 } /* namespace starcoder */
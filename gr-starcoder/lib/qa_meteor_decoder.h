@@ -32,11 +32,25 @@ class qa_meteor_decoder : public CppUnit::TestCase {
   CPPUNIT_TEST_SUITE(qa_meteor_decoder);
   CPPUNIT_TEST(test_dump_empty);
   CPPUNIT_TEST(test_full_decoding);
+  CPPUNIT_TEST(test_parallel_decoding);
+  CPPUNIT_TEST(test_progressive_strips);
+  CPPUNIT_TEST(test_png_options);
+  CPPUNIT_TEST(test_shared_tables);
+  CPPUNIT_TEST(test_image_store);
+  CPPUNIT_TEST(test_sync_candidates);
+  CPPUNIT_TEST(test_erasure_decoding);
   CPPUNIT_TEST_SUITE_END();
 
  private:
   void test_dump_empty();
   void test_full_decoding();
+  void test_parallel_decoding();
+  void test_progressive_strips();
+  void test_png_options();
+  void test_shared_tables();
+  void test_image_store();
+  void test_sync_candidates();
+  void test_erasure_decoding();
 };
 
 } /* namespace starcoder */
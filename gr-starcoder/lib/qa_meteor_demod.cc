@@ -0,0 +1,176 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_meteor_demod.h"
+#include <cppunit/TestAssert.h>
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "meteor/meteor_decoder.h"
+#include "meteor/meteor_demod.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+// QPSK modulates the hard decisions of soft symbol pairs with RRC pulses at
+// samp_rate, with a carrier offset and complex gaussian noise at the given
+// Es/N0.
+std::vector<std::complex<float> > modulate(const std::vector<char> &soft,
+                                           double samp_rate, double offset,
+                                           double esn0_db) {
+  const int oversampling = 64;
+  const int span = 16;
+  std::vector<float> pulse = meteor::rrc_taps(
+      oversampling, meteor::LRPT_RRC_ALPHA, span);
+  int half = (pulse.size() - 1) / 2;
+
+  int symbols = soft.size() / 2;
+  double samples_per_symbol = samp_rate / meteor::LRPT_SYMBOL_RATE;
+  int len = symbols * samples_per_symbol;
+  std::vector<std::complex<float> > samples(len);
+
+  std::mt19937 rng(1);
+  // The pulse has unit gain at DC, so symbols of +-1 have unit energy.
+  double sigma = std::sqrt(samples_per_symbol / 2) *
+                 std::pow(10, -esn0_db / 20) / oversampling;
+  std::normal_distribution<float> noise(0, sigma);
+
+  for (int n = 0; n < len; n++) {
+    // Not aligned to the samples, in symbols.
+    double t = n / samples_per_symbol + 0.3;
+    std::complex<float> sample = 0;
+    for (int k = int(t) - span / 2; k <= int(t) + span / 2; k++) {
+      if (k < 0 || k >= symbols) continue;
+      int tap = std::lrint((t - k) * oversampling) + half;
+      if (tap < 0 || tap >= pulse.size()) continue;
+      sample += std::complex<float>(soft[2 * k] < 0 ? -1 : 1,
+                                    soft[2 * k + 1] < 0 ? -1 : 1) *
+                pulse[tap];
+    }
+    sample *= std::polar(1.0, 2 * M_PI * offset * n / samp_rate);
+    samples[n] = sample + std::complex<float>(noise(rng), noise(rng));
+  }
+  return samples;
+}
+
+}  // namespace
+
+void qa_meteor_demod::test_fir_kernels() {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> value(-1, 1);
+
+  const int len = 36;
+  const int outputs = 100000;
+  std::vector<float> samples(2 * (len + outputs)), taps(2 * len);
+  for (auto &s : samples) s = value(rng);
+  for (int k = 0; k < len; k++) taps[2 * k] = taps[2 * k + 1] = value(rng);
+
+  std::vector<std::complex<float> > expected(outputs);
+  meteor::fir_kernel kernel = meteor::select_fir_kernel(meteor::FIR_SCALAR);
+  for (int i = 0; i < outputs; i++) {
+    expected[i] = kernel(&samples[2 * i], taps.data(), len);
+  }
+
+  const meteor::fir_impl impls[] = { meteor::FIR_SCALAR, meteor::FIR_SSE,
+                                     meteor::FIR_AVX };
+  const char *names[] = { "Scalar", "SSE", "AVX" };
+  for (int k = 0; k < 3; k++) {
+    kernel = meteor::select_fir_kernel(impls[k]);
+    if (kernel == NULL) {
+      std::cout << names[k] << " not supported, skipping" << std::endl;
+      continue;
+    }
+
+    std::vector<std::complex<float> > out(outputs);
+    for (int i = 0; i < outputs; i++) {
+      out[i] = kernel(&samples[2 * i], taps.data(), len);
+    }
+
+    for (int i = 0; i < outputs; i++) {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i].real(), out[i].real(), 1e-5);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i].imag(), out[i].imag(), 1e-5);
+    }
+  }
+}
+
+void qa_meteor_demod::test_demodulate_stream() {
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> soft((std::istreambuf_iterator<char>(in)),
+                         (std::istreambuf_iterator<char>()));
+
+  // Remodulate the recording at a common receiver sample rate, with a
+  // Doppler sized carrier offset.
+  const double samp_rate = 140000;
+  const double offset = 1500;
+  std::vector<std::complex<float> > samples =
+      modulate(soft, samp_rate, offset, 10);
+
+  meteor::qpsk_demod demod(samp_rate);
+  std::vector<int8_t> symbols(soft.size() + 1024);
+  int produced = 0;
+  // In blocks, like a flowgraph would.
+  const int block = 4096;
+  for (int i = 0; i < samples.size(); i += block) {
+    int consumed;
+    produced += demod.work(&samples[i], std::min<int>(block, samples.size() - i),
+                           &symbols[produced], symbols.size() - produced,
+                           consumed);
+    CPPUNIT_ASSERT_EQUAL(std::min<int>(block, samples.size() - i), consumed);
+  }
+
+  CPPUNIT_ASSERT(demod.locked());
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(offset, demod.frequency_offset(), 20);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(samp_rate / meteor::LRPT_SYMBOL_RATE,
+                               demod.samples_per_symbol(), 0.01);
+  // One symbol more or less, depending on where the strobes start.
+  CPPUNIT_ASSERT(std::abs(produced - int(soft.size())) <= 2);
+
+  // All the good frames of the recording decode from the demodulated
+  // symbols too (58 of them).
+  std::vector<uint8_t> ecced_data(meteor::HARD_FRAME_LEN);
+  meteor::decoder reference;
+  const unsigned char *original =
+      reinterpret_cast<unsigned char *>(soft.data());
+  int expected = 0;
+  while (reference.pos() < int(soft.size()) - meteor::SOFT_FRAME_LEN) {
+    if (reference.decode_one_frame(original, soft.size(), ecced_data.data())) {
+      expected++;
+    }
+  }
+
+  meteor::decoder decoder;
+  const unsigned char *raw = reinterpret_cast<unsigned char *>(symbols.data());
+  int ok = 0;
+  while (decoder.pos() < produced - meteor::SOFT_FRAME_LEN) {
+    if (decoder.decode_one_frame(raw, produced, ecced_data.data())) ok++;
+  }
+  std::cout << "Demodulated stream: " << ok << " good frames" << std::endl;
+  CPPUNIT_ASSERT_EQUAL(58, expected);
+  CPPUNIT_ASSERT_EQUAL(expected, ok);
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
@@ -0,0 +1,170 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "qa_meteor_ecc.h"
+#include <cppunit/TestAssert.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "meteor/meteor_ecc.h"
+
+namespace gr {
+namespace starcoder {
+
+void qa_meteor_ecc::test_interleaved_matches_single() {
+  const int n = meteor::ECC_INTERLEAVE;
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> symbol(0, 254);
+
+  // Up to 16 errors per codeword can be corrected, more have to be reported
+  // the same way too. Every fourth frame is left clean, as most frames are.
+  for (int max_errors = 0; max_errors <= 20; max_errors++) {
+    for (int f = 0; f < 20; f++) {
+      std::vector<uint8_t> frame(255 * n);
+      std::array<uint8_t, 255> codeword;
+      for (int j = 0; j < n; j++) {
+        for (int i = 0; i < 223; i++) codeword[i] = byte(rng);
+        meteor::ecc_encode(codeword.data(), 0);
+        if (f % 4 != 0) {
+          int errors = std::uniform_int_distribution<int>(0, max_errors)(rng);
+          for (int e = 0; e < errors; e++) codeword[symbol(rng)] ^= byte(rng);
+        }
+        meteor::ecc_interleave(codeword.data(), frame.data(), j, n);
+      }
+
+      std::vector<uint8_t> expected(frame);
+      std::array<int, meteor::ECC_INTERLEAVE> expected_results;
+      for (int j = 0; j < n; j++) {
+        meteor::ecc_deinterleave(expected.data(), codeword.data(), j, n);
+        expected_results[j] = meteor::ecc_decode(codeword.data(), 0);
+        meteor::ecc_interleave(codeword.data(), expected.data(), j, n);
+      }
+      std::array<int, meteor::ECC_INTERLEAVE> results;
+      meteor::ecc_decode_interleaved(frame.data(), results);
+
+      CPPUNIT_ASSERT(expected == frame);
+      CPPUNIT_ASSERT(expected_results == results);
+    }
+  }
+}
+
+void qa_meteor_ecc::test_erasures() {
+  std::mt19937 rng(4321);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> nonzero(1, 255);
+
+  // Every split of the 32 parity symbols between erasures and errors, with
+  // some erased bytes left intact.
+  for (int erasures = 0; erasures <= 32; erasures++) {
+    const int errors = (32 - erasures) / 2;
+    for (int t = 0; t < 10; t++) {
+      std::array<uint8_t, 255> codeword;
+      for (int i = 0; i < 223; i++) codeword[i] = byte(rng);
+      meteor::ecc_encode(codeword.data(), 0);
+      std::array<uint8_t, 255> expected(codeword);
+
+      std::vector<int> positions(255);
+      for (int i = 0; i < 255; i++) positions[i] = i;
+      std::shuffle(positions.begin(), positions.end(), rng);
+      for (int i = 0; i < erasures + errors; i++) {
+        if (i >= erasures || t % 2 == 0) codeword[positions[i]] ^= nonzero(rng);
+      }
+
+      std::array<uint8_t, 255> plain(codeword);
+      int result = meteor::ecc_decode_erasures(codeword.data(), 0,
+                                               positions.data(), erasures);
+      CPPUNIT_ASSERT(result >= 0);
+      CPPUNIT_ASSERT(expected == codeword);
+      if (erasures == 32 && t % 2 == 0) {
+        CPPUNIT_ASSERT_EQUAL(-1, meteor::ecc_decode(plain.data(), 0));
+      }
+    }
+  }
+}
+
+void qa_meteor_ecc::test_interleaved_erasures() {
+  const int n = meteor::ECC_INTERLEAVE;
+  const int len = 255 * n;
+  std::mt19937 rng(99);
+  std::uniform_int_distribution<int> byte(0, 255);
+  int recovered = 0, frames = 0;
+
+  for (int f = 0; f < 50; f++) {
+    std::vector<uint8_t> frame(len);
+    std::array<uint8_t, 255> codeword;
+    for (int j = 0; j < n; j++) {
+      for (int i = 0; i < 223; i++) codeword[i] = byte(rng);
+      meteor::ecc_encode(codeword.data(), 0);
+      meteor::ecc_interleave(codeword.data(), frame.data(), j, n);
+    }
+    const std::vector<uint8_t> expected(frame);
+
+    // Bursts of 6 to 10 bytes, as the Viterbi decoder makes at low SNR, put
+    // 17 to 22 errors in the last codeword and fewer in the others.
+    // Reliability is low over the bursts and noisy elsewhere.
+    std::vector<int16_t> reliability(len);
+    for (int d = 0; d < len; d++) reliability[d] = 500 + byte(rng) * 4;
+    int burst_errors = 0;
+    while (burst_errors < 17 + f % 6) {
+      int start = std::uniform_int_distribution<int>(0, len - 11)(rng);
+      int burst = std::uniform_int_distribution<int>(6, 10)(rng);
+      for (int d = start; d < start + burst; d++) {
+        if (frame[d] == expected[d]) {
+          frame[d] ^= 1 + byte(rng) % 255;
+          if (d % n == n - 1) burst_errors++;
+        }
+        reliability[d] = std::min<int>(reliability[d], byte(rng) * 4);
+      }
+    }
+
+    std::vector<uint8_t> plain(frame);
+    std::array<int, meteor::ECC_INTERLEAVE> plain_results, results;
+    meteor::ecc_decode_interleaved(plain.data(), plain_results);
+    CPPUNIT_ASSERT_EQUAL(-1, plain_results[n - 1]);
+
+    meteor::ecc_decode_interleaved(frame.data(), reliability.data(), results);
+    for (int j = 0; j < n; j++) {
+      // Codewords the plain decoder corrects come out the same.
+      if (plain_results[j] != -1) {
+        CPPUNIT_ASSERT_EQUAL(plain_results[j], results[j]);
+      }
+      std::array<uint8_t, 255> got, want;
+      meteor::ecc_deinterleave(frame.data(), got.data(), j, n);
+      meteor::ecc_deinterleave(expected.data(), want.data(), j, n);
+      if (results[j] != -1) {
+        CPPUNIT_ASSERT(got == want);
+      }
+    }
+    if (results[n - 1] != -1) recovered++;
+    frames++;
+  }
+
+  std::cout << "ECC erasures: recovered " << recovered << " of " << frames
+            << " codewords with 17 to 22 errors" << std::endl;
+  CPPUNIT_ASSERT(recovered > frames / 2);
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
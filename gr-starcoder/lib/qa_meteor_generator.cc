@@ -0,0 +1,189 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_meteor_generator.h"
+#include <cppunit/TestAssert.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+
+#include "gil_util.h"
+#include "meteor/meteor_decoder.h"
+#include "meteor/meteor_generator.h"
+#include "meteor/meteor_packet.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+// The planes of the decoder test fixture, as generator input.
+void load_test_image(meteor::image_store &image) {
+  const int apids[] = { meteor::RED_APID, meteor::GREEN_APID,
+                        meteor::BLUE_APID };
+  for (int p = 0; p < 3; p++) {
+    boost::gil::gray8_image_t gray;
+    boost::gil::png_read_image(
+        "test_meteor_image_" + std::to_string(apids[p]) + ".png", gray);
+    boost::gil::gray8_image_t::const_view_t v = boost::gil::const_view(gray);
+    CPPUNIT_ASSERT_EQUAL(image.width(), static_cast<int>(v.width()));
+    image.grow(v.height() / 8 * 8);
+    for (int y = 0; y < image.lines(); y++) {
+      for (int x = 0; x < v.width(); x++) {
+        image.row(p, y)[x] = v(x, y);
+      }
+    }
+  }
+}
+
+// Generates the whole stream, also returning the frames before scrambling.
+std::vector<uint8_t> generate_all(meteor::generator &generator,
+                                  std::vector<uint8_t> &frames) {
+  std::vector<uint8_t> stream(generator.frames() * meteor::SOFT_FRAME_LEN);
+  frames.resize(generator.frames() * meteor::HARD_FRAME_LEN);
+  for (int f = 0; f < generator.frames(); f++) {
+    CPPUNIT_ASSERT(generator.next_frame(&stream[f * meteor::SOFT_FRAME_LEN],
+                                        &frames[f * meteor::HARD_FRAME_LEN]));
+  }
+  CPPUNIT_ASSERT(!generator.next_frame(stream.data()));
+  return stream;
+}
+
+// Decodes the stream, checking that every frame decodes to what was sent.
+// Returns the number of frames decoded.
+int decode_and_check(const std::vector<uint8_t> &stream,
+                     const std::vector<uint8_t> &frames,
+                     meteor::packeter &packeter) {
+  meteor::decoder decoder;
+  std::vector<uint8_t> ecced_data(meteor::HARD_FRAME_LEN);
+  int ok = 0;
+  while (decoder.pos() < stream.size() - meteor::SOFT_FRAME_LEN) {
+    CPPUNIT_ASSERT(
+        decoder.decode_one_frame(stream.data(), stream.size(),
+                                 ecced_data.data()));
+    CPPUNIT_ASSERT_EQUAL(0, decoder.prev_pos() % meteor::SOFT_FRAME_LEN);
+    const uint8_t *sent = &frames[decoder.prev_pos() / meteor::SOFT_FRAME_LEN *
+                                  meteor::HARD_FRAME_LEN];
+    CPPUNIT_ASSERT(std::equal(sent + 4, sent + meteor::HARD_FRAME_LEN,
+                              ecced_data.begin()));
+    packeter.parse_cvcdu(ecced_data.data(), meteor::HARD_FRAME_LEN - 4 - 128);
+    ok++;
+  }
+  return ok;
+}
+
+}  // namespace
+
+void qa_meteor_generator::test_round_trip() {
+  meteor::image_store image(8 * meteor::MCU_PER_LINE, 3);
+  load_test_image(image);
+
+  meteor::generator_options options;
+  options.seconds = 10;
+  meteor::generator generator(image, options);
+  CPPUNIT_ASSERT_EQUAL(88, generator.frames());
+
+  std::vector<uint8_t> frames;
+  std::vector<uint8_t> stream = generate_all(generator, frames);
+
+  // The image repeats, so each strip is compared with the lines it came
+  // from. The last row of MCUs is cut short by the end of the stream.
+  std::map<int, double> error_sum;
+  std::map<int, int> error_count;
+  const int apids[] = { meteor::RED_APID, meteor::GREEN_APID,
+                        meteor::BLUE_APID };
+  meteor::packeter packeter;
+  packeter.set_strip_callback([&](int apid, int line,
+                                  const std::vector<uint8_t> &pixels) {
+    const int p = std::find(apids, apids + 3, apid) - apids;
+    for (size_t i = 0; i < pixels.size(); i++) {
+      const int y = (line + i / image.width()) % image.lines();
+      error_sum[apid] +=
+          std::abs(pixels[i] - image.row(p, y)[i % image.width()]);
+      error_count[apid]++;
+    }
+  });
+  CPPUNIT_ASSERT_EQUAL(generator.frames() - 1,
+                       decode_and_check(stream, frames, packeter));
+
+  for (int apid : apids) {
+    // At least two passes over the image.
+    CPPUNIT_ASSERT(error_count[apid] >= 2 * image.lines() * image.width());
+    // JPEG losses at quality 80.
+    CPPUNIT_ASSERT(error_sum[apid] / error_count[apid] < 4);
+  }
+}
+
+void qa_meteor_generator::test_noise_and_rotation() {
+  meteor::image_store image(8 * meteor::MCU_PER_LINE, 3);
+  load_test_image(image);
+
+  // The decoder's sync search resolves these phase ambiguities.
+  const std::pair<int, bool> ambiguities[] = {
+    { 2, false }, { 0, true }, { 1, true }, { 2, true }, { 3, true }
+  };
+  for (const std::pair<int, bool> &ambiguity : ambiguities) {
+    meteor::generator_options options;
+    options.seconds = 3;
+    options.snr_db = 6;
+    options.rotation = ambiguity.first;
+    options.flip_iq = ambiguity.second;
+    meteor::generator generator(image, options);
+
+    std::vector<uint8_t> frames;
+    std::vector<uint8_t> stream = generate_all(generator, frames);
+    meteor::packeter packeter;
+    CPPUNIT_ASSERT_EQUAL(generator.frames() - 1,
+                         decode_and_check(stream, frames, packeter));
+  }
+}
+
+void qa_meteor_generator::test_reproducible() {
+  meteor::image_store image(8 * meteor::MCU_PER_LINE, 3);
+  load_test_image(image);
+
+  meteor::generator_options options;
+  options.seconds = 1;
+  options.snr_db = 10;
+  std::vector<uint8_t> frames;
+  meteor::generator first(image, options), second(image, options);
+  std::vector<uint8_t> stream = generate_all(first, frames);
+  CPPUNIT_ASSERT(stream == generate_all(second, frames));
+
+  options.seed++;
+  meteor::generator reseeded(image, options);
+  CPPUNIT_ASSERT(stream != generate_all(reseeded, frames));
+}
+
+void qa_meteor_generator::test_bad_image() {
+  meteor::image_store narrow(8 * meteor::MCU_PER_LINE - 8, 3);
+  narrow.grow(8);
+  CPPUNIT_ASSERT_THROW(meteor::generator generator(narrow),
+                       std::invalid_argument);
+
+  meteor::image_store empty(8 * meteor::MCU_PER_LINE, 3);
+  CPPUNIT_ASSERT_THROW(meteor::generator generator(empty),
+                       std::invalid_argument);
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
@@ -0,0 +1,49 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _QA_METEOR_GENERATOR_H_
+#define _QA_METEOR_GENERATOR_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+namespace starcoder {
+
+class qa_meteor_generator : public CppUnit::TestCase {
+ public:
+  CPPUNIT_TEST_SUITE(qa_meteor_generator);
+  CPPUNIT_TEST(test_round_trip);
+  CPPUNIT_TEST(test_noise_and_rotation);
+  CPPUNIT_TEST(test_reproducible);
+  CPPUNIT_TEST(test_bad_image);
+  CPPUNIT_TEST_SUITE_END();
+
+ private:
+  void test_round_trip();
+  void test_noise_and_rotation();
+  void test_reproducible();
+  void test_bad_image();
+};
+
+} /* namespace starcoder */
+} /* namespace gr */
+
+#endif /* _QA_METEOR_GENERATOR_H_ */
@@ -0,0 +1,79 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "qa_meteor_idct.h"
+#include <cppunit/TestAssert.h>
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "meteor/meteor_idct.h"
+
+namespace gr {
+namespace starcoder {
+
+void qa_meteor_idct::test_kernels_match_reference() {
+  std::mt19937 rng(42);
+  // Mostly small quantized coefficients, like in real images.
+  std::uniform_int_distribution<int> coefficient(-64, 64);
+  std::uniform_int_distribution<int> sparse(0, 3);
+
+  std::array<float, 64> scales;
+  meteor::idct_scales(scales);
+
+  const int blocks = 2000;
+  std::vector<float> in(64 * blocks), scaled(64 * blocks);
+  for (int i = 0; i < in.size(); i++) {
+    in[i] = sparse(rng) == 0 ? 8 * coefficient(rng) : 0;
+    scaled[i] = in[i] * scales[i % 64];
+  }
+
+  std::vector<float> expected(in.size());
+  for (int b = 0; b < blocks; b++) {
+    meteor::idct_8x8_reference(&in[64 * b], &expected[64 * b]);
+  }
+
+  std::vector<float> scalar(in.size());
+  meteor::idct_kernel kernel = meteor::select_idct_kernel(meteor::IDCT_SCALAR);
+  for (int b = 0; b < blocks; b++) kernel(&scaled[64 * b], &scalar[64 * b]);
+  for (int i = 0; i < in.size(); i++) {
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i], scalar[i], 1e-2);
+  }
+
+  const meteor::idct_impl impls[] = { meteor::IDCT_SCALAR, meteor::IDCT_SSE,
+                                      meteor::IDCT_AVX };
+  const char *names[] = { "Scalar", "SSE", "AVX" };
+  for (int k = 0; k < 3; k++) {
+    kernel = meteor::select_idct_kernel(impls[k]);
+    if (kernel == NULL) {
+      std::cout << names[k] << " not supported, skipping" << std::endl;
+      continue;
+    }
+
+    std::vector<float> out(in.size());
+    for (int b = 0; b < blocks; b++) kernel(&scaled[64 * b], &out[64 * b]);
+    CPPUNIT_ASSERT(scalar == out);
+  }
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
@@ -0,0 +1,158 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_meteor_viterbi.h"
+#include <cppunit/TestAssert.h>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "meteor/meteor_decoder.h"
+#include "meteor/meteor_viterbi.h"
+
+namespace gr {
+namespace starcoder {
+
+void qa_meteor_viterbi::test_acs_kernels_match_scalar() {
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+                           (std::istreambuf_iterator<char>()));
+  CPPUNIT_ASSERT(buffer.size() > meteor::SOFT_FRAME_LEN);
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(buffer.data());
+
+  // Decode windows at arbitrary offsets too, so that noisy (unsynchronized)
+  // input and metric ties are covered and not only clean frames.
+  std::vector<int> offsets;
+  for (int off = 0; off + meteor::SOFT_FRAME_LEN <= buffer.size();
+       off += meteor::SOFT_FRAME_LEN / 4) {
+    offsets.push_back(off);
+  }
+
+  std::vector<uint8_t> expected(meteor::HARD_FRAME_LEN * offsets.size());
+  meteor::viterbi scalar(meteor::ACS_SCALAR);
+  for (int i = 0; i < offsets.size(); i++) {
+    scalar.vit_conv_decode(raw + offsets[i],
+                           expected.data() + i * meteor::HARD_FRAME_LEN);
+  }
+
+  const meteor::acs_impl impls[] = { meteor::ACS_SSE2, meteor::ACS_AVX2 };
+  const char *names[] = { "SSE2", "AVX2" };
+  for (int k = 0; k < 2; k++) {
+    if (meteor::select_acs_kernel(impls[k]) == NULL) {
+      std::cout << names[k] << " not supported, skipping" << std::endl;
+      continue;
+    }
+
+    meteor::viterbi simd(impls[k]);
+    std::vector<uint8_t> decoded(expected.size());
+    for (int i = 0; i < offsets.size(); i++) {
+      simd.vit_conv_decode(raw + offsets[i],
+                           decoded.data() + i * meteor::HARD_FRAME_LEN);
+    }
+    CPPUNIT_ASSERT(expected == decoded);
+  }
+}
+
+void qa_meteor_viterbi::test_interleaved_decoders() {
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+                           (std::istreambuf_iterator<char>()));
+  CPPUNIT_ASSERT(buffer.size() > meteor::SOFT_FRAME_LEN);
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(buffer.data());
+
+  std::vector<int> offsets;
+  for (int off = 0; off + meteor::SOFT_FRAME_LEN <= buffer.size();
+       off += meteor::SOFT_FRAME_LEN / 4) {
+    offsets.push_back(off);
+  }
+
+  // The decoder state, decisions included, should stay small enough for
+  // several decoders (one per worker thread) to share the caches.
+  CPPUNIT_ASSERT(sizeof(meteor::viterbi) <= 4096);
+
+  std::vector<uint8_t> expected(meteor::HARD_FRAME_LEN * offsets.size());
+  meteor::viterbi single;
+  for (int i = 0; i < offsets.size(); i++) {
+    single.vit_conv_decode(raw + offsets[i],
+                           expected.data() + i * meteor::HARD_FRAME_LEN);
+  }
+
+  // Switching decoders on every frame touches all of their state in turn.
+  const int decoders = 8;
+  std::vector<std::unique_ptr<meteor::viterbi> > interleaved;
+  for (int k = 0; k < decoders; k++) {
+    interleaved.emplace_back(new meteor::viterbi());
+  }
+  std::vector<uint8_t> decoded(expected.size());
+  for (int i = 0; i < offsets.size(); i++) {
+    interleaved[i % decoders]->vit_conv_decode(
+        raw + offsets[i], decoded.data() + i * meteor::HARD_FRAME_LEN);
+  }
+
+  CPPUNIT_ASSERT(expected == decoded);
+}
+
+void qa_meteor_viterbi::test_ber() {
+  std::ifstream in("test_meteor_stream.s", std::ios::binary);
+  std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+                           (std::istreambuf_iterator<char>()));
+  CPPUNIT_ASSERT(buffer.size() > 4 * meteor::SOFT_FRAME_LEN);
+  // The first frames of the recording are noise, the ones after the second
+  // frame decode cleanly.
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(buffer.data()) +
+                       2 * meteor::SOFT_FRAME_LEN;
+
+  meteor::correlator correlator(0xfca2b63db00d9794);
+  uint32_t word, pos, corr;
+  std::tie(word, pos, corr) =
+      correlator.corr_correlate(raw, meteor::SOFT_FRAME_LEN);
+  std::vector<uint8_t> frame(raw + pos, raw + pos + meteor::SOFT_FRAME_LEN);
+  correlator.fix_packet(frame.data(), frame.size(), word);
+
+  meteor::viterbi viterbi;
+  std::vector<uint8_t> decoded(meteor::HARD_FRAME_LEN);
+  viterbi.vit_decode(frame.data(), decoded.data());
+  int errors = viterbi.ber();
+  // A decoder that is not locked disagrees with about half of the channel
+  // bits, a clean frame only with a few.
+  CPPUNIT_ASSERT(errors > 0);
+  CPPUNIT_ASSERT(errors < 2 * meteor::FRAME_BITS / 100);
+
+  // Flipping a few strong symbols away from the frame start does not change
+  // the decision, so each one adds exactly one channel error.
+  int flipped = 0;
+  for (int i = 1000; i < frame.size() && flipped < 20; i += 397) {
+    int8_t symbol = static_cast<int8_t>(frame[i]);
+    if (symbol > 64 || symbol < -64) {
+      frame[i] = static_cast<uint8_t>(-symbol);
+      flipped++;
+    }
+  }
+  std::vector<uint8_t> redecoded(meteor::HARD_FRAME_LEN);
+  viterbi.vit_decode(frame.data(), redecoded.data());
+  CPPUNIT_ASSERT(decoded == redecoded);
+  CPPUNIT_ASSERT_EQUAL(errors + flipped, viterbi.ber());
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
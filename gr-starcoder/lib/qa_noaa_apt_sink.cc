@@ -0,0 +1,211 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_noaa_apt_sink.h"
+#include <cppunit/TestAssert.h>
+
+#include <starcoder/noaa_apt_sink.h>
+#include <string_queue.h>
+#include <string>
+#include <vector>
+
+#include "gil_util.h"
+#include "starcoder.pb.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+// A scratch directory removed with the object.
+class temp_dir {
+ public:
+  temp_dir()
+      : path_(boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path()) {
+    boost::filesystem::create_directory(path_);
+  }
+  ~temp_dir() { boost::filesystem::remove_all(path_); }
+
+  std::string file(const std::string &name) const {
+    return (path_ / name).native();
+  }
+
+ private:
+  boost::filesystem::path path_;
+};
+
+const ::starcoder::BlockMessage &dict_value(const ::starcoder::Dict &dict,
+                                            const std::string &key) {
+  for (const ::starcoder::Dict_Entry &entry : dict.entry()) {
+    if (entry.key().symbol_value() == key) return entry.value();
+  }
+  CPPUNIT_FAIL("Missing key " + key);
+  return dict.entry(0).value();
+}
+
+// Sink input: the first two samples set the dynamic range to [-1, 2], after
+// which sample n is the middle of the range of gray level pixel(n).
+const int SINK_WIDTH = 20;
+const int SINK_HEIGHT = 7;
+
+int pixel(int n) {
+  if (n < 2) return n == 0 ? 255 : 0;
+  return n * 7 % 251;
+}
+
+float sample(int n) {
+  if (n < 2) return n == 0 ? 2.0 : -1.0;
+  return (pixel(n) + 0.5f) * 3 / 255 - 1;
+}
+
+// Pixel x of line y of frame, black past the samples received.
+int frame_pixel(int frame, int y, int x, int samples) {
+  int n = (frame * SINK_HEIGHT + y) * SINK_WIDTH + x;
+  return n < samples ? pixel(n) : 0;
+}
+
+}  // namespace
+
+void qa_noaa_apt_sink::test_png_row_writer() {
+  temp_dir dir;
+
+  // A short gray frame is completed with black lines.
+  const int width = 13, height = 8, written = 5;
+  {
+    png_row_writer writer(dir.file("gray.png"), width, height, 1);
+    std::vector<uint8_t> row(width);
+    for (int y = 0; y < written; y++) {
+      for (int x = 0; x < width; x++) row[x] = x * 16 + y + 1;
+      writer.write_row(row.data());
+    }
+    CPPUNIT_ASSERT_EQUAL(written, writer.rows_written());
+    writer.finish();
+    CPPUNIT_ASSERT_EQUAL(height, writer.rows_written());
+  }
+  boost::gil::gray8_image_t gray;
+  boost::gil::png_read_image(dir.file("gray.png"), gray);
+  CPPUNIT_ASSERT_EQUAL(width, static_cast<int>(gray.width()));
+  CPPUNIT_ASSERT_EQUAL(height, static_cast<int>(gray.height()));
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      CPPUNIT_ASSERT_EQUAL(y < written ? x * 16 + y + 1 : 0,
+                           static_cast<int>(boost::gil::view(gray)(x, y)));
+    }
+  }
+
+  // Lines past the height are ignored, the destructor finishes the file.
+  {
+    png_row_writer writer(dir.file("rgb.png"), width, height, 3);
+    std::vector<uint8_t> row(width * 3);
+    for (int y = 0; y <= height; y++) {
+      for (int i = 0; i < width * 3; i++) row[i] = i * 5 + y;
+      writer.write_row(row.data());
+    }
+    CPPUNIT_ASSERT_EQUAL(height, writer.rows_written());
+  }
+  boost::gil::rgb8_image_t rgb;
+  boost::gil::png_read_image(dir.file("rgb.png"), rgb);
+  CPPUNIT_ASSERT_EQUAL(width, static_cast<int>(rgb.width()));
+  CPPUNIT_ASSERT_EQUAL(height, static_cast<int>(rgb.height()));
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        CPPUNIT_ASSERT_EQUAL((x * 3 + c) * 5 + y,
+                             static_cast<int>(boost::gil::view(rgb)(x, y)[c]));
+      }
+    }
+  }
+
+  CPPUNIT_ASSERT_THROW(png_row_writer(dir.file("missing/x.png"), 1, 1, 1),
+                       std::runtime_error);
+}
+
+void qa_noaa_apt_sink::test_streaming() {
+  temp_dir dir;
+  string_queue queue(100);
+  // Batches of 3 lines do not divide the 7 lines of a frame.
+  const int batch_lines = 3;
+  noaa_apt_sink::sptr sink =
+      noaa_apt_sink::make(dir.file("apt.png").c_str(), SINK_WIDTH,
+                          SINK_HEIGHT, false, false, true, batch_lines);
+  sink->register_starcoder_queue(queue.get_ptr());
+
+  // Two frames, 4 lines and 5 pixels of a third one, preceded by the
+  // history of the block, in odd sized pieces.
+  const int history = 39;
+  const int samples = (2 * SINK_HEIGHT + 4) * SINK_WIDTH + 5;
+  std::vector<float> in(history + samples, 0.0f);
+  for (int n = 0; n < samples; n++) in[history + n] = sample(n);
+  for (int i = 0; i < samples; i += 37) {
+    int n = std::min(37, samples - i);
+    gr_vector_const_void_star input_items(1, &in[i]);
+    gr_vector_void_star output_items;
+    CPPUNIT_ASSERT_EQUAL(n, sink->work(n, input_items, output_items));
+  }
+  sink->stop();
+
+  // Each frame is in its own file, the last one padded with black lines and
+  // the end of its partial line black too.
+  for (int frame = 0; frame < 3; frame++) {
+    boost::gil::gray8_image_t image;
+    boost::gil::png_read_image(
+        dir.file("apt_" + std::to_string(frame) + ".png"), image);
+    CPPUNIT_ASSERT_EQUAL(SINK_WIDTH, static_cast<int>(image.width()));
+    CPPUNIT_ASSERT_EQUAL(SINK_HEIGHT, static_cast<int>(image.height()));
+    for (int y = 0; y < SINK_HEIGHT; y++) {
+      for (int x = 0; x < SINK_WIDTH; x++) {
+        CPPUNIT_ASSERT_EQUAL(frame_pixel(frame, y, x, samples),
+                             static_cast<int>(boost::gil::view(image)(x, y)));
+      }
+    }
+  }
+  CPPUNIT_ASSERT(!boost::filesystem::exists(dir.file("apt_3.png")));
+
+  // Batches restart at the beginning of each frame, the one cut short by
+  // stop() ends with the partial line. Rows of the ring that held older
+  // lines come out black.
+  const int batches[][3] = { { 0, 0, 3 }, { 0, 3, 3 }, { 0, 6, 1 },
+                             { 1, 0, 3 }, { 1, 3, 3 }, { 1, 6, 1 },
+                             { 2, 0, 3 }, { 2, 3, 2 } };
+  for (const auto &batch : batches) {
+    ::starcoder::BlockMessage message;
+    CPPUNIT_ASSERT(message.ParseFromString(queue.pop()));
+    const ::starcoder::Dict &dict = message.dict_value();
+    CPPUNIT_ASSERT_EQUAL(int64_t(batch[0]),
+                         int64_t(dict_value(dict, "frame").integer_value()));
+    CPPUNIT_ASSERT_EQUAL(int64_t(batch[1]),
+                         int64_t(dict_value(dict, "line").integer_value()));
+    CPPUNIT_ASSERT_EQUAL(int64_t(SINK_WIDTH),
+                         int64_t(dict_value(dict, "width").integer_value()));
+    const std::string &pixels = dict_value(dict, "pixels").blob_value();
+    CPPUNIT_ASSERT_EQUAL(size_t(batch[2] * SINK_WIDTH), pixels.size());
+    for (int i = 0; i < pixels.size(); i++) {
+      CPPUNIT_ASSERT_EQUAL(
+          frame_pixel(batch[0], batch[1] + i / SINK_WIDTH, i % SINK_WIDTH,
+                      samples),
+          static_cast<int>(static_cast<uint8_t>(pixels[i])));
+    }
+  }
+  CPPUNIT_ASSERT_EQUAL(std::string(), queue.pop());
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
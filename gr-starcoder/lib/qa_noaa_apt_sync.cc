@@ -0,0 +1,159 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_noaa_apt_sync.h"
+#include <cppunit/TestAssert.h>
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "noaa_apt_sync.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+const int LINE_WIDTH = 2080;
+
+// Sync A is a 1040 Hz square wave, sync B a 832 Hz pulse train, both at 2
+// samples per APT word. Written as 0 / 1 per sample, as in the sink.
+const char SYNC_A[] = "0000110011001100110011001100110000000000";
+const char SYNC_B[] = "0000111001110011100111001110011100111000";
+
+// Lines of APT video: sync A, random pixels, sync B at the middle of the
+// line, random pixels, with gaussian noise on top.
+std::vector<float> apt_lines(int lines, float noise_sigma) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> pixel(0.2, 0.8);
+  std::normal_distribution<float> noise(0, noise_sigma);
+
+  std::vector<float> samples(lines * LINE_WIDTH);
+  for (int y = 0; y < lines; y++) {
+    float *line = &samples[y * LINE_WIDTH];
+    for (int x = 0; x < LINE_WIDTH; x++) line[x] = pixel(rng);
+    for (int i = 0; i < APT_SYNC_LENGTH; i++) {
+      line[i] = SYNC_A[i] == '1' ? 0.9 : 0.1;
+      line[LINE_WIDTH / 2 + i] = SYNC_B[i] == '1' ? 0.9 : 0.1;
+    }
+    for (int x = 0; x < LINE_WIDTH; x++) line[x] += noise(rng);
+  }
+  return samples;
+}
+
+// The moving average the sink removes before matching, updated with each
+// sample like noaa_apt_sink_impl::work() does.
+std::vector<float> averages(const std::vector<float> &samples) {
+  const float alpha = 0.25;
+  std::vector<float> result(samples.size());
+  float average = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    average = alpha * samples[i] + (1.0 - alpha) * average;
+    result[i] = average;
+  }
+  return result;
+}
+
+}  // namespace
+
+void qa_noaa_apt_sync::test_kernels_match_reference() {
+  const int lines = 200;
+  std::vector<float> samples = apt_lines(lines, 0.1);
+  std::vector<float> average = averages(samples);
+  int positions = samples.size() - APT_SYNC_LENGTH + 1;
+
+  // Result for the window ending at each sample, as the sink queries it.
+  std::vector<noaa_apt_sync_marker> expected(positions);
+  for (int i = 0; i < positions; i++) {
+    expected[i] = apt_sync_reference(&samples[i],
+                                     average[i + APT_SYNC_LENGTH - 1]);
+  }
+
+  int found = 0;
+  for (int y = 0; y < lines; y++) {
+    if (expected[y * LINE_WIDTH + LINE_WIDTH / 2] ==
+        noaa_apt_sync_marker::SYNC_B) {
+      found++;
+    }
+  }
+  CPPUNIT_ASSERT(found > lines / 2);
+
+  const apt_sync_impl impls[] = { APT_SYNC_SCALAR, APT_SYNC_SSE,
+                                  APT_SYNC_AVX };
+  const char *names[] = { "Scalar", "SSE", "AVX" };
+  for (int k = 0; k < 3; k++) {
+    apt_sync_kernel kernel = select_apt_sync_kernel(impls[k]);
+    if (kernel == NULL) {
+      std::cout << names[k] << " not supported, skipping" << std::endl;
+      continue;
+    }
+
+    std::vector<noaa_apt_sync_marker> out(positions);
+    for (int i = 0; i < positions; i++) {
+      out[i] = kernel(&samples[i], average[i + APT_SYNC_LENGTH - 1]);
+    }
+    for (int i = 0; i < positions; i++) {
+      CPPUNIT_ASSERT(expected[i] == out[i]);
+    }
+  }
+}
+
+void qa_noaa_apt_sync::test_patterns() {
+  std::vector<apt_sync_kernel> kernels;
+  kernels.push_back(apt_sync_reference);
+  const apt_sync_impl impls[] = { APT_SYNC_SCALAR, APT_SYNC_SSE,
+                                  APT_SYNC_AVX };
+  for (apt_sync_impl impl : impls) {
+    if (select_apt_sync_kernel(impl) != NULL) {
+      kernels.push_back(select_apt_sync_kernel(impl));
+    }
+  }
+
+  float a[APT_SYNC_LENGTH], b[APT_SYNC_LENGTH], flat[APT_SYNC_LENGTH];
+  for (int i = 0; i < APT_SYNC_LENGTH; i++) {
+    a[i] = SYNC_A[i] == '1' ? 1 : -1;
+    b[i] = SYNC_B[i] == '1' ? 1 : -1;
+    flat[i] = 0.5;
+  }
+
+  for (apt_sync_kernel kernel : kernels) {
+    // The low samples are matched against pattern B for both patterns, so
+    // even a clean pattern A is not recognized as such.
+    CPPUNIT_ASSERT(kernel(a, 0) == noaa_apt_sync_marker::NONE);
+    CPPUNIT_ASSERT(kernel(b, 0) == noaa_apt_sync_marker::SYNC_B);
+    // Samples equal to the average match neither pattern.
+    CPPUNIT_ASSERT(kernel(flat, 0.5) == noaa_apt_sync_marker::NONE);
+    CPPUNIT_ASSERT(kernel(b, 2) == noaa_apt_sync_marker::NONE);
+  }
+
+  // Up to 4 samples equal to the average are tolerated.
+  for (int i = 0; i < 4; i++) b[10 * i + 5] = 0;
+  for (apt_sync_kernel kernel : kernels) {
+    CPPUNIT_ASSERT(kernel(b, 0) == noaa_apt_sync_marker::SYNC_B);
+  }
+  b[0] = 0;
+  for (apt_sync_kernel kernel : kernels) {
+    CPPUNIT_ASSERT(kernel(b, 0) == noaa_apt_sync_marker::NONE);
+  }
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
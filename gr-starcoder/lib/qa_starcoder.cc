@@ -34,12 +34,38 @@
 #include <chrono>
 #include <thread>
 #include "qa_enqueue_message_sink.h"
+#include "qa_meteor_bit_io.h"
+#include "qa_meteor_correlator.h"
 #include "qa_meteor_decoder.h"
+#include "qa_meteor_demod.h"
+#include "qa_meteor_ecc.h"
+#include "qa_meteor_generator.h"
+#include "qa_meteor_idct.h"
+#include "qa_meteor_viterbi.h"
+#include "qa_noaa_apt_sink.h"
+#include "qa_noaa_apt_sync.h"
+#include "qa_waterfall_renderer.h"
+#include "qa_waterfall_row_store.h"
+#include "qa_waterfall_fft.h"
+#include "qa_waterfall_zoom.h"
 
 CppUnit::TestSuite *qa_starcoder::suite() {
   CppUnit::TestSuite *s = new CppUnit::TestSuite("starcoder");
   s->addTest(gr::starcoder::qa_enqueue_message_sink::suite());
   s->addTest(gr::starcoder::qa_meteor_decoder::suite());
+  s->addTest(gr::starcoder::qa_meteor_viterbi::suite());
+  s->addTest(gr::starcoder::qa_meteor_correlator::suite());
+  s->addTest(gr::starcoder::qa_meteor_ecc::suite());
+  s->addTest(gr::starcoder::qa_meteor_idct::suite());
+  s->addTest(gr::starcoder::qa_meteor_bit_io::suite());
+  s->addTest(gr::starcoder::qa_meteor_demod::suite());
+  s->addTest(gr::starcoder::qa_meteor_generator::suite());
+  s->addTest(gr::starcoder::qa_noaa_apt_sink::suite());
+  s->addTest(gr::starcoder::qa_noaa_apt_sync::suite());
+  s->addTest(gr::starcoder::qa_waterfall_renderer::suite());
+  s->addTest(gr::starcoder::qa_waterfall_row_store::suite());
+  s->addTest(gr::starcoder::qa_waterfall_fft::suite());
+  s->addTest(gr::starcoder::qa_waterfall_zoom::suite());
 
   // The test below only works when the AR2300 is connected.
   //s->addTest(new CppUnit::TestCaller<qa_starcoder>(
@@ -0,0 +1,92 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_waterfall_fft.h"
+#include <cppunit/TestAssert.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "waterfall_fft.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+typedef std::complex<float> sample;
+
+std::vector<sample> make_rows(size_t fft_size, size_t rows) {
+  std::vector<sample> data(fft_size * rows);
+  uint32_t state = 1;
+  for (size_t i = 0; i < data.size(); i++) {
+    state = state * 1103515245 + 12345;
+    float re = (state >> 16 & 0xff) / 128.0f - 1.0f;
+    float im = (state >> 24) / 128.0f - 1.0f;
+    data[i] = sample(re, im);
+  }
+  return data;
+}
+
+void check_row(const sample *in, const sample *out, size_t fft_size) {
+  for (size_t k = 0; k < fft_size; k++) {
+    std::complex<double> sum = 0;
+    for (size_t t = 0; t < fft_size; t++) {
+      sum += std::complex<double>(in[t]) *
+             std::polar(1.0, -2 * M_PI * (k * t % fft_size) / fft_size);
+    }
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(sum.real(), out[k].real(), 1e-3);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(sum.imag(), out[k].imag(), 1e-3);
+  }
+}
+
+}  // namespace
+
+void qa_waterfall_fft::test_batches() {
+  const size_t fft_size = 64, batch = 4;
+  waterfall_fft fft(fft_size, batch);
+  CPPUNIT_ASSERT_EQUAL(batch, fft.batch());
+
+  // One spare row in front, so that the rows can also be read misaligned.
+  std::vector<sample> data = make_rows(fft_size, batch + 1);
+  for (size_t offset = 0; offset < 2; offset++) {
+    const sample *in = data.data() + offset;
+    for (size_t count = 1; count <= batch; count++) {
+      fft.execute(in, count);
+      for (size_t i = 0; i < count; i++) {
+        check_row(in + i * fft_size, fft.outbuf(i), fft_size);
+      }
+    }
+  }
+
+  for (size_t count = 1; count <= batch; count++) {
+    for (size_t i = 0; i < count; i++) {
+      memcpy(fft.inbuf(i), &data[i * fft_size], fft_size * sizeof(sample));
+    }
+    fft.execute(count);
+    for (size_t i = 0; i < count; i++) {
+      check_row(&data[i * fft_size], fft.outbuf(i), fft_size);
+    }
+  }
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
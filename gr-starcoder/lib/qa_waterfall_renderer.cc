@@ -0,0 +1,110 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_waterfall_renderer.h"
+#include <cppunit/TestAssert.h>
+
+#include <cmath>
+#include <vector>
+
+#include "waterfall_renderer.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+boost::gil::rgb8_image_t read_png_string(const std::string &png) {
+  boost::filesystem::path temp = boost::filesystem::temp_directory_path() /
+                                 boost::filesystem::unique_path();
+  {
+    std::ofstream out(temp.native(), std::ios::binary);
+    out << png;
+  }
+  boost::gil::rgb8_image_t image;
+  boost::gil::png_read_image(temp.native(), image);
+  boost::filesystem::remove(temp);
+  return image;
+}
+
+bool is_color(const boost::gil::rgb8_pixel_t &pixel, int r, int g, int b) {
+  return pixel[0] == r && pixel[1] == g && pixel[2] == b;
+}
+
+}  // namespace
+
+void qa_waterfall_renderer::test_row_order() {
+  // 150 rows at -100 dB then 50 at -20 dB: the colormap spans the mean, -80,
+  // to -20, so the first rows are black and the last ones light gray, the
+  // top color of nipy_spectral.
+  const int fft_size = 64;
+  const int rows = 200;
+  std::vector<int8_t> data(rows * fft_size, -100);
+  std::fill(data.begin() + 150 * fft_size, data.end(), -20);
+
+  boost::gil::rgb8_image_t image = read_png_string(render_waterfall_png(
+      [&data](int y) { return &data[y * fft_size]; }, rows, fft_size, 1e6,
+      100e6, 10));
+  boost::gil::rgb8_view_t view = boost::gil::view(image);
+  CPPUNIT_ASSERT(view.width() >= 1024);
+  CPPUNIT_ASSERT(view.height() > rows);
+
+  // In the columns of the plot, the last rows are on top, then the first
+  // ones and the bottom of the frame.
+  int plot_columns = 0;
+  for (int x = 0; x < view.width(); x++) {
+    int y = 0;
+    while (y < view.height() && !is_color(view(x, y), 204, 204, 204)) y++;
+    int top = y;
+    while (y < view.height() && is_color(view(x, y), 204, 204, 204)) y++;
+    if (y - top != 50) continue;
+    int bottom = y;
+    while (y < view.height() && is_color(view(x, y), 0, 0, 0)) y++;
+    CPPUNIT_ASSERT_EQUAL(151, y - bottom);
+    plot_columns++;
+  }
+  // All but the grid line columns.
+  CPPUNIT_ASSERT(plot_columns >= 1024 - 9);
+}
+
+void qa_waterfall_renderer::test_long_pass() {
+  // 15 minutes at 10 rows per second
+  const int fft_size = 1024;
+  const int rows = 9000;
+  std::vector<int8_t> data(rows * fft_size);
+  for (int y = 0; y < rows; y++) {
+    for (int k = 0; k < fft_size; k++) {
+      double carrier = k - fft_size / 2 - 200 * std::sin(y / 2000.0);
+      data[y * fft_size + k] =
+          std::lrint(-90 + 5 * std::sin(k * 0.37 + y) +
+                     40 * std::exp(-carrier * carrier / 16));
+    }
+  }
+
+  std::string png = render_waterfall_png(
+      [&data](int y) { return &data[y * fft_size]; }, rows, fft_size, 1e6,
+      100e6, 10);
+
+  boost::gil::rgb8_image_t image = read_png_string(png);
+  CPPUNIT_ASSERT(boost::gil::view(image).height() > rows);
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
@@ -0,0 +1,45 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _QA_WATERFALL_RENDERER_H_
+#define _QA_WATERFALL_RENDERER_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+namespace starcoder {
+
+class qa_waterfall_renderer : public CppUnit::TestCase {
+ public:
+  CPPUNIT_TEST_SUITE(qa_waterfall_renderer);
+  CPPUNIT_TEST(test_row_order);
+  CPPUNIT_TEST(test_long_pass);
+  CPPUNIT_TEST_SUITE_END();
+
+ private:
+  void test_row_order();
+  void test_long_pass();
+};
+
+} /* namespace starcoder */
+} /* namespace gr */
+
+#endif /* _QA_WATERFALL_RENDERER_H_ */
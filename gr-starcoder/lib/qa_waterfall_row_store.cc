@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_waterfall_row_store.h"
+#include <cppunit/TestAssert.h>
+
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <vector>
+
+#include "waterfall_row_store.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+const size_t ROW_SIZE = 1024;
+
+// Appends rows in chunks of various sizes, row y filled with y & 0xff, and
+// returns the number of rows in the store.
+size_t fill(waterfall_row_store &store, size_t chunks) {
+  std::vector<int8_t> chunk;
+  size_t rows = store.rows();
+  for (size_t c = 0; c < chunks; c++) {
+    size_t count = c % 7 + 1;
+    chunk.resize(count * ROW_SIZE);
+    for (size_t y = 0; y < count; y++) {
+      memset(&chunk[y * ROW_SIZE], (rows + y) & 0xff, ROW_SIZE);
+    }
+    store.append(chunk.data(), count);
+    rows += count;
+  }
+  return rows;
+}
+
+void check_rows(waterfall_row_store &store, size_t rows) {
+  CPPUNIT_ASSERT_EQUAL(rows, store.rows());
+  const int8_t *data = store.data();
+  for (size_t y = 0; y < rows; y++) {
+    CPPUNIT_ASSERT_EQUAL(int8_t(y & 0xff), data[y * ROW_SIZE]);
+    CPPUNIT_ASSERT_EQUAL(int8_t(y & 0xff), data[y * ROW_SIZE + ROW_SIZE - 1]);
+  }
+}
+
+}  // namespace
+
+void qa_waterfall_row_store::test_in_memory() {
+  waterfall_row_store store(ROW_SIZE, 1 << 20,
+                            boost::filesystem::temp_directory_path().native());
+  CPPUNIT_ASSERT(store.data() == NULL);
+
+  size_t rows = fill(store, 100);
+  CPPUNIT_ASSERT(rows * ROW_SIZE <= 1 << 20);
+  CPPUNIT_ASSERT(!store.spilled());
+  check_rows(store, rows);
+
+  store.clear();
+  CPPUNIT_ASSERT_EQUAL(size_t(0), store.rows());
+  CPPUNIT_ASSERT(store.data() == NULL);
+}
+
+void qa_waterfall_row_store::test_spill() {
+  waterfall_row_store store(ROW_SIZE, 1 << 20,
+                            boost::filesystem::temp_directory_path().native());
+
+  // A few rows past the limit, then more rows after reading them back.
+  size_t rows = fill(store, 300);
+  CPPUNIT_ASSERT(store.spilled());
+  check_rows(store, rows);
+
+  rows = fill(store, 20000);
+  check_rows(store, rows);
+
+  store.clear();
+  CPPUNIT_ASSERT(!store.spilled());
+  rows = fill(store, 10);
+  check_rows(store, rows);
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
@@ -0,0 +1,112 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "qa_waterfall_zoom.h"
+#include <cppunit/TestAssert.h>
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "waterfall_zoom.h"
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+typedef std::complex<float> sample;
+
+const double SAMP_RATE = 1e6;
+
+std::vector<sample> tone(double freq, size_t n, size_t start = 0) {
+  std::vector<sample> samples(n);
+  for (size_t i = 0; i < n; i++) {
+    samples[i] = std::polar(1.0, 2 * M_PI * freq * (start + i) / SAMP_RATE);
+  }
+  return samples;
+}
+
+// Mean power of the output, past the filter's start up transient.
+double power(const std::vector<sample> &out, size_t skip) {
+  double sum = 0.0;
+  for (size_t i = skip; i < out.size(); i++) {
+    sum += std::norm(out[i]);
+  }
+  return sum / (out.size() - skip);
+}
+
+}  // namespace
+
+void qa_waterfall_zoom::test_band() {
+  CPPUNIT_ASSERT_THROW(waterfall_zoom(SAMP_RATE, 0, 0), std::invalid_argument);
+  CPPUNIT_ASSERT_THROW(waterfall_zoom(SAMP_RATE, 2 * SAMP_RATE, 0),
+                       std::invalid_argument);
+
+  // In band tones come out at unity gain, up to the band edges. Out of band
+  // tones are rejected, including those just past the output Nyquist
+  // frequency, which would alias into the edges of the band.
+  const double offset = 200e3, span = 20e3;
+  const double freqs[] = {offset,         offset + 5e3,   offset - 5e3,
+                          offset + 10e3,  offset - 10e3,  offset + 21e3,
+                          offset - 21e3,  offset + 30e3,  offset - 60e3,
+                          0.0};
+  const bool in_band[] = {true,  true,  true,  true,  true,
+                          false, false, false, false, false};
+  for (size_t f = 0; f < 10; f++) {
+    waterfall_zoom zoom(SAMP_RATE, span, offset);
+    CPPUNIT_ASSERT_EQUAL(size_t(25), zoom.decimation());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(40e3, zoom.output_rate(), 1e-6);
+
+    std::vector<sample> in = tone(freqs[f], 100000), out;
+    // In odd sized pieces, to exercise the carried over history.
+    for (size_t i = 0; i < in.size(); i += 997) {
+      zoom.process(&in[i], std::min<size_t>(997, in.size() - i), out);
+    }
+    CPPUNIT_ASSERT_EQUAL(in.size() / zoom.decimation(), out.size());
+    double db = 10 * log10(power(out, zoom.taps() / zoom.decimation()));
+    if (in_band[f]) {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, db, 0.1);
+    } else {
+      CPPUNIT_ASSERT(db < -60.0);
+    }
+  }
+}
+
+void qa_waterfall_zoom::test_retune() {
+  // Following a tone that moves by 1 kHz halfway through.
+  waterfall_zoom zoom(SAMP_RATE, 10e3, 100e3);
+  std::vector<sample> first = tone(100e3, 50000), out;
+  zoom.process(first.data(), first.size(), out);
+  zoom.set_offset(101e3);
+  std::vector<sample> second = tone(101e3, 50000, 50000);
+  size_t retuned = out.size();
+  zoom.process(second.data(), second.size(), out);
+
+  // Once the filter has settled again, the output is back at DC.
+  size_t settled = retuned + zoom.taps() / zoom.decimation();
+  for (size_t i = settled + 1; i < out.size(); i++) {
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, std::abs(out[i]), 1e-2);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, std::arg(out[i] / out[i - 1]), 1e-3);
+  }
+}
+
+} /* namespace starcoder */
+} /* namespace gr */
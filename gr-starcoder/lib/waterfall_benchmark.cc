@@ -0,0 +1,209 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// Throughput of the waterfall processing stages on synthetic input, kept out
+// of the QA suite so that it only runs when asked for. Compare the numbers
+// before and after a change on the same machine.
+//
+// Usage: waterfall_benchmark
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <volk/volk.h>
+
+#include "waterfall_fft.h"
+#include "waterfall_renderer.h"
+#include "waterfall_row_store.h"
+#include "waterfall_zoom.h"
+
+namespace starcoder = gr::starcoder;
+
+namespace {
+
+typedef std::complex<float> sample;
+
+// Uniform noise in [-1, 1) on both components, the same on every run.
+std::vector<sample> make_rows(size_t fft_size, size_t rows) {
+  std::vector<sample> data(fft_size * rows);
+  uint32_t state = 1;
+  for (size_t i = 0; i < data.size(); i++) {
+    state = state * 1103515245 + 12345;
+    float re = (state >> 16 & 0xff) / 128.0f - 1.0f;
+    float im = (state >> 24) / 128.0f - 1.0f;
+    data[i] = sample(re, im);
+  }
+  return data;
+}
+
+// Runs f once, returns the rate at which it went through samples, in
+// Msamples/s.
+template <typename F>
+double rate(size_t samples, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> time =
+      std::chrono::steady_clock::now() - start;
+  return samples / time.count() / 1e6;
+}
+
+// Row by row against batched FFTs.
+void benchmark_fft() {
+  const size_t sizes[] = {256, 1024, 4096, 16384, 65536};
+  const size_t samples = 1 << 22;
+  for (size_t fft_size : sizes) {
+    size_t rows = samples / fft_size;
+    std::vector<sample> data = make_rows(fft_size, rows);
+
+    // The previous per row execution: copy into the plan's buffer, one FFT.
+    starcoder::waterfall_fft single(fft_size, 1);
+    double single_rate = rate(samples, [&]() {
+      for (size_t i = 0; i < rows; i++) {
+        memcpy(single.inbuf(), &data[i * fft_size], fft_size * sizeof(sample));
+        single.execute(1);
+      }
+    });
+
+    starcoder::waterfall_fft batched(fft_size,
+                                     std::max<size_t>(1, 16384 / fft_size));
+    double batched_rate = rate(samples, [&]() {
+      for (size_t i = 0; i < rows; i += batched.batch()) {
+        size_t count = std::min(rows - i, batched.batch());
+        batched.execute(&data[i * fft_size], count);
+      }
+    });
+
+    std::cout << "FFT size " << fft_size << ": row by row " << single_rate
+              << " Msamples/s, batched " << batched_rate << " Msamples/s"
+              << std::endl;
+  }
+}
+
+// Mixing, filtering and decimation of a 1 Msample/s stream zoomed to
+// narrower and narrower spans.
+void benchmark_zoom() {
+  const double samp_rate = 1e6;
+  const double spans[] = {200e3, 50e3, 10e3};
+  std::vector<sample> in = make_rows(8192, 256), out;
+  for (double span : spans) {
+    starcoder::waterfall_zoom zoom(samp_rate, span, 100e3);
+    out.clear();
+    double zoom_rate = rate(in.size(), [&]() {
+      for (size_t i = 0; i < in.size(); i += 8192) {
+        zoom.process(&in[i], 8192, out);
+      }
+    });
+    std::cout << "Zoom to " << span / 1e3 << " kHz (" << zoom.taps()
+              << " taps, decimation " << zoom.decimation()
+              << "): " << zoom_rate << " Msamples/s" << std::endl;
+  }
+}
+
+// The dB conversion of the max hold and mean rows: the exact log10f the block
+// uses against VOLK's log2 kernel, which is an approximation. It only runs
+// once per row, on fft_size bins, so its cost is also given for a typical
+// 10 rows/s waterfall of 1024 bins.
+void benchmark_db() {
+  const size_t n = 1 << 22;
+  std::vector<float> power(n), db(n);
+  uint32_t state = 1;
+  for (size_t i = 0; i < n; i++) {
+    state = state * 1103515245 + 12345;
+    power[i] = std::pow(10.0f, -12.0f + 6.0f * (state >> 8) / 16777216.0f);
+  }
+
+  double exact_rate = rate(n, [&]() {
+    for (size_t i = 0; i < n; i++) {
+      db[i] = 10.0 * log10f(power[i] + 1.0e-20);
+    }
+  });
+  double volk_rate = rate(n, [&]() {
+    volk_32f_log2_32f(db.data(), power.data(), n);
+    volk_32f_s32f_multiply_32f(db.data(), db.data(), 10.0 * log10(2.0), n);
+  });
+  std::cout << "dB conversion: log10f " << exact_rate
+            << " Msamples/s, VOLK log2 " << volk_rate << " Msamples/s, "
+            << 100.0 * 10 * 1024 / (exact_rate * 1e6)
+            << "% of a core at 10 rows/s of 1024 bins" << std::endl;
+}
+
+// Appending 1024 byte rows to a store that spills to its mapped file after
+// the first MiB, as the plotter does during a long pass.
+void benchmark_row_store() {
+  const size_t row_size = 1024;
+  const size_t rows = 7 * 15000;
+  std::vector<int8_t> chunk(7 * row_size, 42);
+  starcoder::waterfall_row_store store(
+      row_size, 1 << 20, boost::filesystem::temp_directory_path().native());
+  double store_rate = rate(rows * row_size, [&]() {
+    for (size_t y = 0; y < rows; y += 7) {
+      store.append(chunk.data(), 7);
+    }
+  });
+  std::cout << "Row store, spilling: " << store_rate << " MB/s" << std::endl;
+}
+
+// Rendering the PNG of a 15 minute pass at 10 rows/s, with a drifting
+// carrier over a noise floor.
+void benchmark_render() {
+  const int fft_size = 1024;
+  const int rows = 9000;
+  std::vector<int8_t> data(rows * fft_size);
+  for (int y = 0; y < rows; y++) {
+    for (int k = 0; k < fft_size; k++) {
+      double carrier = k - fft_size / 2 - 200 * std::sin(y / 2000.0);
+      data[y * fft_size + k] =
+          std::lrint(-90 + 5 * std::sin(k * 0.37 + y) +
+                     40 * std::exp(-carrier * carrier / 16));
+    }
+  }
+
+  std::string png;
+  double render_rate = rate(data.size(), [&]() {
+    png = starcoder::render_waterfall_png(
+        [&data](int y) { return &data[y * fft_size]; }, rows, fft_size, 1e6,
+        100e6, 10);
+  });
+  std::cout << "Render " << rows << " x " << fft_size << " waterfall: "
+            << data.size() / render_rate / 1e6 << " s, " << png.size()
+            << " bytes" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 1) {
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    return 2;
+  }
+  benchmark_fft();
+  benchmark_zoom();
+  benchmark_db();
+  benchmark_row_store();
+  benchmark_render();
+  return 0;
+}
@@ -0,0 +1,131 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "waterfall_fft.h"
+
+#include <gnuradio/fft/fft.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+// Rows are padded to a multiple of 64 bytes, enough for any FFTW SIMD flavor.
+const size_t ROW_ALIGNMENT = 64 / sizeof(fftwf_complex);
+
+}  // namespace
+
+waterfall_fft::waterfall_fft(size_t fft_size, size_t batch)
+    : fft_size_(fft_size),
+      batch_(std::max<size_t>(batch, 1)),
+      stride_((fft_size + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT),
+      in_(fftwf_alloc_complex(batch_ * stride_)),
+      out_(fftwf_alloc_complex(batch_ * stride_)),
+      batch_plan_(NULL),
+      row_plan_(NULL) {
+  if (!in_ || !out_) {
+    fftwf_free(in_);
+    fftwf_free(out_);
+    throw std::runtime_error("Could not allocate aligned memory");
+  }
+
+  // FFTW planning is not thread safe, and GNU Radio shares one planner.
+  boost::mutex::scoped_lock lock(fft::planner::mutex());
+  int n = fft_size_;
+  batch_plan_ = fftwf_plan_many_dft(1, &n, batch_, in_, NULL, 1, stride_,
+                                    out_, NULL, 1, stride_, FFTW_FORWARD,
+                                    FFTW_MEASURE);
+  row_plan_ = fftwf_plan_dft_1d(n, in_, out_, FFTW_FORWARD, FFTW_MEASURE);
+  if (!batch_plan_ || !row_plan_) {
+    if (batch_plan_) fftwf_destroy_plan(batch_plan_);
+    if (row_plan_) fftwf_destroy_plan(row_plan_);
+    fftwf_free(in_);
+    fftwf_free(out_);
+    throw std::runtime_error("Could not create the FFTW plans");
+  }
+  alignment_ = fftwf_alignment_of(reinterpret_cast<float *>(in_));
+}
+
+waterfall_fft::~waterfall_fft() {
+  {
+    boost::mutex::scoped_lock lock(fft::planner::mutex());
+    fftwf_destroy_plan(batch_plan_);
+    fftwf_destroy_plan(row_plan_);
+  }
+  fftwf_free(in_);
+  fftwf_free(out_);
+}
+
+std::complex<float> *waterfall_fft::inbuf(size_t i) {
+  return reinterpret_cast<std::complex<float> *>(in_ + i * stride_);
+}
+
+const std::complex<float> *waterfall_fft::outbuf(size_t i) const {
+  return reinterpret_cast<const std::complex<float> *>(out_ + i * stride_);
+}
+
+bool waterfall_fft::aligned(const fftwf_complex *p) const {
+  return fftwf_alignment_of(const_cast<float *>(
+             reinterpret_cast<const float *>(p))) == alignment_;
+}
+
+void waterfall_fft::execute(size_t count) {
+  if (count == batch_) {
+    fftwf_execute_dft(batch_plan_, in_, out_);
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    fftwf_execute_dft(row_plan_, in_ + i * stride_, out_ + i * stride_);
+  }
+}
+
+void waterfall_fft::execute(const std::complex<float> *in, size_t count) {
+  // Out of place complex plans preserve their input, so the const_cast is
+  // only there to satisfy the FFTW prototypes.
+  fftwf_complex *src =
+      reinterpret_cast<fftwf_complex *>(const_cast<std::complex<float> *>(in));
+  if (count == batch_ && stride_ == fft_size_ && aligned(src)) {
+    fftwf_execute_dft(batch_plan_, src, out_);
+    return;
+  }
+  if (count == batch_) {
+    for (size_t i = 0; i < count; i++) {
+      memcpy(in_ + i * stride_, src + i * fft_size_,
+             fft_size_ * sizeof(fftwf_complex));
+    }
+    execute(count);
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    fftwf_complex *row = src + i * fft_size_;
+    if (!aligned(row)) {
+      memcpy(in_ + i * stride_, row, fft_size_ * sizeof(fftwf_complex));
+      row = in_ + i * stride_;
+    }
+    fftwf_execute_dft(row_plan_, row, out_ + i * stride_);
+  }
+}
+
+}  // namespace starcoder
+}  // namespace gr
@@ -0,0 +1,73 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_STARCODER_WATERFALL_FFT_H
+#define INCLUDED_STARCODER_WATERFALL_FFT_H
+
+#include <fftw3.h>
+
+#include <complex>
+#include <cstddef>
+
+namespace gr {
+namespace starcoder {
+
+// Forward FFTs of fft_size points, up to batch of them per call. A full batch
+// runs through a single FFTW plan_many plan, shorter runs through a one row
+// plan. Input rows can be read straight from the caller's buffer, which FFTW
+// leaves untouched for out of place complex transforms, and are only copied
+// when their alignment does not match the plans'.
+class waterfall_fft {
+ public:
+  // Throws std::runtime_error if the buffers or plans cannot be created.
+  waterfall_fft(size_t fft_size, size_t batch);
+  ~waterfall_fft();
+
+  size_t fft_size() const { return fft_size_; }
+  size_t batch() const { return batch_; }
+
+  // Row i of the input and output buffers, i < batch().
+  std::complex<float> *inbuf(size_t i = 0);
+  const std::complex<float> *outbuf(size_t i = 0) const;
+
+  // Transforms the first count rows of inbuf() into outbuf().
+  void execute(size_t count);
+  // Transforms count contiguous rows starting at in into outbuf().
+  void execute(const std::complex<float> *in, size_t count);
+
+ private:
+  waterfall_fft(const waterfall_fft &) = delete;
+  waterfall_fft &operator=(const waterfall_fft &) = delete;
+
+  bool aligned(const fftwf_complex *p) const;
+
+  size_t fft_size_, batch_;
+  // Distance between the rows of the internal buffers, padded so that every
+  // row has the alignment the plans were made for.
+  size_t stride_;
+  fftwf_complex *in_, *out_;
+  fftwf_plan batch_plan_, row_plan_;
+  int alignment_;
+};
+
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_STARCODER_WATERFALL_FFT_H */
@@ -41,17 +41,36 @@
 #include "config.h"
 #endif
 
+#include <boost/bind.hpp>
 #include <gnuradio/io_signature.h>
 #include "waterfall_heatmap_impl.h"
 
 namespace gr {
 namespace starcoder {
 
+namespace {
+
+/* Samples transformed per batched FFT call */
+const size_t FFT_BATCH_SAMPLES = 16384;
+
+size_t fft_batch(size_t fft_size, int mode, bool overlap) {
+  if (mode == 0) {
+    /* Decimation only transforms one vector per row */
+    return 1;
+  }
+  return std::max<size_t>(overlap ? 2 : 1, FFT_BATCH_SAMPLES / fft_size);
+}
+
+}  // namespace
+
 waterfall_heatmap::sptr waterfall_heatmap::make(double samp_rate,
                                                 double center_freq, double rps,
-                                                size_t fft_size, int mode) {
+                                                size_t fft_size, int mode,
+                                                bool overlap, int window,
+                                                double span, double offset) {
   return gnuradio::get_initial_sptr(
-      new waterfall_heatmap_impl(samp_rate, center_freq, rps, fft_size, mode));
+      new waterfall_heatmap_impl(samp_rate, center_freq, rps, fft_size, mode,
+                                 overlap, window, span, offset));
 }
 
 /*
@@ -59,7 +78,9 @@ waterfall_heatmap::sptr waterfall_heatmap::make(double samp_rate,
  */
 waterfall_heatmap_impl::waterfall_heatmap_impl(double samp_rate,
                                                double center_freq, double rps,
-                                               size_t fft_size, int mode)
+                                               size_t fft_size, int mode,
+                                               bool overlap, int window,
+                                               double span, double offset)
     : gr::block("waterfall_heatmap",
                 gr::io_signature::make(1, 1, fft_size * sizeof(gr_complex)),
                 gr::io_signature::make(1, 1, fft_size * sizeof(int8_t))),
@@ -69,11 +90,17 @@ waterfall_heatmap_impl::waterfall_heatmap_impl(double samp_rate,
       d_rps(rps),
       fft_size_(fft_size),
       d_mode((wf_mode_t) mode),
+      d_overlap(overlap),
       d_refresh((d_samp_rate / fft_size) / rps),
       d_fft_cnt(0),
       d_fft_shift((size_t)(ceil(fft_size / 2.0))),
       d_samples_cnt(0),
-      d_fft(fft_size) {
+      d_fft(fft_size, fft_batch(fft_size, mode, overlap)),
+      d_have_tail(false),
+      d_avg_cnt(0),
+      d_offset(offset),
+      d_doppler(0.0),
+      d_offset_changed(false) {
   float r = 0.0;
   const int alignment_multiple =
       volk_get_alignment() / (fft_size * sizeof(gr_complex));
@@ -111,6 +138,37 @@ waterfall_heatmap_impl::waterfall_heatmap_impl(double samp_rate,
     d_min_buffer[i] = d_min_energy;
     d_max_buffer[i] = d_max_energy;
   }
+
+  d_window =
+      (float *)volk_malloc(fft_size * sizeof(float), volk_get_alignment());
+  d_overlap_buffer = (gr_complex *)volk_malloc(fft_size * sizeof(gr_complex),
+                                               volk_get_alignment());
+  if (!d_window || !d_overlap_buffer) {
+    throw std::runtime_error("Could not allocate aligned memory");
+  }
+
+  /*
+   * Normalize by the coherent gain of the window, so that a tone reads the
+   * same level in every mode regardless of the window in use
+   */
+  std::vector<float> taps =
+      fft::window::build((fft::window::win_type) window, fft_size, 6.76);
+  double sum = 0.0;
+  for (size_t i = 0; i < fft_size; i++) {
+    d_window[i] = taps[i];
+    sum += taps[i];
+  }
+  d_window_gain = sum * sum;
+
+  if (span != 0) {
+    d_zoom.reset(new waterfall_zoom(samp_rate, span, offset));
+    d_refresh = (d_zoom->output_rate() / fft_size) / rps;
+  }
+
+  message_port_register_in(pmt::mp("doppler"));
+  set_msg_handler(
+      pmt::mp("doppler"),
+      boost::bind(&waterfall_heatmap_impl::doppler_msg_handler, this, _1));
 }
 
 /*
@@ -122,6 +180,8 @@ waterfall_heatmap_impl::~waterfall_heatmap_impl() {
   volk_free(d_tmp_buffer);
   volk_free(d_min_buffer);
   volk_free(d_max_buffer);
+  volk_free(d_window);
+  volk_free(d_overlap_buffer);
 }
 
 int waterfall_heatmap_impl::general_work(int noutput_items,
@@ -134,40 +194,87 @@ int waterfall_heatmap_impl::general_work(int noutput_items,
 
   size_t n_fft = std::min(ninput_items[0], noutput_items);
 
+  /*
+   * In zoom mode, the FFT vectors are the decimated samples instead. There
+   * are at most as many complete ones as input vectors, so they always fit
+   * in the output.
+   */
+  const gr_complex *vectors = in;
+  size_t n_vectors = n_fft;
+  if (d_zoom) {
+    {
+      boost::mutex::scoped_lock lock(d_offset_mutex);
+      if (d_offset_changed) {
+        d_zoom->set_offset(d_offset - d_doppler);
+        d_offset_changed = false;
+      }
+    }
+    d_zoom->process(in, n_fft * fft_size_, d_zoom_samples);
+    vectors = d_zoom_samples.data();
+    n_vectors = d_zoom_samples.size() / fft_size_;
+  }
+
   switch (d_mode) {
     case WATERFALL_MODE_DECIMATION:
-      produced = compute_decimation(out, in, n_fft);
+      produced = compute_decimation(out, vectors, n_vectors);
       break;
     case WATERFALL_MODE_MAX_HOLD:
-      produced = compute_max_hold(out, in, n_fft);
+      produced = compute_max_hold(out, vectors, n_vectors);
+      break;
+    case WATERFALL_MODE_MEAN:
+      produced = compute_mean(out, vectors, n_vectors);
       break;
     default:
       throw std::runtime_error("Wrong waterfall mode");
       return -1;
   }
 
+  if (d_zoom) {
+    d_zoom_samples.erase(d_zoom_samples.begin(),
+                         d_zoom_samples.begin() + n_vectors * fft_size_);
+  }
+
   consume_each(n_fft);
   return produced;
 }
 
+void waterfall_heatmap_impl::set_offset(double offset) {
+  boost::mutex::scoped_lock lock(d_offset_mutex);
+  d_offset = offset;
+  d_offset_changed = true;
+}
+
+double waterfall_heatmap_impl::output_rate() const {
+  return d_zoom ? d_zoom->output_rate() : d_samp_rate;
+}
+
+void waterfall_heatmap_impl::doppler_msg_handler(pmt::pmt_t msg) {
+  /* A bare number, or a pair with the number in its cdr */
+  if (pmt::is_pair(msg)) {
+    msg = pmt::cdr(msg);
+  }
+  if (!pmt::is_number(msg)) {
+    GR_LOG_ERROR(d_logger, "Doppler shift message is not a number");
+    return;
+  }
+  boost::mutex::scoped_lock lock(d_offset_mutex);
+  d_doppler = pmt::to_double(msg);
+  d_offset_changed = true;
+}
+
 size_t waterfall_heatmap_impl::compute_decimation(int8_t *out,
                                                   const gr_complex *in,
                                                   size_t n_fft) {
   size_t i;
   size_t produced = 0;
-  float t;
-  gr_complex *fft_in;
   for (i = 0; i < n_fft; i++) {
     d_fft_cnt++;
     if (d_fft_cnt > d_refresh) {
-      fft_in = d_fft.get_inbuf();
-      memcpy(fft_in, in + i * fft_size_, fft_size_ * sizeof(gr_complex));
-      d_fft.execute();
+      d_fft.execute(in + i * fft_size_, 1);
 
       /* Compute the energy in dB */
       volk_32fc_s32f_x2_power_spectral_density_32f(
-          d_shift_buffer, d_fft.get_outbuf(), (float) fft_size_, 1.0,
-          fft_size_);
+          d_shift_buffer, d_fft.outbuf(), (float) fft_size_, 1.0, fft_size_);
       /* Perform FFT shift */
       memcpy(d_hold_buffer, d_shift_buffer + d_fft_shift,
              sizeof(float) * (fft_size_ - d_fft_shift));
@@ -193,55 +300,142 @@ size_t waterfall_heatmap_impl::compute_max_hold(int8_t *out,
                                                 const gr_complex *in,
                                                 size_t n_fft) {
   size_t i;
-  size_t produced = 0;
   size_t j;
-  float t;
-  gr_complex *fft_in;
-  for (i = 0; i < n_fft; i++) {
-    fft_in = d_fft.get_inbuf();
-    memcpy(fft_in, in + i * fft_size_, fft_size_ * sizeof(gr_complex));
-    d_fft.execute();
+  size_t count;
+  size_t produced = 0;
+  for (i = 0; i < n_fft; i += count) {
+    /* Transform as many vectors as possible at once, in place */
+    count = std::min(n_fft - i, d_fft.batch());
+    d_fft.execute(in + i * fft_size_, count);
 
-    /* Compute the mag^2 */
-    volk_32fc_magnitude_squared_32f(d_tmp_buffer, d_fft.get_outbuf(),
-                                    fft_size_);
+    for (j = 0; j < count; j++) {
+      /* Compute the mag^2 */
+      volk_32fc_magnitude_squared_32f(d_tmp_buffer, d_fft.outbuf(j),
+                                      fft_size_);
 
-    /* Normalization factor */
-    volk_32f_s32f_multiply_32f(d_tmp_buffer, d_tmp_buffer,
-                               1.0 / (fft_size_ * fft_size_), fft_size_);
+      /* Normalization factor */
+      volk_32f_s32f_multiply_32f(d_tmp_buffer, d_tmp_buffer,
+                                 1.0 / (fft_size_ * fft_size_), fft_size_);
 
-    /* Max hold */
-    volk_32f_x2_max_32f(d_hold_buffer, d_hold_buffer, d_tmp_buffer, fft_size_);
-    d_fft_cnt++;
-    if (d_fft_cnt > d_refresh) {
-      /* Perform FFT shift */
-      memcpy(d_shift_buffer, d_hold_buffer + d_fft_shift,
-             sizeof(float) * (fft_size_ - d_fft_shift));
-      memcpy(&d_shift_buffer[fft_size_ - d_fft_shift], d_hold_buffer,
-             sizeof(float) * d_fft_shift);
+      /* Max hold */
+      volk_32f_x2_max_32f(d_hold_buffer, d_hold_buffer, d_tmp_buffer,
+                          fft_size_);
+      d_fft_cnt++;
+      if (d_fft_cnt > d_refresh) {
+        /* Reset */
+        d_fft_cnt = 0;
+        emit_hold_row(out + produced * fft_size_);
+        produced++;
+      }
+      d_samples_cnt += fft_size_;
+    }
+  }
+  return produced;
+}
 
-      /* Compute the energy in dB */
-      for (j = 0; j < fft_size_; j++) {
-        d_hold_buffer[j] = 10.0 * log10f(d_shift_buffer[j] + 1.0e-20);
+size_t waterfall_heatmap_impl::compute_mean(int8_t *out, const gr_complex *in,
+                                            size_t n_fft) {
+  size_t i;
+  size_t j;
+  size_t count;
+  size_t rows;
+  size_t produced = 0;
+  const size_t half = fft_size_ / 2;
+  const size_t tail = fft_size_ - half;
+  const size_t chunk =
+      std::max<size_t>(1, d_fft.batch() / (d_overlap ? 2 : 1));
+  const gr_complex *vec;
+  const gr_complex *prev;
+  bool first_overlaps;
+  for (i = 0; i < n_fft; i += count) {
+    count = std::min(n_fft - i, chunk);
+
+    /*
+     * Window the vectors of this chunk into the FFT input, each preceded by
+     * the window straddling it and the previous vector when overlapping. The
+     * tail of the last vector survives across work() calls and rows in
+     * d_overlap_buffer.
+     */
+    first_overlaps = d_overlap && d_have_tail;
+    prev = first_overlaps ? d_overlap_buffer : NULL;
+    rows = 0;
+    for (j = 0; j < count; j++) {
+      vec = in + (i + j) * fft_size_;
+      if (prev) {
+        volk_32fc_32f_multiply_32fc(d_fft.inbuf(rows), prev, d_window, tail);
+        volk_32fc_32f_multiply_32fc(d_fft.inbuf(rows) + tail, vec,
+                                    d_window + tail, half);
+        rows++;
+      }
+      volk_32fc_32f_multiply_32fc(d_fft.inbuf(rows), vec, d_window,
+                                  fft_size_);
+      rows++;
+      if (d_overlap) {
+        prev = vec + half;
       }
+    }
+    if (d_overlap) {
+      memcpy(d_overlap_buffer, prev, tail * sizeof(gr_complex));
+      d_have_tail = true;
+    }
+    d_fft.execute(rows);
 
-      /* Clamp the energy to the [min, max] range */
-      volk_32f_x2_max_32f(d_hold_buffer, d_hold_buffer, d_min_buffer,
-                          fft_size_);
-      volk_32f_x2_min_32f(d_hold_buffer, d_hold_buffer, d_max_buffer,
-                          fft_size_);
+    rows = 0;
+    for (j = 0; j < count; j++) {
+      if (d_overlap && (j > 0 || first_overlaps)) {
+        accumulate_power(d_fft.outbuf(rows++));
+      }
+      accumulate_power(d_fft.outbuf(rows++));
 
-      /* Reset */
-      d_fft_cnt = 0;
-      volk_32f_s32f_convert_8i(out + produced * fft_size_, d_hold_buffer, 1.0,
-                               fft_size_);
-      produced++;
-      memset(d_hold_buffer, 0, fft_size_ * sizeof(float));
+      d_fft_cnt++;
+      if (d_fft_cnt > d_refresh) {
+        /* Normalization factor */
+        volk_32f_s32f_multiply_32f(d_hold_buffer, d_hold_buffer,
+                                   1.0 / (d_avg_cnt * d_window_gain),
+                                   fft_size_);
+        /* Reset */
+        d_fft_cnt = 0;
+        d_avg_cnt = 0;
+        emit_hold_row(out + produced * fft_size_);
+        produced++;
+      }
+      d_samples_cnt += fft_size_;
     }
-    d_samples_cnt += fft_size_;
   }
   return produced;
 }
 
+void waterfall_heatmap_impl::accumulate_power(const gr_complex *spectrum) {
+  /* Compute the mag^2 and add it to the running sum */
+  volk_32fc_magnitude_squared_32f(d_tmp_buffer, spectrum, fft_size_);
+  volk_32f_x2_add_32f(d_hold_buffer, d_hold_buffer, d_tmp_buffer, fft_size_);
+  d_avg_cnt++;
+}
+
+void waterfall_heatmap_impl::emit_hold_row(int8_t *out) {
+  size_t j;
+
+  /* Perform FFT shift */
+  memcpy(d_shift_buffer, d_hold_buffer + d_fft_shift,
+         sizeof(float) * (fft_size_ - d_fft_shift));
+  memcpy(&d_shift_buffer[fft_size_ - d_fft_shift], d_hold_buffer,
+         sizeof(float) * d_fft_shift);
+
+  /*
+   * Compute the energy in dB. Only done once per row, and the VOLK log
+   * kernels are approximations that move bins sitting on a whole dB.
+   */
+  for (j = 0; j < fft_size_; j++) {
+    d_hold_buffer[j] = 10.0 * log10f(d_shift_buffer[j] + 1.0e-20);
+  }
+
+  /* Clamp the energy to the [min, max] range */
+  volk_32f_x2_max_32f(d_hold_buffer, d_hold_buffer, d_min_buffer, fft_size_);
+  volk_32f_x2_min_32f(d_hold_buffer, d_hold_buffer, d_max_buffer, fft_size_);
+
+  volk_32f_s32f_convert_8i(out, d_hold_buffer, 1.0, fft_size_);
+  memset(d_hold_buffer, 0, fft_size_ * sizeof(float));
+}
+
 } /* namespace starcoder */
 } /* namespace gr */
@@ -42,7 +42,11 @@
 
 #include <starcoder/waterfall_heatmap.h>
 #include <volk/volk.h>
-#include <gnuradio/fft/fft.h>
+#include <boost/thread/mutex.hpp>
+#include <memory>
+#include <vector>
+#include "waterfall_fft.h"
+#include "waterfall_zoom.h"
 
 namespace gr {
 namespace starcoder {
@@ -58,6 +62,9 @@ class waterfall_heatmap_impl : public waterfall_heatmap {
     WATERFALL_MODE_MAX_HOLD =
         1,  //!< WATERFALL_MODE_MAX_HOLD compute the max hold energy of all the
             //FFT snapshots between two consecutive pixel rows
+    WATERFALL_MODE_MEAN = 2,  //!< WATERFALL_MODE_MEAN averages the energy of
+                              //all the (optionally overlapping) windowed FFT
+                              //snapshots between two consecutive pixel rows
   } wf_mode_t;
 
   const float d_min_energy;
@@ -66,26 +73,52 @@ class waterfall_heatmap_impl : public waterfall_heatmap {
   double d_rps;
   const size_t fft_size_;
   wf_mode_t d_mode;
+  const bool d_overlap;
   size_t d_refresh;
   size_t d_fft_cnt;
   size_t d_fft_shift;
   size_t d_samples_cnt;
-  fft::fft_complex d_fft;
+  waterfall_fft d_fft;
   float *d_shift_buffer;
   float *d_hold_buffer;
   float *d_tmp_buffer;
   float *d_min_buffer;
   float *d_max_buffer;
+  float *d_window;
+  float d_window_gain;
+  gr_complex *d_overlap_buffer;
+  bool d_have_tail;
+  size_t d_avg_cnt;
+  std::unique_ptr<waterfall_zoom> d_zoom;
+  std::vector<gr_complex> d_zoom_samples;
+  /* Set from other threads, applied to d_zoom at the next work() call */
+  boost::mutex d_offset_mutex;
+  double d_offset;
+  double d_doppler;
+  bool d_offset_changed;
 
   size_t compute_decimation(int8_t *out, const gr_complex *in, size_t n_fft);
 
   size_t compute_max_hold(int8_t *out, const gr_complex *in, size_t n_fft);
 
+  size_t compute_mean(int8_t *out, const gr_complex *in, size_t n_fft);
+
+  void accumulate_power(const gr_complex *spectrum);
+
+  void emit_hold_row(int8_t *out);
+
+  void doppler_msg_handler(pmt::pmt_t msg);
+
  public:
   waterfall_heatmap_impl(double samp_rate, double center_freq, double pps,
-                         size_t fft_size, int mode);
+                         size_t fft_size, int mode, bool overlap, int window,
+                         double span, double offset);
   ~waterfall_heatmap_impl();
 
+  void set_offset(double offset);
+
+  double output_rate() const;
+
   int general_work(int noutput_items, gr_vector_int &ninput_items,
                    gr_vector_const_void_star &input_items,
                    gr_vector_void_star &output_items);
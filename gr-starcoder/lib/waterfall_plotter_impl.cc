@@ -26,11 +26,17 @@
 
 #include <Python.h>
 #include <gnuradio/io_signature.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include "numpy/arrayobject.h"
 #include "waterfall_plotter_impl.h"
 
 #include "pmt_to_proto.h"
+#include "waterfall_renderer.h"
 
 namespace gr {
 namespace starcoder {
@@ -38,9 +44,13 @@ namespace starcoder {
 waterfall_plotter::sptr waterfall_plotter::make(double samp_rate,
                                                 double center_freq, int rps,
                                                 size_t fft_size,
-                                                char *filename) {
+                                                char *filename,
+                                                bool use_matplotlib,
+                                                int memory_limit_mb,
+                                                const std::string &spill_dir) {
   return gnuradio::get_initial_sptr(new waterfall_plotter_impl(
-      samp_rate, center_freq, rps, fft_size, filename));
+      samp_rate, center_freq, rps, fft_size, filename, use_matplotlib,
+      memory_limit_mb, spill_dir));
 }
 
 /*
@@ -48,16 +58,23 @@ waterfall_plotter::sptr waterfall_plotter::make(double samp_rate,
  */
 waterfall_plotter_impl::waterfall_plotter_impl(double samp_rate,
                                                double center_freq, int rps,
-                                               size_t fft_size, char *filename)
+                                               size_t fft_size, char *filename,
+                                               bool use_matplotlib,
+                                               int memory_limit_mb,
+                                               const std::string &spill_dir)
     : gr::sync_block("waterfall_plotter",
                      gr::io_signature::make(1, 1, fft_size * sizeof(int8_t)),
                      gr::io_signature::make(0, 0, 0)),
-      total_size_(0),
       samp_rate_(samp_rate),
       center_freq_(center_freq),
       rps_(rps),
       fft_size_(fft_size),
       filename_(filename),
+      use_matplotlib_(use_matplotlib),
+      rows_(fft_size, size_t(std::max(memory_limit_mb, 0)) << 20,
+            spill_dir.empty()
+                ? boost::filesystem::temp_directory_path().native()
+                : spill_dir),
       string_queue_(NULL) {}
 
 /*
@@ -68,18 +85,9 @@ waterfall_plotter_impl::~waterfall_plotter_impl() {}
 int waterfall_plotter_impl::work(int noutput_items,
                                  gr_vector_const_void_star &input_items,
                                  gr_vector_void_star &output_items) {
-  size_t block_size = input_signature()->sizeof_stream_item(0);
+  const int8_t *in = (const int8_t *)input_items[0];
 
-  const char *in = (const char *)input_items[0];
-
-  total_size_ += noutput_items * block_size;
-
-  item a;
-  char *buffer = new char[noutput_items * block_size];
-  memcpy(buffer, in, noutput_items * block_size);
-  a.size = noutput_items * block_size;
-  a.arr = buffer;
-  list_of_arrays_.push_back(a);
+  rows_.append(in, noutput_items);
 
   // Tell runtime system how many output items we produced.
   return noutput_items;
@@ -88,25 +96,60 @@ int waterfall_plotter_impl::work(int noutput_items,
 void waterfall_plotter_impl::init_numpy_array() { import_array(); }
 
 bool waterfall_plotter_impl::stop() {
-  if (list_of_arrays_.begin() == list_of_arrays_.end()) {
+  if (rows_.rows() == 0) {
     return true;
   }
 
-  char *numpy_array_buffer = new char[total_size_];
-  int copied_so_far = 0;
-  for (auto it = list_of_arrays_.cbegin(); it != list_of_arrays_.cend(); it++) {
-    std::copy((*it).arr, (*it).arr + (*it).size,
-              numpy_array_buffer + copied_so_far);
-    copied_so_far += (*it).size;
-    delete[](*it).arr;
+  std::string image;
+  if (use_matplotlib_) {
+    image = plot_with_matplotlib();
+  } else {
+    image = render_natively();
+    if (strlen(filename_) > 0) {
+      std::ofstream out(filename_, std::ios::binary);
+      out << image;
+    }
+  }
+
+  if (string_queue_ != NULL && !image.empty()) {
+    ::starcoder::BlockMessage grpc_pmt;
+    grpc_pmt.set_blob_value(image);
+    string_queue_->push(grpc_pmt.SerializeAsString());
   }
 
+  rows_.clear();
+  return true;
+}
+
+std::string waterfall_plotter_impl::render_natively() {
+  try {
+    const int8_t *data = rows_.data();
+    return render_waterfall_png(
+        [this, data](int y) { return data + y * fft_size_; }, rows_.rows(),
+        fft_size_, samp_rate_, center_freq_, rps_);
+  } catch (const std::runtime_error &e) {
+    std::cerr << "waterfall_plotter: " << e.what() << std::endl;
+    return std::string();
+  }
+}
+
+std::string waterfall_plotter_impl::plot_with_matplotlib() {
+  // The array wraps the stored rows without copying them. numpy only reads
+  // them.
+  const int8_t *data;
+  try {
+    data = rows_.data();
+  } catch (const std::runtime_error &e) {
+    std::cerr << "waterfall_plotter: " << e.what() << std::endl;
+    return std::string();
+  }
+
+  std::string image;
   PyGILState_STATE gstate;
   gstate = PyGILState_Ensure();
   init_numpy_array();
 
-  npy_intp dims[2] = { static_cast<long int>(total_size_ /
-                                             (fft_size_ * sizeof(int8_t))),
+  npy_intp dims[2] = { static_cast<long int>(rows_.rows()),
                        static_cast<long int>(fft_size_) };
   const int ND = 2;
 
@@ -116,7 +159,7 @@ bool waterfall_plotter_impl::stop() {
            *py_fft_size = NULL;
 
   numpy_array = PyArray_SimpleNewFromData(
-      ND, dims, NPY_INT8, reinterpret_cast<void *>(numpy_array_buffer));
+      ND, dims, NPY_INT8, const_cast<int8_t *>(data));
   if (numpy_array == NULL) goto error;
 
   module_string = PyString_FromString((char *)"starcoder");
@@ -150,15 +193,11 @@ bool waterfall_plotter_impl::stop() {
 
   if (result == NULL) goto error;
 
-  if (string_queue_ != NULL) {
+  {
     Py_ssize_t image_size = PyString_Size(result);
     char *image_buffer = PyString_AsString(result);
     if (image_buffer == NULL) goto error;
-
-    ::starcoder::BlockMessage grpc_pmt;
-    grpc_pmt.set_blob_value(image_buffer, image_size);
-
-    string_queue_->push(grpc_pmt.SerializeAsString());
+    image.assign(image_buffer, image_size);
   }
 
 error:
@@ -179,8 +218,7 @@ error:
   }
 
   PyGILState_Release(gstate);
-  delete[] numpy_array_buffer;
-  return true;
+  return image;
 }
 
 void waterfall_plotter_impl::register_starcoder_queue(uint64_t ptr) {
@@ -21,32 +21,36 @@
 #ifndef INCLUDED_STARCODER_WATERFALL_PLOTTER_IMPL_H
 #define INCLUDED_STARCODER_WATERFALL_PLOTTER_IMPL_H
 
-#include <list>
+#include <string>
 #include <starcoder/waterfall_plotter.h>
 #include <string_queue.h>
 
+#include "waterfall_row_store.h"
+
 namespace gr {
 namespace starcoder {
-struct item {
-  size_t size;
-  char *arr;
-};
 
 class waterfall_plotter_impl : public waterfall_plotter {
  private:
-  std::list<item> list_of_arrays_;
-  int total_size_;
   double samp_rate_;
   double center_freq_;
   int rps_;
   char *filename_;
   size_t fft_size_;
+  bool use_matplotlib_;
+  waterfall_row_store rows_;
   void init_numpy_array();
+  // Renders the rows with starcoder.plot_waterfall, returns an empty string
+  // on failure.
+  std::string plot_with_matplotlib();
+  // Renders the rows with render_waterfall_png(), likewise.
+  std::string render_natively();
   string_queue *string_queue_;
 
  public:
   waterfall_plotter_impl(double samp_rate, double center_freq, int rps,
-                         size_t fft_size, char *filename);
+                         size_t fft_size, char *filename, bool use_matplotlib,
+                         int memory_limit_mb, const std::string &spill_dir);
   ~waterfall_plotter_impl();
 
   // Where all the action really happens
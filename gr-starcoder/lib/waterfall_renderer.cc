@@ -0,0 +1,373 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "waterfall_renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+// 5x7 bitmap font covering the labels, most significant bit on the left.
+const int FONT_WIDTH = 5;
+const int FONT_HEIGHT = 7;
+const int FONT_SCALE = 2;
+const int CHAR_ADVANCE = (FONT_WIDTH + 1) * FONT_SCALE;
+const int TEXT_HEIGHT = FONT_HEIGHT * FONT_SCALE;
+
+struct glyph {
+  char c;
+  uint8_t rows[FONT_HEIGHT];
+};
+
+const glyph FONT[] = {
+  { '0', { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e } },
+  { '1', { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e } },
+  { '2', { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f } },
+  { '3', { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e } },
+  { '4', { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 } },
+  { '5', { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e } },
+  { '6', { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e } },
+  { '7', { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+  { '8', { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e } },
+  { '9', { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c } },
+  { '-', { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 } },
+  { '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c } },
+  { '(', { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 } },
+  { ')', { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 } },
+  { 'B', { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e } },
+  { 'F', { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 } },
+  { 'G', { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f } },
+  { 'H', { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 } },
+  { 'M', { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+  { 'P', { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 } },
+  { 'S', { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e } },
+  { 'T', { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+  { 'c', { 0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e } },
+  { 'd', { 0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f } },
+  { 'e', { 0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e } },
+  { 'i', { 0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e } },
+  { 'k', { 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 } },
+  { 'm', { 0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11 } },
+  { 'n', { 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 } },
+  { 'o', { 0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e } },
+  { 'q', { 0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01 } },
+  { 'r', { 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 } },
+  { 's', { 0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e } },
+  { 'u', { 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d } },
+  { 'w', { 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a } },
+  { 'y', { 0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e } },
+  { 'z', { 0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f } },
+};
+
+// Returns NULL for characters drawn as spaces.
+const uint8_t *glyph_rows(char c) {
+  for (const glyph &g : FONT) {
+    if (g.c == c) return g.rows;
+  }
+  return NULL;
+}
+
+int text_width(const std::string &text) {
+  return text.empty() ? 0 : text.size() * CHAR_ADVANCE - FONT_SCALE;
+}
+
+// Text with its top left corner at x, y.
+struct label {
+  std::string text;
+  int x, y;
+};
+
+// matplotlib's nipy_spectral colormap, sampled every 0.05.
+const float NIPY_SPECTRAL[21][3] = {
+  { 0.0, 0.0, 0.0 },          { 0.4667, 0.0, 0.5333 },
+  { 0.5333, 0.0, 0.6 },       { 0.0, 0.0, 0.6667 },
+  { 0.0, 0.0, 0.8667 },       { 0.0, 0.4667, 0.8667 },
+  { 0.0, 0.6, 0.8667 },       { 0.0, 0.6667, 0.6667 },
+  { 0.0, 0.6667, 0.5333 },    { 0.0, 0.6, 0.0 },
+  { 0.0, 0.7333, 0.0 },       { 0.0, 0.8667, 0.0 },
+  { 0.0, 1.0, 0.0 },          { 0.7333, 1.0, 0.0 },
+  { 0.9333, 0.9333, 0.0 },    { 1.0, 0.8, 0.0 },
+  { 1.0, 0.6, 0.0 },          { 1.0, 0.0, 0.0 },
+  { 0.8667, 0.0, 0.0 },       { 0.8, 0.0, 0.0 },
+  { 0.8, 0.8, 0.8 }
+};
+
+typedef std::array<uint8_t, 3> rgb;
+
+// Entry index of the 256 entry colormap, interpolated like matplotlib's
+// LinearSegmentedColormap does.
+rgb colormap(int index) {
+  float x = index / 255.0f * 20;
+  int segment = std::min(static_cast<int>(x), 19);
+  float t = x - segment;
+  rgb color;
+  for (int c = 0; c < 3; c++) {
+    float value = NIPY_SPECTRAL[segment][c] +
+                  t * (NIPY_SPECTRAL[segment + 1][c] -
+                       NIPY_SPECTRAL[segment][c]);
+    color[c] = static_cast<uint8_t>(std::lrint(value * 255));
+  }
+  return color;
+}
+
+// Frequency tick labels as in plot_waterfall.py, e.g. 437.5M, with the given
+// number of decimals.
+std::string frequency_label(double f, int decimals) {
+  const char suffixes[] = { 'G', 'M', 'k' };
+  const double scales[] = { 1e9, 1e6, 1e3 };
+  char text[32];
+  for (int i = 0; i < 3; i++) {
+    double r = f / scales[i];
+    if (std::fabs(r) > 1 || std::fabs(std::fabs(r) - 1) <= 1e-5 + 1e-3) {
+      std::snprintf(text, sizeof(text), "%.*f%c", decimals, r, suffixes[i]);
+      return text;
+    }
+  }
+  std::snprintf(text, sizeof(text), "%.*f", std::max(decimals - 1, 0), f);
+  return text;
+}
+
+// Labels for the frequencies, with the fewest decimals (at least one) that
+// tell them apart.
+std::vector<std::string> frequency_labels(const std::vector<double> &freqs) {
+  std::vector<std::string> labels;
+  for (int decimals = 1; decimals <= 6; decimals++) {
+    labels.clear();
+    for (double f : freqs) labels.push_back(frequency_label(f, decimals));
+    if (std::adjacent_find(labels.begin(), labels.end()) == labels.end()) {
+      break;
+    }
+  }
+  return labels;
+}
+
+const int PAD = 10;
+const int TICK = 6;
+// Narrow spectra are widened to about this many pixels.
+const int MIN_PLOT_WIDTH = 1024;
+const int COLORBAR_GAP = 30;
+const int COLORBAR_WIDTH = 24;
+
+// Darkens a pixel like the grid lines drawn with alpha 0.3.
+inline void darken(uint8_t *pixel) {
+  for (int c = 0; c < 3; c++) pixel[c] = pixel[c] * 7 / 10;
+}
+
+inline void set_black(uint8_t *pixel) { pixel[0] = pixel[1] = pixel[2] = 0; }
+
+}  // namespace
+
+std::string render_waterfall_png(const waterfall_row_source &row, int rows,
+                                 int fft_size, double samp_rate,
+                                 double center_freq, int rps,
+                                 const png_options &options) {
+  // Power range as in plot_waterfall.py: from the mean, truncated, to the
+  // maximum.
+  double sum = 0;
+  int vmax = -128;
+  for (int y = 0; y < rows; y++) {
+    const int8_t *r = row(y);
+    int64_t row_sum = 0;
+    for (int k = 0; k < fft_size; k++) {
+      row_sum += r[k];
+      vmax = std::max(vmax, static_cast<int>(r[k]));
+    }
+    sum += row_sum;
+  }
+  int vmin = rows > 0 ? static_cast<int>(sum / (double(rows) * fft_size)) : 0;
+  if (rows == 0) vmax = 0;
+
+  // Color of each power value, indexed by its bits as uint8_t.
+  std::array<rgb, 256> lut;
+  for (int v = -128; v < 128; v++) {
+    double norm = vmax > vmin ? double(v - vmin) / (vmax - vmin) : 0;
+    int index = std::max(0, std::min(255, int(std::floor(norm * 256))));
+    lut[static_cast<uint8_t>(v)] = colormap(index);
+  }
+
+  const int scale = std::max(1, MIN_PLOT_WIDTH / fft_size);
+  const int plot_width = fft_size * scale;
+  const int rows_per_tick = 60 * rps;
+
+  // Time ticks every minute, and the widest of their labels.
+  std::vector<label> labels;
+  std::vector<int> y_ticks;
+  int y_label_width = 0;
+  for (int i = 0; rows_per_tick > 0 && i < rows; i += rows_per_tick) {
+    y_ticks.push_back(i);
+    labels.push_back({ std::to_string(i / rows_per_tick * 60), 0, 0 });
+    y_label_width = std::max(y_label_width, text_width(labels.back().text));
+  }
+
+  const int top = 2 * PAD + TEXT_HEIGHT + TEXT_HEIGHT / 2;
+  const int left = PAD + y_label_width + TICK + 4;
+  const int bottom_y = top + rows;
+  for (size_t n = 0; n < y_ticks.size(); n++) {
+    labels[n].x = left - 1 - TICK - 4 - text_width(labels[n].text);
+    labels[n].y = bottom_y - 1 - y_ticks[n] - TEXT_HEIGHT / 2;
+  }
+  labels.push_back({ "Time (s)", PAD, PAD });
+
+  // Frequency ticks every tenth of the sample rate around the center.
+  std::vector<int> x_ticks;
+  std::vector<double> x_freqs;
+  std::vector<int> x_steps;
+  int bins_per_tick = samp_rate > 0 ? int(samp_rate / 10 * fft_size /
+                                          samp_rate) : 0;
+  for (int k = -4; k <= 4; k++) {
+    int bin = fft_size / 2 + k * bins_per_tick;
+    if (bin < 0 || bin >= fft_size || (k != 0 && bins_per_tick == 0)) {
+      continue;
+    }
+    x_ticks.push_back(left + bin * scale + scale / 2);
+    x_freqs.push_back(center_freq + k * samp_rate / 10);
+    x_steps.push_back(k);
+  }
+  std::vector<std::string> x_labels = frequency_labels(x_freqs);
+  // Only label every other tick, or less, when the labels would touch.
+  int x_label_width = 0;
+  for (const std::string &text : x_labels) {
+    x_label_width = std::max(x_label_width, text_width(text));
+  }
+  int stride = 1;
+  while (stride < 8 &&
+         x_label_width + CHAR_ADVANCE > stride * bins_per_tick * scale) {
+    stride *= 2;
+  }
+  for (size_t n = 0; n < x_ticks.size(); n++) {
+    if (x_steps[n] % stride != 0) continue;
+    labels.push_back({ x_labels[n], x_ticks[n] - text_width(x_labels[n]) / 2,
+                       bottom_y + TICK + 4 });
+  }
+  std::string x_title = "Frequency (Hz)";
+  labels.push_back({ x_title, left + (plot_width - text_width(x_title)) / 2,
+                     bottom_y + TICK + 4 + TEXT_HEIGHT + PAD });
+  const int height = bottom_y + TICK + 4 + 2 * TEXT_HEIGHT + 2 * PAD;
+
+  // Colorbar with the minimum, middle and maximum power.
+  const int bar_x = left + plot_width + COLORBAR_GAP;
+  const int bar_label_x = bar_x + COLORBAR_WIDTH + TICK + 4;
+  std::vector<int> bar_ticks;
+  int bar_label_width = 0;
+  const int bar_values[] = { vmin, (vmin + vmax) / 2, vmax };
+  for (int n = 0; n < 3 && rows > 0; n++) {
+    int y = vmax > vmin ? bottom_y - 1 - (bar_values[n] - vmin) * (rows - 1) /
+                                             (vmax - vmin)
+                        : bottom_y - 1;
+    // Skip labels that would overlap the previous one, on short plots.
+    if (n > 0 && bar_ticks.back() - y < TEXT_HEIGHT + 2) continue;
+    bar_ticks.push_back(y);
+    std::string text = std::to_string(bar_values[n]);
+    labels.push_back({ text, bar_label_x, y - TEXT_HEIGHT / 2 });
+    bar_label_width = std::max(bar_label_width, text_width(text));
+  }
+  std::string bar_title = "Power (dBFS)";
+  int width = std::max(bar_label_x + bar_label_width + PAD,
+                       bar_x + text_width(bar_title) + PAD);
+  labels.push_back({ bar_title, width - PAD - text_width(bar_title), PAD });
+
+  std::vector<uint8_t> line(width * 3);
+  png_row_source source = [&](int y) -> const uint8_t * {
+    std::fill(line.begin(), line.end(), 255);
+    int p = y - top;
+
+    if (p >= 0 && p < rows) {
+      int i = rows - 1 - p;
+      const int8_t *r = row(i);
+      uint8_t *out = &line[left * 3];
+      for (int k = 0; k < fft_size; k++) {
+        const rgb &color = lut[static_cast<uint8_t>(r[k])];
+        for (int s = 0; s < scale; s++, out += 3) {
+          out[0] = color[0];
+          out[1] = color[1];
+          out[2] = color[2];
+        }
+      }
+
+      // Dashed grid lines
+      bool y_tick = rows_per_tick > 0 && i % rows_per_tick == 0;
+      if (y_tick) {
+        for (int x = left; x < left + plot_width; x++) {
+          if ((x - left) / 4 % 2 == 0) darken(&line[x * 3]);
+        }
+        for (int x = left - 1 - TICK; x < left; x++) set_black(&line[x * 3]);
+      } else if (p / 4 % 2 == 0) {
+        for (int x : x_ticks) darken(&line[x * 3]);
+      }
+
+      rgb bar_color =
+          colormap(rows > 1 ? (rows - 1 - p) * 255 / (rows - 1) : 0);
+      for (int x = bar_x; x < bar_x + COLORBAR_WIDTH; x++) {
+        std::copy(bar_color.begin(), bar_color.end(), &line[x * 3]);
+      }
+      if (std::find(bar_ticks.begin(), bar_ticks.end(), y) !=
+          bar_ticks.end()) {
+        for (int x = bar_x + COLORBAR_WIDTH; x < bar_x + COLORBAR_WIDTH + TICK;
+             x++) {
+          set_black(&line[x * 3]);
+        }
+      }
+
+      set_black(&line[(left - 1) * 3]);
+      set_black(&line[(left + plot_width) * 3]);
+      set_black(&line[(bar_x - 1) * 3]);
+      set_black(&line[(bar_x + COLORBAR_WIDTH) * 3]);
+    } else if (p == -1 || p == rows) {
+      for (int x = left - 1; x <= left + plot_width; x++) {
+        set_black(&line[x * 3]);
+      }
+      for (int x = bar_x - 1; x <= bar_x + COLORBAR_WIDTH; x++) {
+        set_black(&line[x * 3]);
+      }
+    } else if (p > rows && p <= rows + TICK) {
+      for (int x : x_ticks) set_black(&line[x * 3]);
+    }
+
+    for (const label &l : labels) {
+      int gy = y - l.y;
+      if (gy < 0 || gy >= TEXT_HEIGHT) continue;
+      for (size_t n = 0; n < l.text.size(); n++) {
+        const uint8_t *g = glyph_rows(l.text[n]);
+        if (g == NULL) continue;
+        uint8_t bits = g[gy / FONT_SCALE];
+        for (int gx = 0; gx < FONT_WIDTH * FONT_SCALE; gx++) {
+          int x = l.x + n * CHAR_ADVANCE + gx;
+          if ((bits >> (FONT_WIDTH - 1 - gx / FONT_SCALE)) & 1 && x >= 0 &&
+              x < width) {
+            set_black(&line[x * 3]);
+          }
+        }
+      }
+    }
+    return line.data();
+  };
+
+  return store_rows_to_png_string(width, height, 3, source, options);
+}
+
+}  // namespace starcoder
+}  // namespace gr
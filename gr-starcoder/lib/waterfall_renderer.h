@@ -0,0 +1,55 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_STARCODER_WATERFALL_RENDERER_H
+#define INCLUDED_STARCODER_WATERFALL_RENDERER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "gil_util.h"
+
+namespace gr {
+namespace starcoder {
+
+// Returns the fft_size power values (dBFS) of spectrum row y, which must stay
+// valid until the next call.
+typedef std::function<const int8_t *(int y)> waterfall_row_source;
+
+// Renders a waterfall of rows spectra, the first one at the bottom, as an RGB
+// PNG with the same layout as plot_waterfall.py: the nipy_spectral colormap
+// from the mean to the maximum power, frequency ticks every tenth of
+// samp_rate around center_freq, time ticks every minute (rps rows per
+// second), and a colorbar.
+//
+// Each spectrum bin is drawn as a whole number of pixels and each row as one
+// line, so nothing is resampled. Every row is requested twice: in order for
+// the power range, then from the last one while encoding, so the image never
+// has to exist as a whole.
+std::string render_waterfall_png(const waterfall_row_source &row, int rows,
+                                 int fft_size, double samp_rate,
+                                 double center_freq, int rps,
+                                 const png_options &options = png_options());
+
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_STARCODER_WATERFALL_RENDERER_H */
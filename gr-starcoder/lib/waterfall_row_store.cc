@@ -0,0 +1,130 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "waterfall_row_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+namespace starcoder {
+
+waterfall_row_store::waterfall_row_store(size_t row_size, size_t memory_limit,
+                                         const std::string &spill_dir)
+    : row_size_(row_size),
+      memory_limit_(memory_limit),
+      spill_dir_(spill_dir),
+      rows_(0),
+      fd_(-1),
+      map_(NULL),
+      map_size_(0) {}
+
+waterfall_row_store::~waterfall_row_store() { clear(); }
+
+void waterfall_row_store::append(const int8_t *rows, size_t count) {
+  size_t size = count * row_size_;
+  if (fd_ < 0 && (rows_ + count) * row_size_ > memory_limit_) spill();
+
+  if (fd_ >= 0) {
+    unmap();
+    write_to_file(rows, size);
+  } else {
+    // Growing by doubling would briefly hold up to twice the limit. The
+    // allocation is mapped lazily, only the rows written take memory.
+    if (memory_.capacity() == 0) {
+      memory_.reserve(memory_limit_ / row_size_ * row_size_);
+    }
+    memory_.insert(memory_.end(), rows, rows + size);
+  }
+  rows_ += count;
+}
+
+size_t waterfall_row_store::rows() const { return rows_; }
+
+bool waterfall_row_store::spilled() const { return fd_ >= 0; }
+
+const int8_t *waterfall_row_store::data() {
+  if (rows_ == 0) return NULL;
+  if (fd_ < 0) return memory_.data();
+
+  if (map_ == NULL) {
+    map_size_ = rows_ * row_size_;
+    map_ = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (map_ == MAP_FAILED) {
+      map_ = NULL;
+      throw std::runtime_error(std::string("Cannot map the waterfall: ") +
+                               strerror(errno));
+    }
+  }
+  return static_cast<const int8_t *>(map_);
+}
+
+void waterfall_row_store::clear() {
+  unmap();
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  std::vector<int8_t>().swap(memory_);
+  rows_ = 0;
+}
+
+void waterfall_row_store::spill() {
+  std::string path = spill_dir_ + "/waterfall_XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  fd_ = mkstemp(name.data());
+  if (fd_ < 0) {
+    throw std::runtime_error("Cannot create " + path + ": " + strerror(errno));
+  }
+  // The file disappears with the descriptor, even if the process dies.
+  unlink(name.data());
+
+  write_to_file(memory_.data(), memory_.size());
+  std::vector<int8_t>().swap(memory_);
+}
+
+void waterfall_row_store::write_to_file(const int8_t *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd_, data, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error(std::string("Cannot write the waterfall: ") +
+                               strerror(errno));
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+void waterfall_row_store::unmap() {
+  if (map_ != NULL) {
+    munmap(map_, map_size_);
+    map_ = NULL;
+  }
+}
+
+}  // namespace starcoder
+}  // namespace gr
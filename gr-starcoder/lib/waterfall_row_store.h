@@ -0,0 +1,79 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_STARCODER_WATERFALL_ROW_STORE_H
+#define INCLUDED_STARCODER_WATERFALL_ROW_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace starcoder {
+
+// Append only storage for the spectrum rows of a waterfall. Rows are kept in
+// memory until they would take more than memory_limit bytes. From then on,
+// all of them are moved to an unlinked temporary file in spill_dir. The page
+// cache buffers the file, so its pages can be reclaimed under memory
+// pressure, however long the observation. Either way the rows are read back
+// as a single contiguous array, mapped from the file when spilled, without
+// copying.
+class waterfall_row_store {
+ public:
+  // Throws std::runtime_error if the spill file cannot be created or written.
+  waterfall_row_store(size_t row_size, size_t memory_limit,
+                      const std::string &spill_dir);
+  ~waterfall_row_store();
+
+  void append(const int8_t *rows, size_t count);
+  size_t rows() const;
+  // Whether the rows have been moved to the spill file.
+  bool spilled() const;
+
+  // All the rows, row y starting at data() + y * row_size. The pointer stays
+  // valid until the next call to append() or clear(). NULL when empty.
+  const int8_t *data();
+
+  // Drops all the rows and the spill file.
+  void clear();
+
+ private:
+  waterfall_row_store(const waterfall_row_store &) = delete;
+  waterfall_row_store &operator=(const waterfall_row_store &) = delete;
+
+  void spill();
+  void write_to_file(const int8_t *data, size_t size);
+  void unmap();
+
+  size_t row_size_, memory_limit_;
+  std::string spill_dir_;
+  size_t rows_;
+  std::vector<int8_t> memory_;
+  // Spill file descriptor, or -1, and its read only mapping, if any.
+  int fd_;
+  void *map_;
+  size_t map_size_;
+};
+
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_STARCODER_WATERFALL_ROW_STORE_H */
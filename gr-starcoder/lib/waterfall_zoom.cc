@@ -0,0 +1,101 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "waterfall_zoom.h"
+
+#include <gnuradio/fft/window.h>
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace gr {
+namespace starcoder {
+
+namespace {
+
+// Filter length per unit of decimation. With a Blackman-Harris window, the
+// response then falls from -0.1 dB to -110 dB over the 0.2 output rate wide
+// band centered on the cutoff.
+const size_t TAPS_PER_DECIMATION = 32;
+
+// Cutoff, in output rates. The span fits in half the output rate, so the
+// band edges are flat and nothing past the output Nyquist frequency, which
+// would alias, gets through.
+const double CUTOFF = 0.375;
+
+}  // namespace
+
+waterfall_zoom::waterfall_zoom(double samp_rate, double span, double offset)
+    : samp_rate_(samp_rate), phase_(1.0f, 0.0f) {
+  if (span <= 0 || span > samp_rate) {
+    throw std::invalid_argument("Zoom span must be in (0, samp_rate]");
+  }
+  decimation_ = std::max<size_t>(1, (size_t)(samp_rate / (2.0 * span)));
+
+  // Windowed sinc with unity gain at DC.
+  size_t ntaps = TAPS_PER_DECIMATION * decimation_ + 1;
+  std::vector<float> window = fft::window::build(
+      fft::window::WIN_BLACKMAN_HARRIS, ntaps, 6.76);
+  double cutoff = CUTOFF / decimation_;
+  double middle = (ntaps - 1) / 2.0;
+  double sum = 0.0;
+  taps_.resize(ntaps);
+  for (size_t i = 0; i < ntaps; i++) {
+    double x = i - middle;
+    double sinc = x == 0.0 ? 2.0 * cutoff
+                           : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+    taps_[i] = sinc * window[i];
+    sum += taps_[i];
+  }
+  for (size_t i = 0; i < ntaps; i++) {
+    taps_[i] /= sum;
+  }
+  std::reverse(taps_.begin(), taps_.end());
+
+  history_.assign(ntaps - 1, std::complex<float>(0.0f, 0.0f));
+  set_offset(offset);
+}
+
+void waterfall_zoom::set_offset(double offset) {
+  phase_inc_ = std::polar(1.0f, (float)(-2.0 * M_PI * offset / samp_rate_));
+}
+
+void waterfall_zoom::process(const std::complex<float> *in, size_t n,
+                             std::vector<std::complex<float>> &out) {
+  size_t old = history_.size();
+  history_.resize(old + n);
+  volk_32fc_s32fc_x2_rotator_32fc(&history_[old], in, phase_inc_, &phase_, n);
+
+  /* Only compute the outputs that survive the decimation */
+  size_t next = 0;
+  std::complex<float> y;
+  while (next + taps_.size() <= history_.size()) {
+    volk_32fc_32f_dot_prod_32fc(&y, &history_[next], taps_.data(),
+                                taps_.size());
+    out.push_back(y);
+    next += decimation_;
+  }
+  history_.erase(history_.begin(), history_.begin() + next);
+}
+
+}  // namespace starcoder
+}  // namespace gr
@@ -0,0 +1,68 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Infostellar, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_STARCODER_WATERFALL_ZOOM_H
+#define INCLUDED_STARCODER_WATERFALL_ZOOM_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace gr {
+namespace starcoder {
+
+// Front end of the zoomed waterfall. Mixes the band centered offset Hz away
+// from the input center down to baseband, low pass filters it to span Hz and
+// decimates it by floor(samp_rate / (2 * span)), so a small FFT of the output
+// resolves the band as finely as a huge FFT of the input would. The band takes
+// up to the middle half of the output rate, leaving room for the filter's
+// transition.
+class waterfall_zoom {
+ public:
+  // Throws std::invalid_argument unless 0 < span <= samp_rate.
+  waterfall_zoom(double samp_rate, double span, double offset);
+
+  size_t decimation() const { return decimation_; }
+  double output_rate() const { return samp_rate_ / decimation_; }
+  size_t taps() const { return taps_.size(); }
+
+  // Retunes the mixer without a phase jump, e.g. to follow the Doppler shift.
+  void set_offset(double offset);
+
+  // Mixes, filters and decimates n input samples, appending the output to
+  // out. Samples left over from one call are used by the next.
+  void process(const std::complex<float> *in, size_t n,
+               std::vector<std::complex<float>> &out);
+
+ private:
+  double samp_rate_;
+  size_t decimation_;
+  // Time reversed, so each output is a plain dot product with the history.
+  std::vector<float> taps_;
+  std::complex<float> phase_, phase_inc_;
+  // Mixed samples not yet consumed, starting with the taps() - 1 newest
+  // samples the next output still needs.
+  std::vector<std::complex<float>> history_;
+};
+
+}  // namespace starcoder
+}  // namespace gr
+
+#endif /* INCLUDED_STARCODER_WATERFALL_ZOOM_H */
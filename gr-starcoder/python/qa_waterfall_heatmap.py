@@ -21,7 +21,12 @@
 
 from gnuradio import gr, gr_unittest
 from gnuradio import blocks
+from gnuradio import fft
+import cmath
+import math
+import pmt
 import starcoder_swig as starcoder
+import waterfall_heatmap_reference
 
 
 expected_decimation = (153, 165, 168, 165, 154, 166, 169, 167, 156, 169, 173,
@@ -67,6 +72,89 @@ class qa_waterfall_heatmap (gr_unittest.TestCase):
         self.tb.run ()
         self.assertEqual(dst.data(), expected_max_hold)
 
+    def test_001_mean_mode(self):
+        src_data = self.generate_data()
+        src = blocks.vector_source_c(src_data)
+        s2v = blocks.stream_to_vector(gr.sizeof_gr_complex, self.fft_size)
+        op = starcoder.waterfall_heatmap(1000, 0, 1, self.fft_size, 2, False,
+                                         fft.window.WIN_HANN)
+        dst = blocks.vector_sink_b(self.fft_size)
+        self.tb.connect(src, s2v, op, dst)
+
+        self.tb.run ()
+        expected = waterfall_heatmap_reference.mean_rows(src_data, 1000, 1,
+                                                         self.fft_size, False)
+        self.assertEqual(dst.data(), expected)
+
+    def test_001_mean_mode_overlap(self):
+        src_data = self.generate_data()
+        src = blocks.vector_source_c(src_data)
+        s2v = blocks.stream_to_vector(gr.sizeof_gr_complex, self.fft_size)
+        op = starcoder.waterfall_heatmap(1000, 0, 1, self.fft_size, 2, True,
+                                         fft.window.WIN_HANN)
+        dst = blocks.vector_sink_b(self.fft_size)
+        self.tb.connect(src, s2v, op, dst)
+
+        self.tb.run ()
+        expected = waterfall_heatmap_reference.mean_rows(src_data, 1000, 1,
+                                                         self.fft_size, True)
+        self.assertEqual(dst.data(), expected)
+
+    def run_zoom(self, offset, doppler=None):
+        # A tone 4 kHz above the center, zoomed to a 4 kHz span
+        samp_rate = 32000
+        tone = 4000
+        amplitude = 1.2e-4
+        span = 4000
+        rps = 10
+        src_data = tuple([cmath.rect(amplitude,
+                                     2 * math.pi * tone * i / samp_rate)
+                          for i in range(samp_rate)])
+        src = blocks.vector_source_c(src_data)
+        s2v = blocks.stream_to_vector(gr.sizeof_gr_complex, self.fft_size)
+        op = starcoder.waterfall_heatmap(samp_rate, 0, rps, self.fft_size, 1,
+                                         False, fft.window.WIN_HANN, span,
+                                         offset)
+        dst = blocks.vector_sink_b(self.fft_size)
+        self.tb.connect(src, s2v, op, dst)
+        if doppler is not None:
+            op.to_basic_block()._post(pmt.intern("doppler"),
+                                      pmt.from_double(doppler))
+
+        self.tb.run ()
+
+        # The zoom decimates by floor(samp_rate / (2 * span)), and a row is
+        # emitted once more than rate / fft_size / rps vectors of decimated
+        # samples were transformed since the last one.
+        decimation = samp_rate // (2 * span)
+        rate = float(samp_rate) / decimation
+        self.assertEqual(op.output_rate(), rate)
+        vectors = len(src_data) // decimation // self.fft_size
+        vectors_per_row = int(math.floor(rate / self.fft_size / rps)) + 1
+        data = [v - 256 if v > 127 else v for v in dst.data()]
+        rows = [data[i:i + self.fft_size]
+                for i in range(0, len(data), self.fft_size)]
+        self.assertEqual(len(rows), vectors // vectors_per_row)
+
+        # The band center, offset minus the Doppler shift, is mixed down to
+        # DC, which the FFT shift moves to the middle bin. The tone is on a
+        # bin and the filter has unit gain there, so max hold reads its power
+        # truncated to a whole dB, like the block's conversion to int8.
+        center = offset - (doppler or 0)
+        tone_bin = (self.fft_size // 2 +
+                    int(round((tone - center) * self.fft_size / rate)))
+        level = int(20 * math.log10(amplitude))
+        # The first row still holds the filter's start up transient
+        for row in rows[1:]:
+            self.assertEqual(row.index(max(row)), tone_bin)
+            self.assertEqual(max(row), level)
+
+    def test_002_zoom(self):
+        self.run_zoom(4000)
+
+    def test_002_zoom_doppler(self):
+        self.run_zoom(5000, 1000)
+
 
 if __name__ == '__main__':
     gr_unittest.run(qa_waterfall_heatmap, "qa_waterfall_heatmap.xml")
@@ -22,10 +22,59 @@
 from gnuradio import gr, gr_unittest
 from gnuradio import blocks
 import starcoder_swig as starcoder
+import math
 import os
+import struct
 import tempfile
+import zlib
+from matplotlib import cm
 from matplotlib.testing.compare import compare_images
 
+def read_png(filename):
+    """Decodes an 8 bit RGB PNG into rows of (r, g, b) pixels."""
+    with open(filename, 'rb') as f:
+        data = f.read()
+    assert data[:8] == b'\x89PNG\r\n\x1a\n'
+    pos = 8
+    idat = b''
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        if kind == b'IHDR':
+            width, height, depth, color, _, _, interlace = \
+                struct.unpack('>IIBBBBB', chunk)
+            assert (depth, color, interlace) == (8, 2, 0)
+        elif kind == b'IDAT':
+            idat += chunk
+        pos += 12 + length
+
+    raw = bytearray(zlib.decompress(idat))
+    stride = 3 * width
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        start = y * (stride + 1)
+        kind = raw[start]
+        row = raw[start + 1:start + 1 + stride]
+        for i in range(stride):
+            a = row[i - 3] if i >= 3 else 0
+            b = prev[i]
+            c = prev[i - 3] if i >= 3 else 0
+            if kind == 1:
+                row[i] = (row[i] + a) & 0xff
+            elif kind == 2:
+                row[i] = (row[i] + b) & 0xff
+            elif kind == 3:
+                row[i] = (row[i] + (a + b) // 2) & 0xff
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if pa <= pb and pa <= pc else (b if pb <= pc else c)
+                row[i] = (row[i] + pred) & 0xff
+        rows.append([tuple(row[x:x + 3]) for x in range(0, stride, 3)])
+        prev = row
+    return rows
+
 class qa_waterfall_plotter (gr_unittest.TestCase):
 
     def setUp (self):
@@ -45,12 +94,60 @@ class qa_waterfall_plotter (gr_unittest.TestCase):
         src_data = tuple(range(140, 180)*20)
         src = blocks.vector_source_b(src_data)
         s2v = blocks.stream_to_vector(gr.sizeof_char, self.fft_size)
-        op = starcoder.waterfall_plotter(1, 0, 1, self.fft_size, self.filename)
+        op = starcoder.waterfall_plotter(1, 0, 1, self.fft_size, self.filename,
+                                         True)
         self.tb.connect(src, s2v, op)
         self.tb.run()
         results = compare_images("test_waterfall.png", self.filename, 0.1)
         self.assertEqual(results, None)
 
+    def test_002_native (self):
+        src_data = tuple(range(140, 180)*20)
+        src = blocks.vector_source_b(src_data)
+        s2v = blocks.stream_to_vector(gr.sizeof_char, self.fft_size)
+        op = starcoder.waterfall_plotter(1, 0, 1, self.fft_size, self.filename)
+        self.tb.connect(src, s2v, op)
+        self.tb.run()
+        rows = read_png(self.filename)
+
+        # The plot area is framed by the two longest black lines. Narrow
+        # spectra are widened to a whole number of pixels per bin, and each
+        # spectrum is one line.
+        longest = []
+        for row in rows:
+            run, best = 0, (0, 0)
+            for x, pixel in enumerate(row):
+                run = run + 1 if pixel == (0, 0, 0) else 0
+                best = max(best, (run, x - run + 1))
+            longest.append(best)
+        frame = max(longest)
+        frames = [y for y, run in enumerate(longest) if run == frame]
+        self.assertEqual(len(frames), 2)
+        top, bottom = frames
+        plot_width, left = frame[0] - 2, frame[1] + 1
+        scale = max(1, 1024 // self.fft_size)
+        self.assertEqual(plot_width, self.fft_size * scale)
+        self.assertEqual(bottom - top - 1, 20)
+
+        # Colors span the nipy_spectral colormap from the truncated mean
+        # power to the maximum. The bytes are powers in dBFS, as int8.
+        powers = [v - 256 for v in range(140, 180)]
+        vmin = int(float(sum(powers)) / len(powers))
+        vmax = max(powers)
+        # The first spectrum is the bottom row. Away from the dashed grid
+        # lines and the ticks at the bin centers, every pixel of a bin has
+        # the color of its power.
+        first = rows[bottom - 1]
+        for k, v in enumerate(powers):
+            index = int(math.floor((v - vmin) * 256.0 / (vmax - vmin)))
+            expected = cm.nipy_spectral(max(0, min(255, index)))
+            x = left + k * scale
+            x += next(d for d in range(scale)
+                      if (k * scale + d) // 4 % 2 == 1 and d != scale // 2)
+            for c in range(3):
+                self.assertAlmostEqual(first[x][c], expected[c] * 255,
+                                       delta=1)
+
 
 if __name__ == '__main__':
     gr_unittest.run(qa_waterfall_plotter, "qa_waterfall_plotter.xml")
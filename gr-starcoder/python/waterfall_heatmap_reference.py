@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2018 Infostellar.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+"""Pure Python model of the waterfall_heatmap mean mode.
+
+qa_waterfall_heatmap derives its mean mode expectations from this model
+instead of hardcoding them. It follows the block step by step, in double
+precision and with a naive DFT:
+
+- A row is emitted once more than d_refresh = samp_rate / fft_size / rps
+  vectors were transformed since the last one.
+- Each vector is windowed with GNU Radio's symmetric Hann window. With
+  overlap, every vector but the very first is also preceded by the window
+  made of the second half of the previous vector and the first half of this
+  one.
+- The power spectra are averaged, normalized by the square of the window
+  sum, FFT shifted, converted to dB and clamped to [-110, -72].
+- The dB values are truncated to int8, like volk_32f_s32f_convert_8i does in
+  the VOLK releases GNU Radio 3.7 ships with. That is also what reproduces
+  the max hold expectations, which come from a run of the block.
+
+Running it prints the rows for the qa_waterfall_heatmap input.
+"""
+
+import cmath
+import math
+
+MIN_ENERGY = -110.0
+MAX_ENERGY = -72.0
+
+
+def hann(n):
+    """GNU Radio's fft.window.hann, symmetric."""
+    return [0.5 - 0.5 * math.cos(2 * math.pi * i / (n - 1)) for i in range(n)]
+
+
+def power_spectrum(samples, window):
+    n = len(samples)
+    x = [s * w for s, w in zip(samples, window)]
+    return [abs(sum(x[t] * cmath.exp(-2j * math.pi * k * t / n)
+                    for t in range(n))) ** 2
+            for k in range(n)]
+
+
+def to_int8(power):
+    db = 10 * math.log10(power + 1e-20)
+    return int(max(MIN_ENERGY, min(MAX_ENERGY, db))) & 0xff
+
+
+def mean_rows(samples, samp_rate, rps, fft_size, overlap, window=None):
+    """Returns the bytes the mean mode outputs for samples, row after row."""
+    if window is None:
+        window = hann(fft_size)
+    refresh = samp_rate / float(fft_size) / rps
+    gain = sum(window) ** 2
+    half = fft_size // 2
+    shift = int(math.ceil(fft_size / 2.0))
+
+    out = []
+    total = [0.0] * fft_size
+    spectra = 0
+    count = 0
+    tail = None
+    for start in range(0, len(samples) - fft_size + 1, fft_size):
+        vector = samples[start:start + fft_size]
+        windows = [vector]
+        if overlap and tail is not None:
+            windows.insert(0, tail + vector[:half])
+        if overlap:
+            tail = vector[half:]
+        for w in windows:
+            total = [a + b for a, b in zip(total, power_spectrum(w, window))]
+            spectra += 1
+
+        count += 1
+        if count > refresh:
+            row = [p / (spectra * gain) for p in total]
+            row = row[shift:] + row[:shift]
+            out.extend(to_int8(p) for p in row)
+            total = [0.0] * fft_size
+            spectra = 0
+            count = 0
+    return tuple(out)
+
+
+def test_input():
+    """The samples qa_waterfall_heatmap feeds the block."""
+    return [complex(i, i + 100) * 0.00001 for i in range(100)] * 20
+
+
+if __name__ == '__main__':
+    for overlap in (False, True):
+        print('overlap=%s: %s' % (overlap,
+                                  mean_rows(test_input(), 1000, 1, 32,
+                                            overlap)))
@@ -36,6 +36,7 @@
 
 from gnuradio import gr
 from gnuradio import blocks
+from gnuradio import fft
 from starcoder import starcoder_swig
 
 
@@ -46,7 +47,10 @@ class waterfall_sink(gr.hier_block2):
     of the observation
     """
 
-    def __init__(self, samp_rate, center_freq, rps, fft_size, filename, mode):
+    def __init__(self, samp_rate, center_freq, rps, fft_size, filename, mode,
+                 use_matplotlib=False, memory_limit_mb=256, overlap=False,
+                 window=fft.window.WIN_HANN, span=0, offset=0,
+                 spill_dir=""):
         """
 
         :param samp_rate: the sampling rate
@@ -62,19 +66,46 @@ class waterfall_sink(gr.hier_block2):
         :param mode: the operation mode of the waterfall (0 = simple decimation,
         1 = max hold, 2 = mean)
         :type mode: int
+        :param use_matplotlib: plot the image with matplotlib instead of the
+        native renderer
+        :type use_matplotlib: bool
+        :param memory_limit_mb: rows beyond this many MiB are kept in a
+        temporary file
+        :type memory_limit_mb: int
+        :param spill_dir: directory of that temporary file, $TMPDIR or /tmp
+        if empty
+        :type spill_dir: string
+        :param overlap: in mean mode, also average the FFTs of the windows
+        overlapping consecutive vectors by 50%
+        :type overlap: bool
+        :param window: the window applied before each FFT in mean mode
+        :type window: int
+        :param span: if not 0, zoom into a band this wide, in Hz
+        :type span: double
+        :param offset: center of the zoomed band relative to center_freq, in
+        Hz. Doppler shifts received on the "doppler" message port are
+        subtracted from it.
+        :type offset: double
         """
         gr.hier_block2.__init__(self,
                                 "waterfall_sink",
                                 gr.io_signature(1, 1, gr.sizeof_gr_complex),  # Input signature
                                 gr.io_signature(0, 0, 0)) # Output signature
 
-        waterfall_heatmap = starcoder_swig.waterfall_heatmap(samp_rate, center_freq, rps, fft_size, mode)
+        self.waterfall_heatmap = starcoder_swig.waterfall_heatmap(samp_rate, center_freq, rps, fft_size, mode, overlap, window, span, offset)
         s2v = blocks.stream_to_vector(gr.sizeof_gr_complex, fft_size)
-        self.waterfall_pl = starcoder_swig.waterfall_plotter(samp_rate, center_freq, rps, fft_size, filename)
+        # When zooming, the rows only cover the band around the offset
+        plot_center_freq = center_freq + offset if span else center_freq
+        self.waterfall_pl = starcoder_swig.waterfall_plotter(self.waterfall_heatmap.output_rate(), plot_center_freq, rps, fft_size, filename, use_matplotlib, memory_limit_mb, spill_dir)
 
+        self.message_port_register_hier_in("doppler")
+        self.msg_connect((self, "doppler"), (self.waterfall_heatmap, "doppler"))
         self.connect((self, 0), (s2v, 0))
-        self.connect((s2v, 0), (waterfall_heatmap, 0))
-        self.connect((waterfall_heatmap, 0), (self.waterfall_pl, 0))
+        self.connect((s2v, 0), (self.waterfall_heatmap, 0))
+        self.connect((self.waterfall_heatmap, 0), (self.waterfall_pl, 0))
+
+    def set_offset(self, offset):
+        self.waterfall_heatmap.set_offset(offset)
 
     def register_starcoder_queue(self, ptr):
         self.waterfall_pl.register_starcoder_queue(ptr)